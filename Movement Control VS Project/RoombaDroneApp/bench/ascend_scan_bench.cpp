@@ -0,0 +1,153 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Benchmark of ScanSorter::ascend against the original float/std::sort
+// implementation of ascendScanData.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -I. -Iinclude -o ascend_scan_bench
+//       bench/ascend_scan_bench.cpp src/rplidar_scan_sorter.cpp
+
+#include "src/sdkcommon.h"
+#include "src/rplidar_scan_sorter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+typedef u_result (*ascend_fn_t)(rplidar_response_measurement_node_hq_t *, size_t);
+
+enum scan_shape_t {
+    SHAPE_SORTED,       // already ascending
+    SHAPE_WRAPPED,      // one wrap point, as delivered by the device
+    SHAPE_JITTERED,     // wrapped plus per sample angle correction noise
+    SHAPE_SHUFFLED,     // no order at all
+};
+
+static const char * _shapeName(scan_shape_t shape)
+{
+    switch (shape) {
+    case SHAPE_SORTED:   return "sorted";
+    case SHAPE_WRAPPED:  return "wrapped";
+    case SHAPE_JITTERED: return "jittered";
+    case SHAPE_SHUFFLED: return "shuffled";
+    }
+    return "?";
+}
+
+static void _makeScan(std::vector<rplidar_response_measurement_node_hq_t> & scan, size_t count, scan_shape_t shape, unsigned seed)
+{
+    const _u32 range = (360 << 14) / 90;
+    srand(seed);
+
+    scan.resize(count);
+    _u32 start = (shape == SHAPE_SORTED) ? 0 : (_u32)(rand() % range);
+    for (size_t pos = 0; pos < count; ++pos) {
+        int angle = (int)(start + (_u64)pos * range / count);
+        if (shape == SHAPE_JITTERED) angle += (rand() % 97) - 48;
+        if (shape == SHAPE_SHUFFLED) angle = rand();
+
+        rplidar_response_measurement_node_hq_t & node = scan[pos];
+        node.angle_z_q14 = _u16(((angle % (int)range) + range) % range);
+        node.dist_mm_q2 = (rand() % 16) ? (_u32)(rand() % 40000 + 400) : 0;
+        node.quality = node.dist_mm_q2 ? (0x2f << 2) : 0;
+        node.flag = (pos == 0) ? RPLIDAR_RESP_MEASUREMENT_SYNCBIT : 0;
+    }
+}
+
+static double _measure(ascend_fn_t fn, const std::vector<rplidar_response_measurement_node_hq_t> & scan, int rounds, std::vector<rplidar_response_measurement_node_hq_t> & result)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> work(scan.size());
+    double best = 1e30;
+
+    for (int round = 0; round < rounds; ++round) {
+        work = scan;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        fn(&work[0], work.size());
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(end - begin).count();
+        if (us < best) best = us;
+    }
+    result = work;
+    return best;
+}
+
+static bool _isAscending(const std::vector<rplidar_response_measurement_node_hq_t> & scan)
+{
+    for (size_t pos = 1; pos < scan.size(); ++pos) {
+        if (scan[pos].angle_z_q14 < scan[pos - 1].angle_z_q14) return false;
+    }
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 200;
+    static const size_t counts[] = { 720, 2000, 3200, 8000 };
+    static const scan_shape_t shapes[] = { SHAPE_SORTED, SHAPE_WRAPPED, SHAPE_JITTERED, SHAPE_SHUFFLED };
+
+    printf("%-9s %6s %12s %12s %8s %9s\n", "shape", "nodes", "reference_us", "ascend_us", "speedup", "max_diff");
+
+    bool ok = true;
+    for (size_t shapeId = 0; shapeId < _countof(shapes); ++shapeId) {
+        for (size_t countId = 0; countId < _countof(counts); ++countId) {
+            std::vector<rplidar_response_measurement_node_hq_t> scan, refResult, newResult;
+            _makeScan(scan, counts[countId], shapes[shapeId], (unsigned)(shapeId * 131 + countId));
+
+            double refUs = _measure(&ScanSorter::ascendReference, scan, rounds, refResult);
+            double newUs = _measure(&ScanSorter::ascend, scan, rounds, newResult);
+
+            // both outputs are sorted, so angle i of one should match angle i
+            // of the other up to the interpolation rounding
+            int maxDiff = 0;
+            for (size_t pos = 0; pos < scan.size(); ++pos) {
+                int diff = abs((int)refResult[pos].angle_z_q14 - (int)newResult[pos].angle_z_q14);
+                if (diff > maxDiff) maxDiff = diff;
+            }
+            if (!_isAscending(newResult)) ok = false;
+
+            printf("%-9s %6d %12.2f %12.2f %7.1fx %9d\n", _shapeName(shapes[shapeId]), (int)scan.size(), refUs, newUs, refUs / newUs, maxDiff);
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr, "ascend produced an unordered scan\n");
+        return 1;
+    }
+    return 0;
+}
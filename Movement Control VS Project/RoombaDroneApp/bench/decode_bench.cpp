@@ -0,0 +1,858 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Microbenchmarks of the driver decode path on captured capsule corpora.
+//
+// A corpus is a file written by RPlidarDriver::startRecording of a session
+// that connects, starts the motor and starts one scan. Record one on the
+// target with
+//   decode_bench capture <port> <baudrate> <scan mode id> <file> [seconds]
+// Without corpus files, Express, Boost, Sensitivity and HQ corpora are
+// captured from LidarEmulator at 32k samples/s.
+//
+// Per corpus it measures the capsule decoder entry points of the driver and
+// each CapsuleDecoder implementation, the HQ capsule CRC with each crc32
+// implementation, _cacheScanNodes, ascendScanData on the decoded
+// revolutions, and the whole _cache*ScanData loop fed by the replay driver.
+// Every kernel runs over the corpus until at least 200 ms have passed, the
+// best of 5 such rounds is reported.
+//
+// The output is a table, or with -j one JSON object per line: the first one
+// describes the host, every other one a kernel.
+//
+// Before timing anything, every CapsuleDecoder implementation the CPU
+// supports is checked against IMPL_SCALAR, and the table ultra decoder, one
+// capsule at a time and in bulk, against the floating point reference. Each
+// one decodes the capsules of the corpora plus all-zero, all-ones and pseudo
+// random capsules, which include out of range angles, distances and ultra
+// major/predict words, and must give the same nodes byte for byte. A difference is reported with its first differing node and
+// makes the bench exit with 2. "decode_bench check [corpus ...]" runs only
+// the checks.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -Isrc -o decode_bench
+//       bench/decode_bench.cpp bench/lidar_emulator.cpp src/*.cpp
+//       src/hal/*.cpp src/arch/linux/*.cpp
+//
+// Run: decode_bench [-j] [corpus ...]
+//      decode_bench check [corpus ...]
+
+#include "src/sdkcommon.h"
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "hal/triple_buffer.h"
+#include "hal/arena.h"
+#include "hal/spsc_ring.h"
+#include "hal/crc32.h"
+#include "hal/poller.h"
+#include "rplidar_rx_ring.h"
+#include "rplidar_capsule_decoder.h"
+#include "rplidar_scan_sorter.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_clock_sync.h"
+#include "rplidar_capability_cache.h"
+#include "rplidar_channel_record.h"
+#include "rplidar_spin_control.h"
+#include "src/rplidar_reactor.h"     // not the public header of the same name
+#include "rplidar_driver_impl.h"
+#include "rplidar_driver_serial.h"
+#include "bench/lidar_emulator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/utsname.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+enum {
+    RECORD_DIR_RX = 0,          // as in rplidar_channel_record.cpp
+    RECORD_DIR_TX = 1,
+
+    MIN_ROUND_US = 200000,
+    ROUNDS = 5,
+    FULL_LOOP_ROUNDS = 3,
+
+    CHECK_RANDOM_CAPSULES = 100000,
+    CHECK_SEED = 0x5EED1234,
+    CHECK_MAX_CAPSULE_NODES = CapsuleDecoder::ULTRA_CAPSULE_NODES,
+};
+
+static volatile _u32 _sink;
+
+// the recorded traffic of a corpus file
+class CorpusFile : public ReplayChannelDevice
+{
+public:
+    bool load(const char * path) { return _load(path); }
+
+    // finds the last scan command sent, and returns the mode id it started
+    // and everything received after it
+    bool extractScan(_u16 & mode, std::vector<_u8> & received) const
+    {
+        size_t scanRecord = _records.size();
+        for (size_t pos = 0; pos < _records.size(); ++pos) {
+            const record_t & record = _records[pos];
+            if (record.direction != RECORD_DIR_TX || record.size != 2 || _data[record.offset] != RPLIDAR_CMD_SYNC_BYTE) continue;
+
+            _u8 cmd = _data[record.offset + 1];
+            if (cmd == RPLIDAR_CMD_SCAN || cmd == RPLIDAR_CMD_FORCE_SCAN) {
+                mode = RPLIDAR_CONF_SCAN_COMMAND_STD;
+                scanRecord = pos;
+            } else if (cmd == RPLIDAR_CMD_EXPRESS_SCAN) {
+                // the size, payload and checksum follow as separate pieces
+                std::vector<_u8> sent;
+                for (size_t next = pos + 1; next < _records.size() && sent.size() < 2; ++next) {
+                    if (_records[next].direction != RECORD_DIR_TX) continue;
+                    sent.insert(sent.end(), _data.begin() + _records[next].offset, _data.begin() + _records[next].offset + _records[next].size);
+                }
+                if (sent.size() < 2) continue;
+                mode = sent[1] ? sent[1] : RPLIDAR_CONF_SCAN_COMMAND_EXPRESS;
+                scanRecord = pos;
+            }
+        }
+        if (scanRecord == _records.size()) return false;
+
+        received.clear();
+        for (size_t pos = scanRecord + 1; pos < _records.size(); ++pos) {
+            const record_t & record = _records[pos];
+            if (record.direction != RECORD_DIR_RX) continue;
+            received.insert(received.end(), _data.begin() + record.offset, _data.begin() + record.offset + record.size);
+        }
+        return true;
+    }
+};
+
+// the protected decode kernels of the driver
+class DecodeProbe : public RPlidarDriverSerial
+{
+public:
+    DecodeProbe()
+    {
+        _allocateScanBuffers();
+        _sampleDuration_us = 1;
+    }
+
+    using RPlidarDriverImplCommon::_capsuleToNormal;
+    using RPlidarDriverImplCommon::_dense_capsuleToNormal;
+    using RPlidarDriverImplCommon::_ultraCapsuleToNormal;
+    using RPlidarDriverImplCommon::_cacheScanNodes;
+
+    void restart()
+    {
+        _is_previous_capsuledataRdy = false;
+        _cached_scan.back().count = 0;
+    }
+};
+
+struct corpus_t {
+    std::string             name;
+    std::string             path;
+    _u16                    mode;
+    _u8                     ansType;
+    size_t                  frameSize;
+    size_t                  frameSamples;
+    std::vector<_u8>        frames;         // the valid frames, back to back
+    size_t                  frameCount;
+
+    std::vector<rplidar_response_measurement_node_hq_t> nodes;     // decoded
+    std::vector<std::vector<rplidar_response_measurement_node_hq_t> > revolutions;
+
+    template <typename T>
+    const T * frame(size_t pos) const { return reinterpret_cast<const T *>(&frames[pos * frameSize]); }
+};
+
+static bool _isValidFrame(_u8 ansType, const _u8 * frame, size_t frameSize)
+{
+    switch (ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT:
+        return (((frame[0] >> 1) ^ frame[0]) & 0x1) && (frame[1] & RPLIDAR_RESP_MEASUREMENT_CHECKBIT);
+
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:
+        {
+            if ((frame[0] >> 4) != RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 || (frame[1] >> 4) != RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) return false;
+            _u8 checksum = 0;
+            for (size_t pos = 2; pos < frameSize; ++pos) checksum ^= frame[pos];
+            return checksum == ((frame[0] & 0xF) | ((frame[1] & 0xF) << 4));
+        }
+
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:
+        {
+            const rplidar_response_hq_capsule_measurement_nodes_t * capsule = reinterpret_cast<const rplidar_response_hq_capsule_measurement_nodes_t *>(frame);
+            return frame[0] == RPLIDAR_RESP_MEASUREMENT_HQ_SYNC
+                && rp::hal::crc32_padded(frame, frameSize - sizeof(capsule->crc32)) == capsule->crc32;
+        }
+    }
+    return false;
+}
+
+static bool _frameLayout(_u8 ansType, size_t & frameSize, size_t & frameSamples)
+{
+    switch (ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT:
+        frameSize = sizeof(rplidar_response_measurement_node_t);
+        frameSamples = 1;
+        return true;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+        frameSize = sizeof(rplidar_response_capsule_measurement_nodes_t);
+        frameSamples = CapsuleDecoder::CAPSULE_NODES;
+        return true;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+        frameSize = sizeof(rplidar_response_dense_capsule_measurement_nodes_t);
+        frameSamples = CapsuleDecoder::DENSE_CAPSULE_NODES;
+        return true;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:
+        frameSize = sizeof(rplidar_response_ultra_capsule_measurement_nodes_t);
+        frameSamples = CapsuleDecoder::ULTRA_CAPSULE_NODES;
+        return true;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:
+        frameSize = sizeof(rplidar_response_hq_capsule_measurement_nodes_t);
+        frameSamples = _countof(((rplidar_response_hq_capsule_measurement_nodes_t *)0)->node_hq);
+        return true;
+    }
+    return false;
+}
+
+static bool _loadCorpus(const char * path, const char * name, corpus_t & corpus)
+{
+    CorpusFile file;
+    std::vector<_u8> received;
+    if (!file.load(path) || !file.extractScan(corpus.mode, received)) return false;
+
+    // the answer header of the scan, then its frames
+    size_t pos = 0;
+    while (pos + sizeof(rplidar_ans_header_t) <= received.size()
+        && (received[pos] != RPLIDAR_ANS_SYNC_BYTE1 || received[pos + 1] != RPLIDAR_ANS_SYNC_BYTE2)) {
+        ++pos;
+    }
+    if (pos + sizeof(rplidar_ans_header_t) > received.size()) return false;
+
+    corpus.ansType = reinterpret_cast<const rplidar_ans_header_t *>(&received[pos])->type;
+    if (!_frameLayout(corpus.ansType, corpus.frameSize, corpus.frameSamples)) return false;
+    pos += sizeof(rplidar_ans_header_t);
+
+    corpus.name = name;
+    corpus.path = path;
+    corpus.frames.clear();
+    while (pos + corpus.frameSize <= received.size()) {
+        if (_isValidFrame(corpus.ansType, &received[pos], corpus.frameSize)) {
+            corpus.frames.insert(corpus.frames.end(), received.begin() + pos, received.begin() + pos + corpus.frameSize);
+            pos += corpus.frameSize;
+        } else {
+            ++pos;
+        }
+    }
+    corpus.frameCount = corpus.frames.size() / corpus.frameSize;
+    if (corpus.frameCount < 2) return false;
+
+    // the decoded nodes, split into the complete revolutions
+    corpus.nodes.resize(corpus.frameCount * corpus.frameSamples);
+    size_t nodeCount = 0;
+    switch (corpus.ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+        nodeCount = CapsuleDecoder::decodeCapsules(corpus.frame<rplidar_response_capsule_measurement_nodes_t>(0), corpus.frameCount, &corpus.nodes[0]);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+        nodeCount = CapsuleDecoder::decodeDenseCapsules(corpus.frame<rplidar_response_dense_capsule_measurement_nodes_t>(0), corpus.frameCount, &corpus.nodes[0]);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:
+        nodeCount = CapsuleDecoder::decodeUltraCapsules(corpus.frame<rplidar_response_ultra_capsule_measurement_nodes_t>(0), corpus.frameCount, &corpus.nodes[0]);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:
+        for (size_t frame = 0; frame < corpus.frameCount; ++frame) {
+            const rplidar_response_hq_capsule_measurement_nodes_t * capsule = corpus.frame<rplidar_response_hq_capsule_measurement_nodes_t>(frame);
+            for (size_t node = 0; node < corpus.frameSamples; ++node) corpus.nodes[nodeCount++] = capsule->node_hq[node];
+        }
+        break;
+    }
+    corpus.nodes.resize(nodeCount);
+
+    corpus.revolutions.clear();
+    size_t start = nodeCount;
+    for (size_t node = 0; node < nodeCount; ++node) {
+        if (!(corpus.nodes[node].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) continue;
+        if (start < node) {
+            corpus.revolutions.push_back(std::vector<rplidar_response_measurement_node_hq_t>(corpus.nodes.begin() + start, corpus.nodes.begin() + node));
+        }
+        start = node;
+    }
+    return true;
+}
+
+//------
+// timing and output
+
+static bool _json = false;
+
+// best time of one pass over the corpus, in ns
+template <typename Fn>
+static double _measure(Fn pass)
+{
+    typedef std::chrono::steady_clock clock;
+
+    double best = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        size_t passes = 0;
+        clock::time_point start = clock::now();
+        double elapsed_ns;
+        do {
+            pass();
+            ++passes;
+            elapsed_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        } while (elapsed_ns < MIN_ROUND_US * 1000.0);
+
+        double perPass = elapsed_ns / passes;
+        if (!round || perPass < best) best = perPass;
+    }
+    return best;
+}
+
+static void _report(const corpus_t & corpus, const char * kernel, const char * impl, size_t samples, double ns)
+{
+    double nsPerSample = samples ? ns / samples : 0;
+    double samplesPerSec = ns > 0 ? samples * 1e9 / ns : 0;
+    if (_json) {
+        printf("{\"corpus\":\"%s\",\"kernel\":\"%s\",\"impl\":\"%s\",\"samples\":%llu,\"ns_per_sample\":%.3f,\"samples_per_s\":%.0f}\n",
+            corpus.name.c_str(), kernel, impl, (unsigned long long)samples, nsPerSample, samplesPerSec);
+    } else {
+        printf("%-16s %-28s %-12s %9llu %10.2f %12.0f\n", corpus.name.c_str(), kernel, impl,
+            (unsigned long long)samples, nsPerSample, samplesPerSec);
+    }
+    fflush(stdout);
+}
+
+static void _reportFailure(const corpus_t & corpus, const char * kernel)
+{
+    if (_json) {
+        printf("{\"corpus\":\"%s\",\"kernel\":\"%s\",\"error\":\"failed\"}\n", corpus.name.c_str(), kernel);
+    } else {
+        printf("%-16s %-28s %-12s %9s\n", corpus.name.c_str(), kernel, "", "failed");
+    }
+}
+
+static void _reportHost()
+{
+    struct utsname host;
+    uname(&host);
+    if (_json) {
+        printf("{\"host\":\"%s\",\"arch\":\"%s\",\"kernel\":\"%s\",\"compiler\":\"%s\",\"capsule_impl\":\"%s\",\"crc32_impl\":\"%s\"}\n",
+            host.nodename, host.machine, host.release, __VERSION__,
+            CapsuleDecoder::implName(CapsuleDecoder::selectedImpl()), rp::hal::crc32_impl_name(rp::hal::crc32_selected_impl()));
+    } else {
+        printf("%s %s, capsule decoder %s, crc32 %s\n", host.machine, host.release,
+            CapsuleDecoder::implName(CapsuleDecoder::selectedImpl()), rp::hal::crc32_impl_name(rp::hal::crc32_selected_impl()));
+        printf("%-16s %-28s %-12s %9s %10s %12s\n", "corpus", "kernel", "impl", "samples", "ns/sample", "samples/s");
+    }
+}
+
+//------
+// kernels
+
+template <typename Capsule>
+static void _benchDriverDecoder(DecodeProbe & probe, const corpus_t & corpus, const char * kernel, const char * impl,
+    void (RPlidarDriverImplCommon::*decode)(const Capsule &, rplidar_response_measurement_node_hq_t *, size_t &))
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(corpus.frameSamples);
+    size_t decoded = 0;
+    double ns = _measure([&]() {
+        probe.restart();
+        decoded = 0;
+        for (size_t frame = 0; frame < corpus.frameCount; ++frame) {
+            size_t count = nodes.size();
+            (probe.*decode)(*corpus.frame<Capsule>(frame), &nodes[0], count);
+            decoded += count;
+        }
+        _sink += nodes[0].dist_mm_q2;
+    });
+    _report(corpus, kernel, impl, decoded, ns);
+}
+
+template <typename Capsule>
+static void _benchCapsuleDecoder(const corpus_t & corpus, const char * kernel,
+    size_t (*decode)(CapsuleDecoder::Impl, const Capsule &, const Capsule &, rplidar_response_measurement_node_hq_t *))
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(corpus.frameSamples);
+    for (int impl = 0; impl < CapsuleDecoder::IMPL_COUNT; ++impl) {
+        if (!CapsuleDecoder::isSupported((CapsuleDecoder::Impl)impl)) continue;
+
+        size_t decoded = 0;
+        double ns = _measure([&]() {
+            decoded = 0;
+            for (size_t frame = 0; frame + 1 < corpus.frameCount; ++frame) {
+                decoded += decode((CapsuleDecoder::Impl)impl, *corpus.frame<Capsule>(frame), *corpus.frame<Capsule>(frame + 1), &nodes[0]);
+            }
+            _sink += nodes[0].dist_mm_q2;
+        });
+        _report(corpus, kernel, CapsuleDecoder::implName((CapsuleDecoder::Impl)impl), decoded, ns);
+    }
+}
+
+static void _benchUltraDecoder(const corpus_t & corpus, const char * kernel, const char * impl,
+    size_t (*decode)(const rplidar_response_ultra_capsule_measurement_nodes_t &, const rplidar_response_ultra_capsule_measurement_nodes_t &, rplidar_response_measurement_node_hq_t *))
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(corpus.frameSamples);
+    size_t decoded = 0;
+    double ns = _measure([&]() {
+        decoded = 0;
+        for (size_t frame = 0; frame + 1 < corpus.frameCount; ++frame) {
+            decoded += decode(*corpus.frame<rplidar_response_ultra_capsule_measurement_nodes_t>(frame),
+                *corpus.frame<rplidar_response_ultra_capsule_measurement_nodes_t>(frame + 1), &nodes[0]);
+        }
+        _sink += nodes[0].dist_mm_q2;
+    });
+    _report(corpus, kernel, impl, decoded, ns);
+}
+
+static void _benchCrc32(const corpus_t & corpus)
+{
+    size_t checked = corpus.frameSize - sizeof(((rplidar_response_hq_capsule_measurement_nodes_t *)0)->crc32);
+    for (int impl = 0; impl < rp::hal::CRC32_IMPL_COUNT; ++impl) {
+        if (!rp::hal::crc32_is_supported((rp::hal::crc32_impl_t)impl)) continue;
+
+        double ns = _measure([&]() {
+            _u32 sum = 0;
+            for (size_t frame = 0; frame < corpus.frameCount; ++frame) {
+                sum += rp::hal::crc32_padded((rp::hal::crc32_impl_t)impl, &corpus.frames[frame * corpus.frameSize], checked);
+            }
+            _sink += sum;
+        });
+        _report(corpus, "crc32_padded", rp::hal::crc32_impl_name((rp::hal::crc32_impl_t)impl), corpus.frameCount * corpus.frameSamples, ns);
+    }
+}
+
+static void _benchCacheScanNodes(DecodeProbe & probe, const corpus_t & corpus)
+{
+    // in the batches the capsules deliver them
+    double ns = _measure([&]() {
+        probe.restart();
+        for (size_t pos = 0; pos < corpus.nodes.size(); pos += corpus.frameSamples) {
+            size_t count = std::min(corpus.frameSamples, corpus.nodes.size() - pos);
+            probe._cacheScanNodes(&corpus.nodes[pos], count, 0);
+        }
+    });
+    _report(corpus, "_cacheScanNodes", "", corpus.nodes.size(), ns);
+}
+
+static void _benchAscend(const corpus_t & corpus, const char * impl, u_result (*ascend)(rplidar_response_measurement_node_hq_t *, size_t))
+{
+    if (corpus.revolutions.empty()) return;
+
+    // includes restoring the unsorted revolution before every call
+    std::vector<rplidar_response_measurement_node_hq_t> work;
+    size_t samples = 0;
+    for (size_t pos = 0; pos < corpus.revolutions.size(); ++pos) samples += corpus.revolutions[pos].size();
+
+    double ns = _measure([&]() {
+        for (size_t pos = 0; pos < corpus.revolutions.size(); ++pos) {
+            work = corpus.revolutions[pos];
+            ascend(&work[0], work.size());
+            _sink += work[0].angle_z_q14;
+        }
+    });
+    _report(corpus, "ascendScanData", impl, samples, ns);
+}
+
+class CountingListener : public ScanListener
+{
+public:
+    CountingListener() : firstScan_us(0), lastScan_us(0), samples(0) {}
+
+    virtual void onScan(const rplidar_response_measurement_node_hq_t * /*nodes*/, size_t count, const RplidarScanTimestamp & /*timestamp*/)
+    {
+        // the time up to the first scan includes the partial revolution at the start
+        _u64 now = rp::arch::rp_getus();
+        if (firstScan_us) samples += count;
+        else firstScan_us = now;
+        lastScan_us = now;
+    }
+
+    _u64    firstScan_us;
+    _u64    lastScan_us;
+    size_t  samples;
+};
+
+static const char * _cacheLoopName(_u8 ansType)
+{
+    switch (ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT:                 return "_cacheScanData";
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:  return "_cacheCapsuledScanData";
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:  return "_cacheUltraCapsuledScanData";
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:              return "_cacheHqScanData";
+    }
+    return "?";
+}
+
+static void _benchCacheLoop(const corpus_t & corpus)
+{
+    // the replay driver hands the recorded bytes over as fast as they are
+    // read, so this is the receive loop without the serial port
+    const char * kernel = _cacheLoopName(corpus.ansType);
+    double best_ns = 0;
+    size_t samples = 0;
+
+    for (int round = 0; round < FULL_LOOP_ROUNDS; ++round) {
+        RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_REPLAY);
+        CountingListener listener;
+
+        bool ok = drv && IS_OK(drv->connect(corpus.path.c_str(), REPLAY_PACE_AS_FAST_AS_POSSIBLE))
+            && IS_OK(drv->setScanListener(&listener))
+            && IS_OK(drv->startMotor())
+            && IS_OK(drv->startScanExpress(false, corpus.mode));
+        if (ok) {
+            while (drv->isScanning()) delay(1);
+            drv->stop();
+        }
+        if (drv) {
+            drv->setScanListener(NULL);
+            RPlidarDriver::DisposeDriver(drv);
+        }
+
+        if (!ok || !listener.samples) {
+            _reportFailure(corpus, kernel);
+            return;
+        }
+
+        double ns = (listener.lastScan_us - listener.firstScan_us) * 1000.0;
+        if (!round || ns / listener.samples < best_ns / samples) {
+            best_ns = ns;
+            samples = listener.samples;
+        }
+    }
+    _report(corpus, kernel, "replay", samples, best_ns);
+}
+
+static void _benchCorpus(const corpus_t & corpus)
+{
+    DecodeProbe probe;
+    const char * selected = CapsuleDecoder::implName(CapsuleDecoder::selectedImpl());
+
+    switch (corpus.ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+        _benchDriverDecoder(probe, corpus, "_capsuleToNormal", selected, &DecodeProbe::_capsuleToNormal);
+        _benchCapsuleDecoder<rplidar_response_capsule_measurement_nodes_t>(corpus, "decodeCapsule", &CapsuleDecoder::decodeCapsule);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+        // the driver takes dense capsules through the classic capsule type
+        _benchDriverDecoder(probe, corpus, "_dense_capsuleToNormal", selected, &DecodeProbe::_dense_capsuleToNormal);
+        _benchCapsuleDecoder<rplidar_response_dense_capsule_measurement_nodes_t>(corpus, "decodeDenseCapsule", &CapsuleDecoder::decodeDenseCapsule);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:
+        _benchDriverDecoder(probe, corpus, "_ultraCapsuleToNormal", "table", &DecodeProbe::_ultraCapsuleToNormal);
+        _benchUltraDecoder(corpus, "decodeUltraCapsule", "table", &CapsuleDecoder::decodeUltraCapsule);
+        _benchUltraDecoder(corpus, "decodeUltraCapsule", "reference", &CapsuleDecoder::decodeUltraCapsuleReference);
+        break;
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:
+        // HQ capsules carry finished nodes, checking the CRC is all the decoding there is
+        _benchCrc32(corpus);
+        break;
+    }
+
+    if (!corpus.nodes.empty()) {
+        _benchCacheScanNodes(probe, corpus);
+        _benchAscend(corpus, "ScanSorter", &ScanSorter::ascend);
+        _benchAscend(corpus, "reference", &ScanSorter::ascendReference);
+    }
+    _benchCacheLoop(corpus);
+}
+
+//------
+// equivalence checks
+
+// fixed linear congruential sequence, so a failure shows up on every run
+static _u32 _nextRandom(_u32 & state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// the recorded capsules of a type, followed by malformed and random ones
+template <typename Capsule>
+static std::vector<Capsule> _checkCapsules(const std::vector<corpus_t> & corpora, _u8 ansType)
+{
+    std::vector<Capsule> capsules;
+    for (size_t pos = 0; pos < corpora.size(); ++pos) {
+        if (corpora[pos].ansType != ansType) continue;
+        const Capsule * first = corpora[pos].frame<Capsule>(0);
+        capsules.insert(capsules.end(), first, first + corpora[pos].frameCount);
+    }
+
+    Capsule capsule;
+    memset(&capsule, 0, sizeof(capsule));
+    capsules.push_back(capsule);
+    memset(&capsule, 0xFF, sizeof(capsule));
+    capsules.push_back(capsule);
+    capsules.push_back(capsule);
+
+    _u32 state = CHECK_SEED;
+    for (size_t count = 0; count < CHECK_RANDOM_CAPSULES; ++count) {
+        _u8 * bytes = reinterpret_cast<_u8 *>(&capsule);
+        for (size_t pos = 0; pos < sizeof(capsule); ++pos) bytes[pos] = (_u8)_nextRandom(state);
+        capsules.push_back(capsule);
+    }
+    return capsules;
+}
+
+// decodes every pair of neighbouring capsules both ways, false on the first difference
+template <typename Capsule, typename Decode, typename Expect>
+static bool _checkDecoder(const std::vector<Capsule> & capsules, const char * kernel, const char * impl, const char * expectImpl,
+    Decode decode, Expect expect)
+{
+    rplidar_response_measurement_node_hq_t nodes[CHECK_MAX_CAPSULE_NODES];
+    rplidar_response_measurement_node_hq_t expected[CHECK_MAX_CAPSULE_NODES];
+
+    for (size_t pos = 0; pos + 1 < capsules.size(); ++pos) {
+        memset(nodes, 0, sizeof(nodes));
+        memset(expected, 0, sizeof(expected));
+        size_t count = decode(capsules[pos], capsules[pos + 1], nodes);
+        size_t expectedCount = expect(capsules[pos], capsules[pos + 1], expected);
+
+        if (count != expectedCount) {
+            fprintf(stderr, "%s %s: capsule %zu gives %zu nodes, %s gives %zu\n", kernel, impl, pos, count, expectImpl, expectedCount);
+            return false;
+        }
+        for (size_t node = 0; node < count; ++node) {
+            if (!memcmp(&nodes[node], &expected[node], sizeof(nodes[node]))) continue;
+
+            fprintf(stderr, "%s %s: capsule %zu node %zu is angle %u dist %u quality %u flag %u, %s gives angle %u dist %u quality %u flag %u\n",
+                kernel, impl, pos, node,
+                nodes[node].angle_z_q14, nodes[node].dist_mm_q2, nodes[node].quality, nodes[node].flag, expectImpl,
+                expected[node].angle_z_q14, expected[node].dist_mm_q2, expected[node].quality, expected[node].flag);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Capsule>
+static bool _checkImpls(const std::vector<corpus_t> & corpora, _u8 ansType, const char * kernel,
+    size_t (*decode)(CapsuleDecoder::Impl, const Capsule &, const Capsule &, rplidar_response_measurement_node_hq_t *))
+{
+    std::vector<Capsule> capsules = _checkCapsules<Capsule>(corpora, ansType);
+    const char * scalar = CapsuleDecoder::implName(CapsuleDecoder::IMPL_SCALAR);
+
+    bool ok = true;
+    for (int impl = CapsuleDecoder::IMPL_SCALAR + 1; impl < CapsuleDecoder::IMPL_COUNT; ++impl) {
+        if (!CapsuleDecoder::isSupported((CapsuleDecoder::Impl)impl)) continue;
+
+        ok = _checkDecoder(capsules, kernel, CapsuleDecoder::implName((CapsuleDecoder::Impl)impl), scalar,
+            [impl, decode](const Capsule & capsule, const Capsule & next, rplidar_response_measurement_node_hq_t * nodes) {
+                return decode((CapsuleDecoder::Impl)impl, capsule, next, nodes);
+            },
+            [decode](const Capsule & capsule, const Capsule & next, rplidar_response_measurement_node_hq_t * nodes) {
+                return decode(CapsuleDecoder::IMPL_SCALAR, capsule, next, nodes);
+            }) && ok;
+    }
+    return ok;
+}
+
+// the bulk ultra decoder against the reference run capsule by capsule
+static bool _checkUltraCapsules(const std::vector<rplidar_response_ultra_capsule_measurement_nodes_t> & capsules)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(capsules.size() * CapsuleDecoder::ULTRA_CAPSULE_NODES);
+    std::vector<rplidar_response_measurement_node_hq_t> expected(nodes.size());
+
+    size_t count = CapsuleDecoder::decodeUltraCapsules(&capsules[0], capsules.size(), &nodes[0]);
+    size_t expectedCount = 0;
+    for (size_t pos = 0; pos + 1 < capsules.size(); ++pos) {
+        expectedCount += CapsuleDecoder::decodeUltraCapsuleReference(capsules[pos], capsules[pos + 1], &expected[expectedCount]);
+    }
+
+    if (count != expectedCount) {
+        fprintf(stderr, "decodeUltraCapsules: %zu nodes, reference gives %zu\n", count, expectedCount);
+        return false;
+    }
+    for (size_t node = 0; node < count; ++node) {
+        if (!memcmp(&nodes[node], &expected[node], sizeof(nodes[node]))) continue;
+
+        fprintf(stderr, "decodeUltraCapsules: node %zu is angle %u dist %u quality %u flag %u, reference gives angle %u dist %u quality %u flag %u\n",
+            node, nodes[node].angle_z_q14, nodes[node].dist_mm_q2, nodes[node].quality, nodes[node].flag,
+            expected[node].angle_z_q14, expected[node].dist_mm_q2, expected[node].quality, expected[node].flag);
+        return false;
+    }
+    return true;
+}
+
+static bool _checkUltraDecoder(const std::vector<corpus_t> & corpora)
+{
+    typedef rplidar_response_ultra_capsule_measurement_nodes_t capsule_t;
+    std::vector<capsule_t> capsules = _checkCapsules<capsule_t>(corpora, RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA);
+
+    bool ok = _checkDecoder(capsules, "decodeUltraCapsule", "table", "reference",
+        &CapsuleDecoder::decodeUltraCapsule, &CapsuleDecoder::decodeUltraCapsuleReference);
+    return _checkUltraCapsules(capsules) && ok;
+}
+
+static bool _checkDecoders(const std::vector<corpus_t> & corpora)
+{
+    bool ok = _checkImpls<rplidar_response_capsule_measurement_nodes_t>(corpora,
+        RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED, "decodeCapsule", &CapsuleDecoder::decodeCapsule);
+    ok = _checkImpls<rplidar_response_dense_capsule_measurement_nodes_t>(corpora,
+        RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED, "decodeDenseCapsule", &CapsuleDecoder::decodeDenseCapsule) && ok;
+    ok = _checkUltraDecoder(corpora) && ok;
+    return ok;
+}
+
+//------
+// corpus capture
+
+static bool _capture(RPlidarDriver * drv, const char * port, _u32 baudrate, _u16 mode, const char * path, int seconds)
+{
+    bool ok = IS_OK(drv->startRecording(path))
+        && IS_OK(drv->connect(port, baudrate))
+        && IS_OK(drv->startMotor())
+        && IS_OK(drv->startScanExpress(false, mode));
+    if (ok) {
+        delay(seconds * 1000);
+        drv->stop();
+    }
+    drv->stopRecording();
+    drv->stopMotor();
+    drv->disconnect();
+    return ok;
+}
+
+static int _captureMain(int argc, const char * argv[])
+{
+    if (argc < 6) {
+        fprintf(stderr, "usage: %s capture <port> <baudrate> <scan mode id> <file> [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    bool ok = _capture(drv, argv[2], (_u32)atoi(argv[3]), (_u16)atoi(argv[4]), argv[5], (argc > 6) ? atoi(argv[6]) : 3);
+    RPlidarDriver::DisposeDriver(drv);
+
+    if (!ok) fprintf(stderr, "cannot capture from %s\n", argv[2]);
+    return ok ? 0 : 1;
+}
+
+static bool _captureEmulated(_u16 mode, const char * path)
+{
+    LidarEmulator emulator;
+    LidarEmulator::config_t config;
+    config.sampleRate = 32000;
+    config.addBox(5000, 1000, 600, 400);
+    config.addBox(1200, 4200, 300, 900);
+    if (!emulator.start(config)) return false;
+
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    // fast enough for HQ capsules at 32k samples/s
+    bool ok = _capture(drv, emulator.devicePath(), 4000000, mode, path, 2);
+    RPlidarDriver::DisposeDriver(drv);
+    emulator.stop();
+    return ok;
+}
+
+// the corpus files given, or corpora captured from the emulator without any
+static bool _loadCorpora(int first, int argc, const char * argv[], std::vector<corpus_t> & corpora)
+{
+    if (first < argc) {
+        for (int arg = first; arg < argc; ++arg) {
+            corpus_t corpus;
+            const char * name = strrchr(argv[arg], '/');
+            if (!_loadCorpus(argv[arg], name ? name + 1 : argv[arg], corpus)) {
+                fprintf(stderr, "%s holds no usable scan\n", argv[arg]);
+                return false;
+            }
+            corpora.push_back(corpus);
+        }
+    } else {
+        static const _u16 MODES[] = {
+            LidarEmulator::MODE_EXPRESS,
+            LidarEmulator::MODE_BOOST,
+            LidarEmulator::MODE_SENSITIVITY,
+            LidarEmulator::MODE_HQ,
+        };
+
+        for (size_t pos = 0; pos < _countof(MODES); ++pos) {
+            char path[] = "/tmp/decode_bench_XXXXXX";
+            int fd = mkstemp(path);
+            if (fd == -1) return false;
+            ::close(fd);
+
+            corpus_t corpus;
+            std::string name = std::string("emu-") + LidarEmulator::ModeName(MODES[pos]);
+            bool ok = _captureEmulated(MODES[pos], path) && _loadCorpus(path, name.c_str(), corpus);
+            if (ok) {
+                // the full loop replays the file, it is removed once done
+                corpora.push_back(corpus);
+            } else {
+                fprintf(stderr, "cannot capture a %s corpus from the emulator\n", LidarEmulator::ModeName(MODES[pos]));
+                unlink(path);
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], "capture")) return _captureMain(argc, argv);
+
+    int first = 1;
+    bool checkOnly = false;
+    if (argc > 1 && !strcmp(argv[1], "-j")) {
+        _json = true;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "check")) {
+        checkOnly = true;
+        first = 2;
+    }
+
+    std::vector<corpus_t> corpora;
+    if (!_loadCorpora(first, argc, argv, corpora)) return 1;
+
+    // a kernel that decodes differently is not worth timing
+    bool ok = _checkDecoders(corpora);
+    if (ok && checkOnly) printf("every decoder matches its reference\n");
+
+    if (ok && !checkOnly) {
+        _reportHost();
+        for (size_t pos = 0; pos < corpora.size(); ++pos) {
+            _benchCorpus(corpora[pos]);
+        }
+    }
+
+    if (first >= argc) {
+        for (size_t pos = 0; pos < corpora.size(); ++pos) unlink(corpora[pos].path.c_str());
+    }
+    return ok ? 0 : 2;
+}
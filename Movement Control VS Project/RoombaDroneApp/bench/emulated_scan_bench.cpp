@@ -0,0 +1,183 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Throughput and latency of the serial driver against LidarEmulator, for the
+// 16k and 32k samples/s rates of the newer units, without any hardware.
+//
+// Latency is measured from the time the first sample of a revolution was due
+// on the emulated device to the ScanListener::onScan call completing the
+// previous revolution. It includes collecting the capsule and the transfer
+// time at the chosen baudrate.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -Isrc -o emulated_scan_bench
+//       bench/emulated_scan_bench.cpp bench/lidar_emulator.cpp src/*.cpp
+//       src/hal/*.cpp src/arch/linux/*.cpp
+//
+// Run: emulated_scan_bench [seconds per run] [baudrate]
+
+#include "src/sdkcommon.h"
+#include "bench/lidar_emulator.h"
+#include "rplidar.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+class LatencyListener : public ScanListener
+{
+public:
+    explicit LatencyListener(const LidarEmulator & emulator)
+        : _emulator(emulator), _samples(0)
+    {}
+
+    virtual void onScan(const rplidar_response_measurement_node_hq_t * /*nodes*/, size_t count, const RplidarScanTimestamp & /*timestamp*/)
+    {
+        _u64 now = rp::arch::rp_getus();
+        _u64 due = _emulator.lastRevolutionTs();
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (due && now > due) _latencies.push_back((double)(now - due));
+        _samples += count;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _latencies.clear();
+        _samples = 0;
+    }
+
+    void collect(std::vector<double> & latencies, _u64 & samples)
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        latencies = _latencies;
+        samples = _samples;
+    }
+
+protected:
+    const LidarEmulator &   _emulator;
+    std::mutex              _mutex;
+    std::vector<double>     _latencies;
+    _u64                    _samples;
+};
+
+static void _run(_u32 sampleRate, _u16 mode, int seconds, _u32 baudrate)
+{
+    LidarEmulator emulator;
+    LidarEmulator::config_t config;
+    config.sampleRate = sampleRate;
+    config.addBox(5000, 1000, 600, 400);
+    if (!emulator.start(config)) {
+        printf("%6u %-12s %9s\n", sampleRate, LidarEmulator::ModeName(mode), "no pty");
+        return;
+    }
+
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    LatencyListener listener(emulator);
+
+    bool ok = drv && IS_OK(drv->connect(emulator.devicePath(), baudrate))
+        && IS_OK(drv->setScanListener(&listener))
+        && IS_OK(drv->startMotor())
+        && IS_OK(drv->startScanExpress(false, mode));
+
+    if (ok) {
+        // let the first revolutions settle before measuring
+        delay(500);
+        listener.reset();
+        LidarEmulator::stats_t before = emulator.stats();
+        _u64 start = rp::arch::rp_getus();
+
+        delay(seconds * 1000);
+
+        _u64 elapsed = rp::arch::rp_getus() - start;
+        LidarEmulator::stats_t after = emulator.stats();
+        std::vector<double> latencies;
+        _u64 samples;
+        listener.collect(latencies, samples);
+
+        drv->stop();
+        drv->stopMotor();
+
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (size_t pos = 0; pos < latencies.size(); ++pos) sum += latencies[pos];
+        size_t last = latencies.empty() ? 0 : latencies.size() - 1;
+
+        printf("%6u %-12s %10.0f %7.2f %9.1f %9.1f %9.1f %9.1f %8llu\n", sampleRate, LidarEmulator::ModeName(mode),
+            samples * 1e6 / elapsed, latencies.size() * 1e6 / elapsed,
+            latencies.empty() ? 0 : sum / latencies.size(),
+            latencies.empty() ? 0 : latencies[last / 2],
+            latencies.empty() ? 0 : latencies[last * 99 / 100],
+            latencies.empty() ? 0 : latencies[last],
+            (unsigned long long)(after.overruns - before.overruns));
+    } else {
+        printf("%6u %-12s %9s\n", sampleRate, LidarEmulator::ModeName(mode), "failed");
+    }
+
+    if (drv) {
+        drv->setScanListener(NULL);
+        RPlidarDriver::DisposeDriver(drv);
+    }
+    emulator.stop();
+}
+
+int main(int argc, const char * argv[])
+{
+    int seconds    = (argc > 1) ? atoi(argv[1]) : 3;
+    _u32 baudrate  = (argc > 2) ? (_u32)atoi(argv[2]) : 1000000;
+
+    static const _u32 RATES[] = { 16000, 32000 };
+    static const _u16 MODES[] = {
+        LidarEmulator::MODE_EXPRESS,
+        LidarEmulator::MODE_BOOST,
+        LidarEmulator::MODE_SENSITIVITY,
+        LidarEmulator::MODE_HQ,
+    };
+
+    printf("%d s per run at %u baud, latency from revolution start to onScan\n", seconds, baudrate);
+    printf("%6s %-12s %10s %7s %9s %9s %9s %9s %8s\n", "rate", "mode", "samples/s", "scans/s",
+        "mean_us", "p50_us", "p99_us", "max_us", "overruns");
+
+    for (size_t rate = 0; rate < _countof(RATES); ++rate) {
+        for (size_t mode = 0; mode < _countof(MODES); ++mode) {
+            _run(RATES[rate], MODES[mode], seconds, baudrate);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+// Cost of rp::hal::Event on Linux, the futex backend in hal/event.h against
+// the pthread condition variable it replaced:
+//  - wake-up latency, from set() to the sleeping waiter returning from wait()
+//  - set() with nobody waiting and wait() on an already signalled event,
+//    the paths the cache thread and grabScanDataHq take while scans keep up
+//  - how far a 2 ms timed-out wait overshoots its deadline
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -o event_wakeup_bench
+//       bench/event_wakeup_bench.cpp src/arch/linux/timer.cpp
+//
+// Usage: event_wakeup_bench [wakeups] [fast_path_loops]
+
+#include "src/sdkcommon.h"
+#include "src/hal/event.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// The Linux branch of hal::Event before the futex backend, kept verbatim
+// apart from the Windows branches.
+class LegacyEvent
+{
+public:
+    
+    enum 
+    {
+        EVENT_OK = 1,
+        EVENT_TIMEOUT = -1,
+        EVENT_FAILED = 0,
+    };
+    
+    LegacyEvent(bool isAutoReset = true, bool isSignal = false)
+        : _is_signalled(isSignal)
+        , _isAutoReset(isAutoReset)
+    {
+        pthread_mutex_init(&_cond_locker, NULL);
+        pthread_cond_init(&_cond_var, NULL);
+    }
+
+    ~ LegacyEvent()
+    {
+        pthread_mutex_destroy(&_cond_locker);
+        pthread_cond_destroy(&_cond_var);
+    }
+
+    void set( bool isSignal = true )
+    {
+        if (isSignal){
+            pthread_mutex_lock(&_cond_locker);
+               
+            if ( _is_signalled == false )
+            {
+                _is_signalled = true;
+                pthread_cond_signal(&_cond_var);
+            }
+            pthread_mutex_unlock(&_cond_locker);
+        }
+        else
+        {
+            pthread_mutex_lock(&_cond_locker);
+            _is_signalled = false;
+            pthread_mutex_unlock(&_cond_locker);
+        }
+    }
+    
+    int wait( unsigned long timeout = 0xFFFFFFFF )
+    {
+        unsigned long ans = EVENT_OK;
+        pthread_mutex_lock( &_cond_locker );
+
+        if ( !_is_signalled )
+        {
+            
+                if (timeout == 0xFFFFFFFF){
+                    pthread_cond_wait(&_cond_var,&_cond_locker);
+                }else
+                {
+                    timespec wait_time;
+                    timeval now;
+                    gettimeofday(&now,NULL);
+
+                    wait_time.tv_sec = timeout/1000 + now.tv_sec;
+                    wait_time.tv_nsec = (timeout%1000)*1000000ULL + now.tv_usec*1000;
+                
+                    if (wait_time.tv_nsec >= 1000000000)
+                    {
+                       ++wait_time.tv_sec;
+                       wait_time.tv_nsec -= 1000000000;
+                    }
+                    switch (pthread_cond_timedwait(&_cond_var,&_cond_locker,&wait_time))
+                    {
+                    case 0:
+                        // signalled
+                        break;
+                    case ETIMEDOUT:
+                        // time up
+                        ans = EVENT_TIMEOUT;
+                        goto _final;
+                        break;
+                    default:
+                        ans = EVENT_FAILED;
+                        goto _final;
+                    }
+       
+            }
+        }
+          
+        assert(_is_signalled);
+
+        if ( _isAutoReset )
+        {
+            _is_signalled = false;
+        }
+_final:
+        pthread_mutex_unlock( &_cond_locker );
+
+        return ans;
+    }
+
+protected:
+        pthread_cond_t         _cond_var;
+        pthread_mutex_t        _cond_locker;
+        bool                   _is_signalled;
+        bool                   _isAutoReset;
+};
+
+static _u64 _getNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (_u64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// returns the wake-up latencies in microseconds
+template <class EventT>
+static std::vector<double> _measureWakeup(int wakeups)
+{
+    EventT wakeEvt, ackEvt;
+    std::atomic<_u64> setTs(0);
+    std::vector<double> latencies;
+
+    std::thread waiter([&]() {
+        for (int pos = 0; pos < wakeups; ++pos) {
+            if (wakeEvt.wait(1000) != EventT::EVENT_OK) break;
+            latencies.push_back((_getNs() - setTs.load()) / 1000.0);
+            ackEvt.set();
+        }
+    });
+
+    for (int pos = 0; pos < wakeups; ++pos) {
+        // let the waiter get back to sleep, the fast path is measured separately
+        usleep(200);
+        setTs.store(_getNs());
+        wakeEvt.set();
+        if (ackEvt.wait(1000) != EventT::EVENT_OK) break;
+    }
+    waiter.join();
+    return latencies;
+}
+
+// returns the nanoseconds of a set() with no waiter and of a wait() on a signalled event
+template <class EventT>
+static void _measureFastPath(int loops, double & setNs, double & waitNs)
+{
+    EventT evt;
+
+    _u64 setTotal = 0, waitTotal = 0;
+    for (int pos = 0; pos < loops; ++pos) {
+        _u64 t0 = _getNs();
+        evt.set();
+        _u64 t1 = _getNs();
+        evt.wait(1000);
+        _u64 t2 = _getNs();
+
+        setTotal += t1 - t0;
+        waitTotal += t2 - t1;
+    }
+    setNs = (double)setTotal / loops;
+    waitNs = (double)waitTotal / loops;
+}
+
+// returns the mean microseconds a 2 ms wait on an event nobody sets returns late
+template <class EventT>
+static double _measureTimeoutOvershoot(int waits)
+{
+    EventT evt;
+
+    double total = 0;
+    for (int pos = 0; pos < waits; ++pos) {
+        _u64 t0 = _getNs();
+        evt.wait(2);
+        total += (_getNs() - t0) / 1000.0 - 2000;
+    }
+    return total / waits;
+}
+
+template <class EventT>
+static void _report(const char * backend, int wakeups, int loops)
+{
+    std::vector<double> latencies = _measureWakeup<EventT>(wakeups);
+    double setNs, waitNs;
+    _measureFastPath<EventT>(loops, setNs, waitNs);
+    double overshoot = _measureTimeoutOvershoot<EventT>(50);
+
+    if (latencies.size() != (size_t)wakeups) {
+        printf("%-7s %9s\n", backend, "failed");
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double sum = 0;
+    for (size_t pos = 0; pos < latencies.size(); ++pos) sum += latencies[pos];
+
+    size_t last = latencies.size() - 1;
+    printf("%-7s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", backend, sum / latencies.size(),
+        latencies[last / 2], latencies[last * 9 / 10], latencies[last * 99 / 100], latencies[last],
+        setNs, waitNs, overshoot);
+}
+
+int main(int argc, const char * argv[])
+{
+    int wakeups = (argc > 1) ? atoi(argv[1]) : 2000;
+    int loops   = (argc > 2) ? atoi(argv[2]) : 1000000;
+
+    printf("%d wake-ups, %d fast path loops\n", wakeups, loops);
+    printf("%-7s %9s %9s %9s %9s %9s %9s %9s %9s\n", "backend", "mean_us", "p50_us", "p90_us", "p99_us", "max_us",
+        "set_ns", "wait_ns", "late_us");
+
+    _report<LegacyEvent>("condvar", wakeups, loops);
+    _report<rp::hal::Event>("futex", wakeups, loops);
+    return 0;
+}
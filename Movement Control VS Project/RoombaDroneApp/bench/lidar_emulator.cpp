@@ -0,0 +1,907 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "lidar_emulator.h"
+#include "src/hal/crc32.h"
+
+#include <algorithm>
+#include <math.h>
+#include <poll.h>
+
+// the termios2 interface, as used by net_serial.cpp, to read and set any baudrate
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+static const double PI = 3.1415926535;
+
+static const _u8 NODE_QUALITY = 0x2f;
+static const _u32 IDLE_POLL_US = 10000;
+
+// as RPlidarDriverImplCommon::RPLIDAR_TOF_MINUM_MAJOR_ID
+static const _u8 TOF_MINUM_MAJOR_ID = 5;
+
+//------
+// distance encodings
+
+static _u32 _varbitscaleEncode(_u32 dist, _u32 & scaleLevel)
+{
+    static const _u32 SRC_BASE[] = {
+        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+        0,
+    };
+    static const _u32 DEST_BASE[] = {
+        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+        0,
+    };
+
+    for (size_t i = 0; i < _countof(SRC_BASE); ++i) {
+        if (dist >= SRC_BASE[i]) {
+            scaleLevel = (_u32)(_countof(SRC_BASE) - 1 - i);
+            _u32 scaled = DEST_BASE[i] + ((dist - SRC_BASE[i]) >> scaleLevel);
+            return scaled > 0xFFF ? 0 : scaled;
+        }
+    }
+    scaleLevel = 0;
+    return 0;
+}
+
+// the decoding of rplidar_capsule_decoder.cpp
+static _u32 _varbitscaleDecode(_u32 scaled, _u32 & scaleLevel)
+{
+    static const _u32 SCALED_BASE[] = {
+        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+        0,
+    };
+    static const _u32 TARGET_BASE[] = {
+        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+        0,
+    };
+
+    for (size_t i = 0; i < _countof(SCALED_BASE); ++i) {
+        if (scaled >= SCALED_BASE[i]) {
+            scaleLevel = (_u32)(_countof(SCALED_BASE) - 1 - i);
+            return TARGET_BASE[i] + ((scaled - SCALED_BASE[i]) << scaleLevel);
+        }
+    }
+    scaleLevel = 0;
+    return 0;
+}
+
+// 10 bit signed difference to the base, 0x1FF marks a sample without a return
+static _u32 _ultraPredict(_u32 dist, _u32 base, _u32 scaleLevel)
+{
+    if (!dist) return 0x1FF;
+
+    int delta = ((int)dist - (int)base) >> scaleLevel;
+    if (delta < -511 || delta > 510) return 0x1FF;
+    return (_u32)delta & 0x3FF;
+}
+
+// the angle correction the driver subtracts from ultra capsule samples, degree
+static double _ultraAngleOffset(_u32 dist_mm)
+{
+    int dist_q2 = (int)dist_mm * 4;
+    int offset_q16 = (int)(7.5 * PI * (1 << 16) / 180.0);
+    if (dist_q2 >= (50 * 4)) {
+        const int k1 = 98361;
+        const int k2 = k1 / dist_q2;
+        offset_q16 = (int)(8 * PI * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+    }
+    return offset_q16 * 180 / PI / 65536.0;
+}
+
+static _u8 _capsuleChecksum(const _u8 * frame, size_t frameSize)
+{
+    _u8 checksum = 0;
+    for (size_t pos = 2; pos < frameSize; ++pos) {
+        checksum ^= frame[pos];
+    }
+    return checksum;
+}
+
+static void _sealCapsule(_u8 * frame, size_t frameSize)
+{
+    _u8 checksum = _capsuleChecksum(frame, frameSize);
+    frame[0] = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4) | (checksum & 0xF);
+    frame[1] = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4) | (checksum >> 4);
+}
+
+static _u16 _startAngle_q6(float angle, bool sync)
+{
+    return (_u16)((_u32)(angle * 64) & 0x7FFF) | (sync ? RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT : 0);
+}
+
+template <typename T>
+static void _append(std::vector<_u8> & frame, const T & value)
+{
+    const _u8 * bytes = reinterpret_cast<const _u8 *>(&value);
+    frame.insert(frame.end(), bytes, bytes + sizeof(value));
+}
+
+//------
+// configuration
+
+LidarEmulator::config_t::config_t()
+    : model(0x31)
+    , firmware((1 << 8) | 29)
+    , hardware(6)
+    , motorCtrl(true)
+    , sampleRate(16000)
+    , rpm(600)
+    , rpmJitter(0.002f)
+    , typicalMode(MODE_SENSITIVITY)
+    , maxDistance_m(25)
+    , baudrate(0)
+    , x(0)
+    , y(0)
+{
+    setRoom(8000, 6000);
+}
+
+void LidarEmulator::config_t::setRoom(float width, float depth)
+{
+    room.clear();
+    addBox(0, 0, width, depth);
+    x = width / 2;
+    y = depth / 2;
+}
+
+void LidarEmulator::config_t::addBox(float x, float y, float width, float depth)
+{
+    segment_t walls[4] = {
+        { x, y, x + width, y },
+        { x + width, y, x + width, y + depth },
+        { x + width, y + depth, x, y + depth },
+        { x, y + depth, x, y },
+    };
+    room.insert(room.end(), walls, walls + 4);
+}
+
+//------
+// scan modes
+
+const char * LidarEmulator::ModeName(_u16 mode)
+{
+    switch (mode) {
+    case MODE_STANDARD:    return "Standard";
+    case MODE_EXPRESS:     return "Express";
+    case MODE_BOOST:       return "Boost";
+    case MODE_SENSITIVITY: return "Sensitivity";
+    case MODE_HQ:          return "HQ";
+    }
+    return "";
+}
+
+_u8 LidarEmulator::ModeAnsType(_u16 mode)
+{
+    switch (mode) {
+    case MODE_STANDARD:    return RPLIDAR_ANS_TYPE_MEASUREMENT;
+    case MODE_EXPRESS:     return RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
+    case MODE_BOOST:       return RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA;
+    case MODE_SENSITIVITY: return RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED;
+    case MODE_HQ:          return RPLIDAR_ANS_TYPE_MEASUREMENT_HQ;
+    }
+    return 0;
+}
+
+size_t LidarEmulator::ModeFrameSamples(_u16 mode)
+{
+    switch (mode) {
+    case MODE_STANDARD:    return 1;
+    case MODE_EXPRESS:     return 2 * _countof(((rplidar_response_capsule_measurement_nodes_t *)0)->cabins);
+    case MODE_BOOST:       return 3 * _countof(((rplidar_response_ultra_capsule_measurement_nodes_t *)0)->ultra_cabins);
+    case MODE_SENSITIVITY: return _countof(((rplidar_response_dense_capsule_measurement_nodes_t *)0)->cabins);
+    case MODE_HQ:          return _countof(((rplidar_response_hq_capsule_measurement_nodes_t *)0)->node_hq);
+    }
+    return 0;
+}
+
+static size_t _modeFrameBytes(_u16 mode)
+{
+    switch (mode) {
+    case LidarEmulator::MODE_STANDARD:    return sizeof(rplidar_response_measurement_node_t);
+    case LidarEmulator::MODE_EXPRESS:     return sizeof(rplidar_response_capsule_measurement_nodes_t);
+    case LidarEmulator::MODE_BOOST:       return sizeof(rplidar_response_ultra_capsule_measurement_nodes_t);
+    case LidarEmulator::MODE_SENSITIVITY: return sizeof(rplidar_response_dense_capsule_measurement_nodes_t);
+    case LidarEmulator::MODE_HQ:          return sizeof(rplidar_response_hq_capsule_measurement_nodes_t);
+    }
+    return 0;
+}
+
+//------
+
+LidarEmulator::LidarEmulator()
+    : _masterFd(-1)
+    , _slaveFd(-1)
+    , _quit(false)
+    , _pwm(0)
+    , _tofRpm(0)
+    , _scanning(false)
+    , _scanMode(MODE_STANDARD)
+    , _firstFrame(false)
+    , _angle(0)
+    , _rpmScale(1)
+    , _revolutionStart(false)
+    , _nextSampleTs_us(0)
+    , _baudrate(115200)
+    , _lineFree_us(0)
+    , _epoch_us(0)
+    , _lastRevolutionTs(0)
+    , _statSamples(0), _statFrames(0), _statBytes(0), _statOverruns(0), _statCommands(0), _statBadCommands(0)
+{
+}
+
+LidarEmulator::~LidarEmulator()
+{
+    stop();
+}
+
+bool LidarEmulator::start(const config_t & config)
+{
+    if (_masterFd != -1) return false;
+
+    _masterFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_masterFd == -1 || grantpt(_masterFd) || unlockpt(_masterFd)) {
+        stop();
+        return false;
+    }
+    _slavePath = ptsname(_masterFd);
+
+    // keep the slave open, a pseudo terminal hangs up whenever the last
+    // slave descriptor is closed, e.g. between two connects of the driver
+    _slaveFd = ::open(_slavePath.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_slaveFd == -1) {
+        stop();
+        return false;
+    }
+
+    // raw until the driver sets its own mode, so nothing is echoed back
+    struct termios2 tio;
+    ioctl(_slaveFd, TCGETS2, &tio);
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = BOTHER | CLOCAL | CREAD | CS8;
+    tio.c_ispeed = tio.c_ospeed = 115200;
+    ioctl(_slaveFd, TCSETS2, &tio);
+
+    if (!config.linkPath.empty()) {
+        unlink(config.linkPath.c_str());
+        if (symlink(_slavePath.c_str(), config.linkPath.c_str())) {
+            stop();
+            return false;
+        }
+    }
+
+    _config = config;
+    _pwm = 0;
+    _tofRpm = config.rpm;
+    _scanning = false;
+    _angle = 0;
+    _rpmScale = 1;
+    _revolutionStart = false;
+    _random.seed(1);
+    _epoch_us = rp::arch::rp_getus();
+    _rxBuffer.clear();
+    _samples.clear();
+    _statSamples = _statFrames = _statBytes = _statOverruns = _statCommands = _statBadCommands = 0;
+
+    _quit = false;
+    _thread = std::thread(&LidarEmulator::_threadProc, this);
+    return true;
+}
+
+void LidarEmulator::stop()
+{
+    _quit = true;
+    if (_thread.joinable()) _thread.join();
+
+    if (_slaveFd != -1) ::close(_slaveFd);
+    if (_masterFd != -1) ::close(_masterFd);
+    _slaveFd = _masterFd = -1;
+
+    if (!_config.linkPath.empty()) {
+        unlink(_config.linkPath.c_str());
+        _config.linkPath.clear();
+    }
+}
+
+LidarEmulator::stats_t LidarEmulator::stats() const
+{
+    stats_t stats;
+    stats.samples = _statSamples;
+    stats.frames = _statFrames;
+    stats.bytes = _statBytes;
+    stats.overruns = _statOverruns;
+    stats.commands = _statCommands;
+    stats.badCommands = _statBadCommands;
+    return stats;
+}
+
+void LidarEmulator::_threadProc()
+{
+    while (!_quit) {
+        _u64 now_us = rp::arch::rp_getus();
+        if (_scanning) {
+            _generateSamples(now_us);
+            _emitFrames(now_us);
+        }
+
+        _u64 wakeup_us = _nextWakeup(now_us);
+        _u64 wait_us = wakeup_us > now_us ? std::min<_u64>(wakeup_us - now_us, IDLE_POLL_US) : 0;
+
+        struct timespec timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = (long)(wait_us * 1000);
+
+        struct pollfd pfd;
+        pfd.fd = _masterFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (ppoll(&pfd, 1, &timeout, NULL) > 0 && (pfd.revents & POLLIN)) {
+            _handleInput();
+        }
+    }
+}
+
+//------
+// commands
+
+void LidarEmulator::_handleInput()
+{
+    _u8 buffer[512];
+    ssize_t received = ::read(_masterFd, buffer, sizeof(buffer));
+    if (received <= 0) return;
+    _rxBuffer.insert(_rxBuffer.end(), buffer, buffer + received);
+
+    size_t pos = 0;
+    while (pos < _rxBuffer.size()) {
+        const _u8 * packet = &_rxBuffer[pos];
+        size_t remaining = _rxBuffer.size() - pos;
+
+        if (packet[0] != RPLIDAR_CMD_SYNC_BYTE) {
+            ++pos;
+            continue;
+        }
+        if (remaining < 2) break;
+
+        _u8 cmd = packet[1];
+        if (!(cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD)) {
+            _handleCommand(cmd, NULL, 0);
+            pos += 2;
+            continue;
+        }
+
+        // sync, cmd, size, payload, checksum
+        if (remaining < 3 || remaining < (size_t)packet[2] + 4) break;
+        size_t size = packet[2];
+
+        _u8 checksum = 0;
+        for (size_t i = 0; i < size + 3; ++i) checksum ^= packet[i];
+        if (checksum == packet[size + 3]) {
+            _handleCommand(cmd, packet + 3, size);
+        } else {
+            ++_statBadCommands;
+        }
+        pos += size + 4;
+    }
+    _rxBuffer.erase(_rxBuffer.begin(), _rxBuffer.begin() + pos);
+}
+
+void LidarEmulator::_handleCommand(_u8 cmd, const _u8 * payload, size_t size)
+{
+    ++_statCommands;
+
+    switch (cmd) {
+    case RPLIDAR_CMD_STOP:
+        _stopScan();
+        break;
+
+    case RPLIDAR_CMD_RESET:
+        _stopScan();
+        _pwm = 0;
+        _tofRpm = _config.rpm;
+        break;
+
+    case RPLIDAR_CMD_SCAN:
+    case RPLIDAR_CMD_FORCE_SCAN:
+        _startScan(MODE_STANDARD);
+        break;
+
+    case RPLIDAR_CMD_GET_DEVICE_INFO:
+        {
+            rplidar_response_device_info_t info;
+            info.model = _config.model;
+            info.firmware_version = _config.firmware;
+            info.hardware_version = _config.hardware;
+            for (size_t i = 0; i < sizeof(info.serialnum); ++i) {
+                info.serialnum[i] = (_u8)(0xE0 + i);
+            }
+            _answer(RPLIDAR_ANS_TYPE_DEVINFO, &info, sizeof(info));
+        }
+        break;
+
+    case RPLIDAR_CMD_GET_DEVICE_HEALTH:
+        {
+            rplidar_response_device_health_t health;
+            health.status = RPLIDAR_STATUS_OK;
+            health.error_code = 0;
+            _answer(RPLIDAR_ANS_TYPE_DEVHEALTH, &health, sizeof(health));
+        }
+        break;
+
+    case RPLIDAR_CMD_GET_SAMPLERATE:
+        {
+            rplidar_response_sample_rate_t rate;
+            rate.std_sample_duration_us = (_u16)(1000000 / STANDARD_SAMPLE_RATE);
+            rate.express_sample_duration_us = (_u16)(1000000 / _config.sampleRate);
+            _answer(RPLIDAR_ANS_TYPE_SAMPLE_RATE, &rate, sizeof(rate));
+        }
+        break;
+
+    case RPLIDAR_CMD_EXPRESS_SCAN:
+        {
+            if (size < sizeof(rplidar_payload_express_scan_t)) {
+                ++_statBadCommands;
+                break;
+            }
+            // working mode 0 is the legacy express scan
+            _u16 mode = reinterpret_cast<const rplidar_payload_express_scan_t *>(payload)->working_mode;
+            if (!mode) mode = MODE_EXPRESS;
+            if (mode >= MODE_COUNT) {
+                ++_statBadCommands;
+                break;
+            }
+            _startScan(mode);
+        }
+        break;
+
+    case RPLIDAR_CMD_HQ_SCAN:
+        _startScan(MODE_HQ);
+        break;
+
+    case RPLIDAR_CMD_GET_LIDAR_CONF:
+        {
+            if (_config.firmware < ((1 << 8) | 24) || size < sizeof(_u32)) {
+                ++_statBadCommands;
+                break;
+            }
+
+            _u32 type;
+            memcpy(&type, payload, sizeof(type));
+            _u16 mode = MODE_COUNT;
+            if (size >= sizeof(type) + sizeof(mode)) {
+                memcpy(&mode, payload + sizeof(type), sizeof(mode));
+            }
+
+            // an unknown type or mode is answered with the type alone
+            std::vector<_u8> answer;
+            _append(answer, type);
+            switch (type) {
+            case RPLIDAR_CONF_SCAN_MODE_COUNT:
+                _append(answer, (_u16)MODE_COUNT);
+                break;
+            case RPLIDAR_CONF_SCAN_MODE_TYPICAL:
+                _append(answer, _config.typicalMode);
+                break;
+            case RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE:
+                if (mode < MODE_COUNT) {
+                    _u32 rate = (mode == MODE_STANDARD) ? (_u32)STANDARD_SAMPLE_RATE : _config.sampleRate;
+                    _append(answer, (_u32)((1000000ull << 8) / rate));
+                }
+                break;
+            case RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE:
+                if (mode < MODE_COUNT) _append(answer, (_u32)(_config.maxDistance_m * 256));
+                break;
+            case RPLIDAR_CONF_SCAN_MODE_ANS_TYPE:
+                if (mode < MODE_COUNT) _append(answer, ModeAnsType(mode));
+                break;
+            case RPLIDAR_CONF_SCAN_MODE_NAME:
+                if (mode < MODE_COUNT) {
+                    const char * name = ModeName(mode);
+                    answer.insert(answer.end(), name, name + strlen(name) + 1);
+                }
+                break;
+            }
+            _answer(RPLIDAR_ANS_TYPE_GET_LIDAR_CONF, &answer[0], answer.size());
+        }
+        break;
+
+    case RPLIDAR_CMD_SET_MOTOR_PWM:
+        if (size < sizeof(rplidar_payload_motor_pwm_t) || !_config.motorCtrl) {
+            ++_statBadCommands;
+            break;
+        }
+        _pwm = std::min<_u16>(reinterpret_cast<const rplidar_payload_motor_pwm_t *>(payload)->pwm_value, MAX_MOTOR_PWM);
+        break;
+
+    case RPLIDAR_CMD_GET_ACC_BOARD_FLAG:
+        {
+            rplidar_response_acc_board_flag_t flag;
+            flag.support_flag = _config.motorCtrl ? RPLIDAR_RESP_ACC_BOARD_FLAG_MOTOR_CTRL_SUPPORT_MASK : 0;
+            _answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, &flag, sizeof(flag));
+        }
+        break;
+
+    case RPLIDAR_CMD_HQ_MOTOR_SPEED_CTRL:
+        if (size < sizeof(rplidar_payload_hq_spd_ctrl_t)) {
+            ++_statBadCommands;
+            break;
+        }
+        _tofRpm = reinterpret_cast<const rplidar_payload_hq_spd_ctrl_t *>(payload)->rpm;
+        break;
+
+    default:
+        ++_statBadCommands;
+        break;
+    }
+}
+
+void LidarEmulator::_answer(_u8 type, const void * data, size_t size, bool loop)
+{
+    rplidar_ans_header_t header;
+    header.syncByte1 = RPLIDAR_ANS_SYNC_BYTE1;
+    header.syncByte2 = RPLIDAR_ANS_SYNC_BYTE2;
+    header.size_q30_subtype = (_u32)size | (loop ? (RPLIDAR_ANS_PKTFLAG_LOOP << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT) : 0);
+    header.type = type;
+
+    std::vector<_u8> packet;
+    _append(packet, header);
+    if (!loop) {
+        const _u8 * bytes = reinterpret_cast<const _u8 *>(data);
+        packet.insert(packet.end(), bytes, bytes + size);
+    }
+    _write(&packet[0], packet.size());
+}
+
+bool LidarEmulator::_write(const _u8 * data, size_t size)
+{
+    // the master is non-blocking so commands keep being served while the
+    // driver does not read, give a stalled reader a little time only
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ans = ::write(_masterFd, data + written, size - written);
+        if (ans > 0) {
+            written += ans;
+            continue;
+        }
+        if (ans < 0 && errno != EAGAIN) return false;
+
+        struct pollfd pfd;
+        pfd.fd = _masterFd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 50) <= 0 || _quit) return false;
+    }
+    return true;
+}
+
+//------
+// scanning
+
+_u32 LidarEmulator::_currentRpm() const
+{
+    if ((_config.model >> 4) > TOF_MINUM_MAJOR_ID) return _tofRpm;
+    if (_config.motorCtrl) return (_u32)((_u64)_config.rpm * _pwm / DEFAULT_MOTOR_PWM);
+
+    // an A1 runs its motor off DTR, which a pseudo terminal does not carry
+    return _config.rpm;
+}
+
+void LidarEmulator::_refreshLineRate()
+{
+    if (_config.baudrate) {
+        _baudrate = _config.baudrate;
+        return;
+    }
+
+    // on a master the termios calls act on the slave, i.e. on what the driver set
+    struct termios2 tio;
+    if (ioctl(_masterFd, TCGETS2, &tio) == 0 && tio.c_ospeed) {
+        _baudrate = tio.c_ospeed;
+    }
+}
+
+void LidarEmulator::_startScan(_u16 mode)
+{
+    _stopScan();
+    _refreshLineRate();
+
+    _answer(ModeAnsType(mode), NULL, _modeFrameBytes(mode), true);
+
+    _u64 now_us = rp::arch::rp_getus();
+    _scanMode = mode;
+    _scanning = true;
+    _firstFrame = true;
+    _nextSampleTs_us = (double)now_us;
+    _lineFree_us = now_us;
+}
+
+void LidarEmulator::_stopScan()
+{
+    _scanning = false;
+    _samples.clear();
+}
+
+_u32 LidarEmulator::_castRay(float angle) const
+{
+    // angle 0 looks along +y, angles grow clockwise seen from above
+    double rad = angle * PI / 180;
+    double dx = sin(rad), dy = cos(rad);
+
+    double best = -1;
+    for (size_t pos = 0; pos < _config.room.size(); ++pos) {
+        const segment_t & wall = _config.room[pos];
+        double ex = wall.x2 - wall.x1, ey = wall.y2 - wall.y1;
+        double denom = dx * ey - dy * ex;
+        if (fabs(denom) < 1e-9) continue;
+
+        double ax = wall.x1 - _config.x, ay = wall.y1 - _config.y;
+        double t = (ax * ey - ay * ex) / denom;
+        double u = (ax * dy - ay * dx) / denom;
+        if (t <= 0 || u < 0 || u > 1) continue;
+        if (best < 0 || t < best) best = t;
+    }
+
+    if (best < 0 || best > _config.maxDistance_m * 1000) return 0;
+    return (_u32)(best + 0.5);
+}
+
+void LidarEmulator::_generateSamples(_u64 now_us)
+{
+    _u32 rpm = _currentRpm();
+    if (!rpm) {
+        // nothing is measured while the motor is at rest
+        _nextSampleTs_us = (double)now_us;
+        return;
+    }
+
+    _u32 rate = (_scanMode == MODE_STANDARD) ? (_u32)STANDARD_SAMPLE_RATE : _config.sampleRate;
+    double period_us = 1000000.0 / rate;
+    double step = 360.0 * rpm * _rpmScale / 60 / rate;
+
+    while (_nextSampleTs_us <= now_us) {
+        sample_t sample;
+        sample.angle = (float)_angle;
+        sample.ts_us = (_u64)_nextSampleTs_us;
+        // the driver detects the revolution once the first sample after the wrap arrives
+        sample.sync = _revolutionStart;
+        if (sample.sync) _lastRevolutionTs = sample.ts_us;
+
+        if (_scanMode == MODE_BOOST) {
+            // the driver moves ultra capsule samples by a distance dependent
+            // offset, so measure where the decoded sample will end up
+            _u32 dist = _castRay((float)(_angle - 7.5));
+            for (int round = 0; round < 2; ++round) {
+                dist = _castRay((float)(_angle - _ultraAngleOffset(dist)));
+            }
+            sample.dist_mm = dist;
+        } else {
+            sample.dist_mm = _castRay(sample.angle);
+        }
+
+        _revolutionStart = false;
+        _angle += step;
+        if (_angle >= 360) {
+            // a real motor never holds its speed exactly, which also keeps the
+            // revolutions from lining up with the capsule boundaries
+            _angle -= 360;
+            _revolutionStart = true;
+            _rpmScale = 1 + _config.rpmJitter * (2.0 * _random() / _random.max() - 1);
+            step = 360.0 * rpm * _rpmScale / 60 / rate;
+        }
+        _samples.push_back(sample);
+        _nextSampleTs_us += period_us;
+        ++_statSamples;
+    }
+}
+
+void LidarEmulator::_emitFrames(_u64 now_us)
+{
+    size_t frameSamples = ModeFrameSamples(_scanMode);
+    size_t frameBytes = _modeFrameBytes(_scanMode);
+    // an ultra capsule refers to the first sample of the next one
+    size_t required = frameSamples + (_scanMode == MODE_BOOST ? 1 : 0);
+    _u64 txTime_us = (_u64)frameBytes * 10 * 1000000 / _baudrate;
+
+    std::vector<_u8> frame;
+    while (_samples.size() >= required) {
+        _u64 due_us = _samples[required - 1].ts_us;
+        _u64 txStart_us = std::max(due_us, _lineFree_us);
+
+        frame.clear();
+        if (txStart_us - due_us > MAX_LINE_BACKLOG_US) {
+            // the line fell too far behind, the frame is lost
+            _samples.erase(_samples.begin(), _samples.begin() + frameSamples);
+            ++_statOverruns;
+            continue;
+        }
+
+        // the frame becomes readable once its last byte went over the line
+        if (txStart_us + txTime_us > now_us) break;
+        _lineFree_us = txStart_us + txTime_us;
+
+        switch (_scanMode) {
+        case MODE_STANDARD:    _encodeStandard(frame); break;
+        case MODE_EXPRESS:     _encodeCapsule(frame); break;
+        case MODE_BOOST:       _encodeUltraCapsule(frame); break;
+        case MODE_SENSITIVITY: _encodeDenseCapsule(frame); break;
+        case MODE_HQ:          _encodeHqCapsule(frame); break;
+        }
+        _firstFrame = false;
+
+        if (!_write(&frame[0], frame.size())) {
+            ++_statOverruns;
+            continue;
+        }
+        ++_statFrames;
+        _statBytes += frame.size();
+    }
+}
+
+_u64 LidarEmulator::_nextWakeup(_u64 now_us) const
+{
+    if (!_scanning || !_currentRpm()) return now_us + IDLE_POLL_US;
+
+    _u32 rate = (_scanMode == MODE_STANDARD) ? (_u32)STANDARD_SAMPLE_RATE : _config.sampleRate;
+    size_t required = ModeFrameSamples(_scanMode) + (_scanMode == MODE_BOOST ? 1 : 0);
+
+    double due_us;
+    if (_samples.size() >= required) {
+        due_us = (double)_samples[required - 1].ts_us;
+    } else {
+        due_us = _nextSampleTs_us + (required - 1 - _samples.size()) * 1000000.0 / rate;
+    }
+
+    _u64 txTime_us = (_u64)_modeFrameBytes(_scanMode) * 10 * 1000000 / _baudrate;
+    return std::max((_u64)due_us, _lineFree_us) + txTime_us;
+}
+
+//------
+// frame encoders, each one takes its samples off the queue
+
+void LidarEmulator::_encodeStandard(std::vector<_u8> & frame)
+{
+    const sample_t & sample = _samples.front();
+
+    rplidar_response_measurement_node_t node;
+    _u8 quality = sample.dist_mm ? NODE_QUALITY : 0;
+    _u32 dist_q2 = sample.dist_mm * 4;
+
+    node.sync_quality = (sample.sync ? RPLIDAR_RESP_MEASUREMENT_SYNCBIT : (RPLIDAR_RESP_MEASUREMENT_SYNCBIT << 1))
+        | (quality << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT);
+    node.angle_q6_checkbit = (_u16)(((_u32)(sample.angle * 64) << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | RPLIDAR_RESP_MEASUREMENT_CHECKBIT);
+    node.distance_q2 = dist_q2 > 0xFFFF ? 0 : (_u16)dist_q2;
+
+    _append(frame, node);
+    _samples.pop_front();
+}
+
+void LidarEmulator::_encodeCapsule(std::vector<_u8> & frame)
+{
+    rplidar_response_capsule_measurement_nodes_t capsule;
+    capsule.start_angle_sync_q6 = _startAngle_q6(_samples[0].angle, _firstFrame);
+
+    // the samples are evenly spaced, so no angle offsets are needed
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos) {
+        _u32 dist1_q2 = _samples[2 * pos].dist_mm * 4;
+        _u32 dist2_q2 = _samples[2 * pos + 1].dist_mm * 4;
+        capsule.cabins[pos].distance_angle_1 = dist1_q2 > 0xFFFF ? 0 : (_u16)(dist1_q2 & 0xFFFC);
+        capsule.cabins[pos].distance_angle_2 = dist2_q2 > 0xFFFF ? 0 : (_u16)(dist2_q2 & 0xFFFC);
+        capsule.cabins[pos].offset_angles_q3 = 0;
+    }
+    _sealCapsule(reinterpret_cast<_u8 *>(&capsule), sizeof(capsule));
+
+    _append(frame, capsule);
+    _samples.erase(_samples.begin(), _samples.begin() + 2 * _countof(capsule.cabins));
+}
+
+void LidarEmulator::_encodeDenseCapsule(std::vector<_u8> & frame)
+{
+    rplidar_response_dense_capsule_measurement_nodes_t capsule;
+    capsule.start_angle_sync_q6 = _startAngle_q6(_samples[0].angle, _firstFrame);
+
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos) {
+        _u32 dist = _samples[pos].dist_mm;
+        capsule.cabins[pos].distance = dist > 0xFFFF ? 0 : (_u16)dist;
+    }
+    _sealCapsule(reinterpret_cast<_u8 *>(&capsule), sizeof(capsule));
+
+    _append(frame, capsule);
+    _samples.erase(_samples.begin(), _samples.begin() + _countof(capsule.cabins));
+}
+
+void LidarEmulator::_encodeUltraCapsule(std::vector<_u8> & frame)
+{
+    rplidar_response_ultra_capsule_measurement_nodes_t capsule;
+    capsule.start_angle_sync_q6 = _startAngle_q6(_samples[0].angle, _firstFrame);
+
+    // a cabin carries its first sample, the second one relative to it and the
+    // third one relative to the first sample of the following cabin
+    for (size_t pos = 0; pos < _countof(capsule.ultra_cabins); ++pos) {
+        _u32 level, nextLevel;
+        _u32 major = _varbitscaleEncode(_samples[3 * pos].dist_mm, level);
+        _u32 nextMajor = _varbitscaleEncode(_samples[3 * pos + 3].dist_mm, nextLevel);
+
+        _u32 base1 = _varbitscaleDecode(major, level);
+        _u32 base2 = _varbitscaleDecode(nextMajor, nextLevel);
+        _u32 level1 = level;
+        if (!major && nextMajor) {
+            base1 = base2;
+            level1 = nextLevel;
+        }
+
+        _u32 predict1 = _ultraPredict(_samples[3 * pos + 1].dist_mm, base1, level1);
+        _u32 predict2 = _ultraPredict(_samples[3 * pos + 2].dist_mm, base2, nextLevel);
+        capsule.ultra_cabins[pos].combined_x3 = (major & 0xFFF)
+            | (predict1 << RPLIDAR_RESP_MEASUREMENT_EXP_ULTRA_MAJOR_BITS)
+            | (predict2 << (RPLIDAR_RESP_MEASUREMENT_EXP_ULTRA_MAJOR_BITS + RPLIDAR_RESP_MEASUREMENT_EXP_ULTRA_PREDICT_BITS));
+    }
+    _sealCapsule(reinterpret_cast<_u8 *>(&capsule), sizeof(capsule));
+
+    _append(frame, capsule);
+    _samples.erase(_samples.begin(), _samples.begin() + 3 * _countof(capsule.ultra_cabins));
+}
+
+void LidarEmulator::_encodeHqCapsule(std::vector<_u8> & frame)
+{
+    rplidar_response_hq_capsule_measurement_nodes_t capsule;
+    capsule.sync_byte = RPLIDAR_RESP_MEASUREMENT_HQ_SYNC;
+    capsule.time_stamp = _samples[0].ts_us - _epoch_us;
+
+    for (size_t pos = 0; pos < _countof(capsule.node_hq); ++pos) {
+        const sample_t & sample = _samples[pos];
+        rplidar_response_measurement_node_hq_t & node = capsule.node_hq[pos];
+        node.angle_z_q14 = (_u16)(sample.angle * 16384 / 90);
+        node.dist_mm_q2 = sample.dist_mm * 4;
+        node.quality = sample.dist_mm ? (NODE_QUALITY << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+        node.flag = sample.sync ? RPLIDAR_RESP_HQ_FLAG_SYNCBIT : 0;
+    }
+    capsule.crc32 = rp::hal::crc32_padded(&capsule, sizeof(capsule) - sizeof(capsule.crc32));
+
+    _append(frame, capsule);
+    _samples.erase(_samples.begin(), _samples.begin() + _countof(capsule.node_hq));
+}
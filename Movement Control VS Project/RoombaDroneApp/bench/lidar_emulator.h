@@ -0,0 +1,191 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Software RPLIDAR speaking the serial protocol of include/rplidar_cmd.h on a
+// pseudo terminal, so the unmodified serial driver can be exercised without
+// hardware.
+//
+// It answers the device info, health, sample rate, accessory board and
+// GET_LIDAR_CONF queries, takes motor PWM and spin speed commands, and
+// streams SCAN, EXPRESS_SCAN (classic, ultra and dense capsules) and HQ
+// capsules with their checksums or CRC. The samples are ray cast into a 2D
+// room made of wall segments, at the configured sample rate and spin rate.
+//
+// Data goes out at the line rate the driver set on the port, so a baudrate
+// too low for the sample rate shows up as overruns, as it would on a real
+// UART.
+
+#pragma once
+
+#include "src/sdkcommon.h"
+
+#include <atomic>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LidarEmulator
+{
+public:
+    // scan mode ids, in the order of the GET_LIDAR_CONF scan mode table
+    enum {
+        MODE_STANDARD = 0,      // 5 byte nodes
+        MODE_EXPRESS,           // classic capsules, 32 samples
+        MODE_BOOST,             // ultra capsules, 96 samples
+        MODE_SENSITIVITY,       // dense capsules, 40 samples
+        MODE_HQ,                // HQ capsules with CRC, 16 samples
+
+        MODE_COUNT,
+    };
+
+    enum {
+        STANDARD_SAMPLE_RATE = 2000,
+        MAX_LINE_BACKLOG_US  = 100000,  // older frames are dropped as overruns
+    };
+
+    struct segment_t {
+        float x1, y1, x2, y2;   // mm
+    };
+
+    struct config_t {
+        _u8     model;              // (model >> 4) > 5 makes the driver treat it as a TOF lidar
+        _u16    firmware;           // major << 8 | minor, 1.24 and later has GET_LIDAR_CONF
+        _u8     hardware;
+        bool    motorCtrl;          // PWM motor control through the accessory board
+        _u32    sampleRate;         // samples/s of the capsule modes
+        _u32    rpm;                // spin rate at DEFAULT_MOTOR_PWM, and of a TOF lidar before any command
+        float   rpmJitter;          // relative spin rate variation from one revolution to the next
+        _u16    typicalMode;
+        float   maxDistance_m;
+        _u32    baudrate;           // line rate, 0 to use the one the driver set on the port
+        float   x, y;               // lidar position in the room, mm
+        std::vector<segment_t> room;
+        std::string linkPath;       // symlink created to the pseudo terminal, optional
+
+        config_t();
+
+        // rectangle of width x depth mm with a corner at the origin, the lidar in its middle
+        void setRoom(float width, float depth);
+        void addBox(float x, float y, float width, float depth);
+    };
+
+    struct stats_t {
+        _u64    samples;
+        _u64    frames;
+        _u64    bytes;
+        _u64    overruns;           // frames dropped because the line could not keep up
+        _u64    commands;
+        _u64    badCommands;        // checksum errors and unknown commands
+    };
+
+    LidarEmulator();
+    ~LidarEmulator();
+
+    bool start(const config_t & config);
+    void stop();
+
+    // the pseudo terminal slave the driver connects to
+    const char * devicePath() const { return _slavePath.c_str(); }
+
+    stats_t stats() const;
+
+    // host time (rp_getus) the first sample of the latest revolution was due,
+    // which is when the driver can complete the previous revolution at the earliest
+    _u64 lastRevolutionTs() const { return _lastRevolutionTs; }
+
+    static const char * ModeName(_u16 mode);
+    static _u8 ModeAnsType(_u16 mode);
+    static size_t ModeFrameSamples(_u16 mode);
+
+protected:
+    struct sample_t {
+        float   angle;          // degree, of the encoder, before any distance dependent correction
+        _u32    dist_mm;
+        bool    sync;           // first sample of a revolution
+        _u64    ts_us;          // host time the sample is due
+    };
+
+    void _threadProc();
+    void _handleInput();
+    void _handleCommand(_u8 cmd, const _u8 * payload, size_t size);
+    void _answer(_u8 type, const void * data, size_t size, bool loop = false);
+    bool _write(const _u8 * data, size_t size);
+
+    void _startScan(_u16 mode);
+    void _stopScan();
+    _u32 _currentRpm() const;
+    void _refreshLineRate();
+    _u32 _castRay(float angle) const;
+    void _generateSamples(_u64 now_us);
+    void _emitFrames(_u64 now_us);
+    _u64 _nextWakeup(_u64 now_us) const;
+
+    void _encodeStandard(std::vector<_u8> & frame);
+    void _encodeCapsule(std::vector<_u8> & frame);
+    void _encodeDenseCapsule(std::vector<_u8> & frame);
+    void _encodeUltraCapsule(std::vector<_u8> & frame);
+    void _encodeHqCapsule(std::vector<_u8> & frame);
+
+    config_t            _config;
+    int                 _masterFd;
+    int                 _slaveFd;
+    std::string         _slavePath;
+    std::thread         _thread;
+    std::atomic<bool>   _quit;
+
+    std::vector<_u8>    _rxBuffer;
+
+    // motor
+    _u16                _pwm;
+    _u32                _tofRpm;
+
+    // scan
+    bool                _scanning;
+    _u16                _scanMode;
+    bool                _firstFrame;
+    double              _angle;             // of the next sample, degree
+    double              _rpmScale;          // jitter of the current revolution
+    bool                _revolutionStart;   // the next sample is the first one after the wrap
+    std::minstd_rand    _random;
+    double              _nextSampleTs_us;
+    std::deque<sample_t> _samples;
+    _u32                _baudrate;
+    _u64                _lineFree_us;       // when the line finishes the data written so far
+    _u64                _epoch_us;          // device clock origin for the HQ time stamps
+
+    std::atomic<_u64>   _lastRevolutionTs;
+    std::atomic<_u64>   _statSamples, _statFrames, _statBytes, _statOverruns, _statCommands, _statBadCommands;
+};
@@ -0,0 +1,89 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Runs LidarEmulator until interrupted, for driving the SDK tools or an
+// application against a software lidar.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -o lidar_emulator
+//       bench/lidar_emulator_main.cpp bench/lidar_emulator.cpp src/hal/crc32.cpp
+//       src/arch/linux/timer.cpp
+//
+// Run: lidar_emulator [link path] [samples/s] [rpm] [room width mm] [room depth mm]
+
+#include "src/sdkcommon.h"
+#include "bench/lidar_emulator.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+static volatile sig_atomic_t _stopRequested = 0;
+
+static void _onSignal(int)
+{
+    _stopRequested = 1;
+}
+
+int main(int argc, const char * argv[])
+{
+    LidarEmulator::config_t config;
+    if (argc > 1) config.linkPath = argv[1];
+    if (argc > 2) config.sampleRate = (_u32)atoi(argv[2]);
+    if (argc > 3) config.rpm = (_u32)atoi(argv[3]);
+    if (argc > 5) config.setRoom((float)atof(argv[4]), (float)atof(argv[5]));
+
+    signal(SIGINT, _onSignal);
+    signal(SIGTERM, _onSignal);
+
+    LidarEmulator emulator;
+    if (!emulator.start(config)) {
+        fprintf(stderr, "cannot create the pseudo terminal\n");
+        return 1;
+    }
+    printf("lidar at %s%s%s, %u samples/s, %u rpm\n", emulator.devicePath(),
+        config.linkPath.empty() ? "" : " linked from ", config.linkPath.c_str(), config.sampleRate, config.rpm);
+    fflush(stdout);
+
+    while (!_stopRequested) {
+        delay(100);
+    }
+
+    LidarEmulator::stats_t stats = emulator.stats();
+    emulator.stop();
+    printf("%llu samples in %llu frames, %llu bytes, %llu overruns, %llu commands, %llu bad\n",
+        (unsigned long long)stats.samples, (unsigned long long)stats.frames, (unsigned long long)stats.bytes,
+        (unsigned long long)stats.overruns, (unsigned long long)stats.commands, (unsigned long long)stats.badCommands);
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+// Wake-up latency of the serial wait: the time from the last byte of a frame
+// reaching the port to waitfordata() returning, for the previous select() /
+// FIONREAD / usleep loop and for the epoll backend in net_serial.cpp.
+//
+// A pseudo terminal stands in for the UART. A writer thread feeds each frame
+// in small chunks paced at the line rate, the way a USB serial adapter hands
+// over a capsule, and records when the last chunk went out.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -o serial_wakeup_bench
+//       bench/serial_wakeup_bench.cpp src/arch/linux/net_serial.cpp src/arch/linux/timer.cpp
+//
+// Usage: serial_wakeup_bench [frames] [frame_bytes] [chunk_bytes] [baudrate]
+
+#include "src/sdkcommon.h"
+#include "src/hal/abs_rxtx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <sys/select.h>
+#include <termios.h>
+
+struct bench_config_t {
+    int     frames;
+    size_t  frameBytes;
+    size_t  chunkBytes;
+    _u32    baudrate;
+};
+
+typedef bool (*wait_fn_t)(void * ctx, size_t count);
+
+// The wait loop raw_serial used before the epoll backend, kept verbatim
+// apart from the self pipe, which the benchmark never signals.
+static int _legacyWaitForData(int fd, _u32 baudrate, size_t data_count, _u32 timeout, size_t * returned_size)
+{
+    fd_set input_set;
+    struct timeval timeout_val;
+
+    FD_ZERO(&input_set);
+    FD_SET(fd, &input_set);
+
+    timeout_val.tv_sec = timeout / 1000;
+    timeout_val.tv_usec = (timeout % 1000) * 1000;
+
+    if (ioctl(fd, FIONREAD, returned_size) == -1) return -2;
+    if (*returned_size >= data_count) return 0;
+
+    for (;;) {
+        int n = ::select(fd + 1, &input_set, NULL, NULL, &timeout_val);
+        if (n < 0) return -2;
+        if (n == 0) return -1;
+
+        if (ioctl(fd, FIONREAD, returned_size) == -1) return -2;
+        if (*returned_size >= data_count) return 0;
+
+        int remain_timeout = timeout_val.tv_sec*1000000 + timeout_val.tv_usec;
+        int expect_remain_time = (data_count - *returned_size)*1000000*8/baudrate;
+        if (remain_timeout > expect_remain_time)
+            usleep(expect_remain_time);
+    }
+}
+
+struct legacy_ctx_t {
+    int     fd;
+    _u32    baudrate;
+};
+
+static bool _legacyWait(void * ctx, size_t count)
+{
+    legacy_ctx_t * legacy = (legacy_ctx_t *)ctx;
+    size_t queued;
+    if (_legacyWaitForData(legacy->fd, legacy->baudrate, count, 1000, &queued)) return false;
+
+    std::vector<_u8> drain(queued);
+    return ::read(legacy->fd, &drain[0], queued) == (ssize_t)queued;
+}
+
+static bool _epollWait(void * ctx, size_t count)
+{
+    rp::hal::serial_rxtx * rxtx = (rp::hal::serial_rxtx *)ctx;
+    size_t queued;
+    if (rxtx->waitfordata(count, 1000, &queued) != rp::hal::serial_rxtx::ANS_OK) return false;
+
+    std::vector<_u8> drain(queued);
+    return rxtx->recvdata(&drain[0], queued) == (int)queued;
+}
+
+// returns the wake-up latencies in microseconds, empty on failure
+static std::vector<double> _measure(const bench_config_t & config, int masterFd, wait_fn_t waitFn, void * ctx)
+{
+    std::vector<double> latencies;
+    std::atomic<int> armed(-1);
+    std::atomic<_u64> lastChunkTs(0);
+    std::atomic<bool> writerOk(true);
+
+    const double byteUs = 10 * 1000000.0 / config.baudrate;
+    std::vector<_u8> frame(config.frameBytes, 0x5a);
+
+    std::thread writer([&]() {
+        for (int frameId = 0; frameId < config.frames; ++frameId) {
+            while (armed.load() < frameId) std::this_thread::yield();
+            if (armed.load() != frameId) break;
+
+            // let the reader settle in its wait before the first byte arrives
+            usleep(2000);
+            for (size_t pos = 0; pos < frame.size(); pos += config.chunkBytes) {
+                size_t chunk = std::min(config.chunkBytes, frame.size() - pos);
+                usleep((useconds_t)(chunk * byteUs));
+                lastChunkTs.store(rp::arch::rp_getus());
+                if (::write(masterFd, &frame[pos], chunk) != (ssize_t)chunk) writerOk = false;
+            }
+        }
+    });
+
+    for (int frameId = 0; frameId < config.frames; ++frameId) {
+        armed.store(frameId);
+        if (!waitFn(ctx, config.frameBytes)) break;
+        latencies.push_back((double)(rp::arch::rp_getus() - lastChunkTs.load()));
+    }
+    armed.store(config.frames);
+    writer.join();
+
+    if (!writerOk || latencies.size() != (size_t)config.frames) latencies.clear();
+    return latencies;
+}
+
+static void _report(const char * backend, std::vector<double> latencies)
+{
+    if (latencies.empty()) {
+        printf("%-7s %9s\n", backend, "failed");
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double sum = 0;
+    for (size_t pos = 0; pos < latencies.size(); ++pos) sum += latencies[pos];
+
+    size_t last = latencies.size() - 1;
+    printf("%-7s %9.1f %9.1f %9.1f %9.1f %9.1f\n", backend, sum / latencies.size(),
+        latencies[last / 2], latencies[last * 9 / 10], latencies[last * 99 / 100], latencies[last]);
+}
+
+int main(int argc, const char * argv[])
+{
+    bench_config_t config;
+    config.frames     = (argc > 1) ? atoi(argv[1]) : 500;
+    config.frameBytes = (argc > 2) ? atoi(argv[2]) : sizeof(rplidar_response_capsule_measurement_nodes_t);
+    config.chunkBytes = (argc > 3) ? atoi(argv[3]) : 16;
+    config.baudrate   = (argc > 4) ? atoi(argv[4]) : 115200;
+
+    int masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd == -1 || grantpt(masterFd) || unlockpt(masterFd)) {
+        fprintf(stderr, "cannot create a pseudo terminal\n");
+        return 1;
+    }
+    const char * slavePath = ptsname(masterFd);
+
+    printf("%d frames of %d bytes in %d byte chunks at %u baud\n",
+        config.frames, (int)config.frameBytes, (int)config.chunkBytes, config.baudrate);
+    printf("%-7s %9s %9s %9s %9s %9s\n", "backend", "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+
+    {
+        legacy_ctx_t legacy;
+        legacy.baudrate = config.baudrate;
+        legacy.fd = ::open(slavePath, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+        struct termios options;
+        tcgetattr(legacy.fd, &options);
+        cfmakeraw(&options);
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(legacy.fd, TCSANOW, &options);
+
+        _report("select", _measure(config, masterFd, &_legacyWait, &legacy));
+        ::close(legacy.fd);
+    }
+
+    {
+        rp::hal::serial_rxtx * rxtx = rp::hal::serial_rxtx::CreateRxTx();
+        if (!rxtx->bind(slavePath, config.baudrate) || !rxtx->open()) {
+            fprintf(stderr, "cannot open %s\n", slavePath);
+            return 1;
+        }
+        _report("epoll", _measure(config, masterFd, &_epollWait, rxtx));
+        rxtx->close();
+        rp::hal::serial_rxtx::ReleaseRxTx(rxtx);
+    }
+
+    ::close(masterFd);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+// Wake-up jitter of a periodic thread under the scheduling the driver threads
+// can be given through RplidarThreadAttributes: how late a thread sleeping to
+// an absolute CLOCK_MONOTONIC deadline actually runs, with and without CPU
+// pinning and a real-time policy, while busy "logging" threads compete for
+// the same CPU the way the control loop's file output does on the robot.
+//
+// The real-time rows need CAP_SYS_NICE or root, they report "refused"
+// otherwise.
+//
+// Build on the target from the RoombaDroneApp directory:
+//   g++ -std=gnu++14 -O2 -pthread -I. -Iinclude -o thread_jitter_bench
+//       bench/thread_jitter_bench.cpp src/hal/thread.cpp src/arch/linux/timer.cpp
+//
+// Usage: thread_jitter_bench [samples] [period_us] [cpu] [load_threads]
+
+#include "src/sdkcommon.h"
+#include "src/hal/thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+struct bench_config_t {
+    int     samples;
+    _u32    periodUs;
+    int     cpu;
+    int     loadThreads;
+};
+
+struct periodic_task_t {
+    _u32                    periodUs;
+    int                     samples;
+    std::vector<double>     lateness;
+
+    u_result threadProc()
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        lateness.reserve(samples);
+        for (int pos = 0; pos < samples; ++pos) {
+            deadline.tv_nsec += periodUs * 1000;
+            while (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_nsec -= 1000000000;
+                ++deadline.tv_sec;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            lateness.push_back((now.tv_sec - deadline.tv_sec) * 1000000.0 + (now.tv_nsec - deadline.tv_nsec) / 1000.0);
+        }
+        return RESULT_OK;
+    }
+};
+
+// formats lines into a buffer and flushes it to /dev/null, never sleeping
+static void _loggingLoad(int cpu, std::atomic<bool> * quit)
+{
+    rp::hal::Thread::current().setAffinity((_u64)1 << cpu);
+
+    FILE * sink = fopen("/dev/null", "w");
+    char line[128];
+    for (_u32 seq = 0; !quit->load(); ++seq) {
+        int len = snprintf(line, sizeof(line), "%u dist %u angle %.2f\n", seq, seq * 7 % 12000, (seq % 36000) / 100.0);
+        if (sink) fwrite(line, 1, len, sink);
+    }
+    if (sink) fclose(sink);
+}
+
+// returns false when the OS refuses the scheduling
+static bool _measure(const bench_config_t & config, rp::hal::Thread::sched_policy_t policy, int priorityLevel,
+    _u64 cpuMask, std::vector<double> & lateness)
+{
+    std::atomic<bool> quit(false);
+    std::vector<std::thread> load;
+    for (int pos = 0; pos < config.loadThreads; ++pos) load.push_back(std::thread(_loggingLoad, config.cpu, &quit));
+
+    periodic_task_t task;
+    task.periodUs = config.periodUs;
+    task.samples = config.samples;
+
+    // the first wake-up is a period away, the attributes land before it
+    rp::hal::Thread thread = rp::hal::Thread::create_member<periodic_task_t, &periodic_task_t::threadProc>(&task);
+    bool accepted = IS_OK(thread.setScheduling(policy, priorityLevel)) && IS_OK(thread.setAffinity(cpuMask));
+    thread.setName("jitter-bench");
+    thread.join();
+
+    quit = true;
+    for (size_t pos = 0; pos < load.size(); ++pos) load[pos].join();
+
+    lateness.swap(task.lateness);
+    return accepted;
+}
+
+static void _report(const char * setup, bool accepted, std::vector<double> lateness)
+{
+    if (!accepted || lateness.empty()) {
+        printf("%-12s %9s\n", setup, "refused");
+        return;
+    }
+    std::sort(lateness.begin(), lateness.end());
+
+    double sum = 0;
+    for (size_t pos = 0; pos < lateness.size(); ++pos) sum += lateness[pos];
+
+    size_t last = lateness.size() - 1;
+    printf("%-12s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", setup, sum / lateness.size(),
+        lateness[last / 2], lateness[last * 9 / 10], lateness[last * 99 / 100], lateness[last * 999 / 1000], lateness[last]);
+}
+
+int main(int argc, const char * argv[])
+{
+    bench_config_t config;
+    config.samples     = (argc > 1) ? atoi(argv[1]) : 5000;
+    config.periodUs    = (argc > 2) ? atoi(argv[2]) : 1000;
+    config.cpu         = (argc > 3) ? atoi(argv[3]) : 0;
+    config.loadThreads = (argc > 4) ? atoi(argv[4]) : 2;
+
+    const _u64 cpuMask = (_u64)1 << config.cpu;
+
+    printf("%d wake-ups every %u us, %d logging threads on cpu %d\n",
+        config.samples, config.periodUs, config.loadThreads, config.cpu);
+    printf("%-12s %9s %9s %9s %9s %9s %9s\n", "setup", "mean_us", "p50_us", "p90_us", "p99_us", "p99.9_us", "max_us");
+
+    std::vector<double> lateness;
+    bool accepted;
+
+    accepted = _measure(config, rp::hal::Thread::SCHED_POLICY_DEFAULT, 0, 0, lateness);
+    _report("default", accepted, lateness);
+
+    accepted = _measure(config, rp::hal::Thread::SCHED_POLICY_DEFAULT, 0, cpuMask, lateness);
+    _report("pinned", accepted, lateness);
+
+    accepted = _measure(config, rp::hal::Thread::SCHED_POLICY_RR, 60, cpuMask, lateness);
+    _report("rr+pinned", accepted, lateness);
+
+    accepted = _measure(config, rp::hal::Thread::SCHED_POLICY_FIFO, 60, cpuMask, lateness);
+    _report("fifo+pinned", accepted, lateness);
+
+    return 0;
+}
@@ -40,5 +40,7 @@
 #include "rplidar_cmd.h"
 
 #include "rplidar_driver.h"
+#include "rplidar_connection_manager.h"
+#include "rplidar_reactor.h"
 
 #define RPLIDAR_SDK_VERSION  "1.12.0"
@@ -0,0 +1,135 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+/// Receives the link changes seen by an RPlidarConnectionManager
+///
+/// The callbacks run on the manager's watch thread, nothing is reconnected while they run.
+class ConnectionListener
+{
+public:
+    virtual ~ConnectionListener() {}
+
+    /// The device vanished from its port or stopped sending scan data
+    virtual void onConnectionLost() {}
+
+    /// The device is back and the motor and scan state from before the loss have been restored
+    ///
+    /// \param outage_ms     Time from the last data received before the loss until the scan was restarted.
+    virtual void onConnectionRestored(_u32 /*outage_ms*/) {}
+};
+
+/// Keeps a serial port driver connected across USB disconnects and device brown-outs
+///
+/// The manager watches the directory of the device node, so a replugged adapter is reconnected
+/// as soon as its node reappears rather than on the next poll. While scanning, a device that
+/// stops sending data for longer than the stall timeout counts as lost too, which covers
+/// power dips that restart the lidar but leave the USB adapter in place.
+///
+/// Motor and scan commands go through the manager so it can restore them after a reconnect.
+/// Scan data is still grabbed from the driver, grabScanDataHq simply times out during an outage.
+/// The manager has to be disposed before its driver.
+class RPlidarConnectionManager
+{
+public:
+    enum {
+        DEFAULT_STALL_TIMEOUT = 500,    // 500 ms, several revolutions even at the lowest spin rate
+    };
+
+public:
+    /// Create a connection manager for the given driver
+    ///
+    /// The interface will return NULL for a NULL driver.
+    static RPlidarConnectionManager * CreateManager(RPlidarDriver * driver);
+
+    /// Dispose the connection manager, after stopping it
+    static void DisposeManager(RPlidarConnectionManager * mgr);
+
+    /// Start keeping the driver connected to the device at port_path
+    /// Returns right away, the connection is made by the manager's watch thread as soon as the device is there.
+    ///
+    /// \param port_path     The device path of the serial port, e.g. /dev/ttyUSB0 or a /dev/serial/by-id link
+    ///
+    /// \param baudrate      The baudrate used
+    virtual u_result start(const char * port_path, _u32 baudrate) = 0;
+
+    /// Stop watching the device. The driver keeps its current connection and scan state.
+    virtual void stop() = 0;
+
+    /// Wait until the driver is connected to a device answering on the port
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT when the link is still down after timeout milliseconds.
+    virtual u_result waitForLink(_u32 timeout) = 0;
+
+    /// Returns TRUE while the driver is connected to a device answering on the port
+    virtual bool isLinkUp() = 0;
+
+    /// Set the listener notified of lost and restored links, NULL to remove it
+    /// Only change it while the manager is stopped.
+    virtual void setListener(ConnectionListener * listener) = 0;
+
+    /// Set how long the device may send no data during a scan before the link counts as lost
+    virtual void setStallTimeout(_u32 timeout) = 0;
+
+    /// Get the duration of the latest outage, see ConnectionListener::onConnectionRestored
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL if no link has been restored yet.
+    virtual u_result getLastOutage(_u32 & outage_ms) = 0;
+
+    /// Same as the RPlidarDriver calls of the same name, and restored after a reconnect.
+    /// While the link is down they only record the new state and return RESULT_RECONNECTING,
+    /// the state is applied once the device is back.
+    virtual u_result startMotor() = 0;
+    virtual u_result stopMotor() = 0;
+    virtual u_result setMotorPWM(_u16 pwm) = 0;
+    virtual u_result startScan(bool force, bool useTypicalScan, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL) = 0;
+    virtual u_result startScanExpress(bool force, _u16 scanMode, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL) = 0;
+
+    /// Same as RPlidarDriver::startScanAuto, a reconnect restarts the mode picked here
+    /// The selection only runs on the reconnect when the link was down at the call. It grabs scans itself then,
+    /// so scans grabbed by the application meanwhile make it settle for a denser mode than the host keeps up with.
+    virtual u_result startScanAuto(_u32 decodeBudgetPercent = RPlidarDriver::DEFAULT_DECODE_BUDGET_PERCENT, RplidarScanModeSelection * outSelection = NULL) = 0;
+
+    /// Same as RPlidarDriver::stop, no scan is restarted after a reconnect
+    virtual u_result stopScan() = 0;
+
+    virtual ~RPlidarConnectionManager() {}
+protected:
+    RPlidarConnectionManager() {}
+};
+
+}}}
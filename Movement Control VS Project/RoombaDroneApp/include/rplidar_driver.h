@@ -60,19 +60,85 @@ struct RplidarScanMode {
     char    scan_mode[64];    // name of scan mode, max 63 characters
 };
 
+/// Scan mode chosen by startScanAuto, and what the choice was based on
+struct RplidarScanModeSelection {
+    RplidarScanMode mode;                   // the mode scanning was started in
+    float   decode_us_per_sample;           // host CPU time to decode one sample of the mode
+    float   decode_load;                    // fraction of one CPU decoding the mode takes
+    float   frequency;                      // revolutions/s getFrequency gives for the scans checked
+    float   delivered_ratio;                // samples delivered per revolution over the samples the mode takes, 1 when nothing is dropped
+    bool    verified;                       // the scans checked after the start had no revolutions or samples missing
+};
+
+/// State of the scan frequency regulation, see setScanFrequency
+struct RplidarSpinStatus {
+    float   target_frequency;       // revolutions/s asked for, 0 when not regulating
+    float   measured_frequency;     // revolutions/s averaged over the last few revolutions, 0 before the first average
+    float   angular_resolution;     // degrees between two samples at the measured frequency, 0 when not scanning
+    _u16    motor_command;          // PWM, or rpm for a TOF lidar, the motor was last given, 0 while unknown
+    bool    is_locked;              // the measured frequency is within 1% of the target
+};
+
+/// Host timing of one complete scan
+///
+/// Times are host CLOCK_MONOTONIC microseconds as returned by rp::arch::rp_getus. In HQ mode they come from the
+/// device's own clock mapped onto the host clock, otherwise from the time the data was received, which puts them
+/// late by the transfer time of one frame.
+struct RplidarScanTimestamp {
+    _u64    first_sample_us;  // time the first node of the scan (nodes[0]) was sampled
+    float   us_per_sample;    // sample duration measured over this scan
+
+    /// interpolated time of the node at index in the scan
+    _u64 sampleTime_us(size_t index) const { return first_sample_us + (_u64)(index * us_per_sample); }
+};
+
+/// Scheduling policies of RplidarThreadAttributes
+enum {
+    THREAD_POLICY_DEFAULT = 0,  // time shared with the other processes, the priority is ignored
+    THREAD_POLICY_FIFO = 1,     // real-time, runs until it blocks or a higher priority thread preempts it
+    THREAD_POLICY_RR = 2,       // real-time, round robin among threads of the same priority
+};
+
+/// Scheduling and placement of a thread started by the SDK, see RPlidarDriver::setCacheThreadAttributes
+///
+/// Real-time policies need CAP_SYS_NICE (or root) on Linux. A real-time decode thread pinned to a core
+/// of its own keeps up with the device even while logging or other processes load the remaining cores.
+struct RplidarThreadAttributes {
+    _u32    policy;         // THREAD_POLICY_*
+    _u32    priority;       // 0 to 100, spread over the priority range the OS gives a real-time policy
+    _u64    cpu_mask;       // bit n allows CPU n, 0 allows all of them
+    char    name[16];       // shown by top -H and ps -L, at most 15 characters, empty to keep the current name
+
+    RplidarThreadAttributes() : policy(THREAD_POLICY_DEFAULT), priority(0), cpu_mask(0) { name[0] = 0; }
+};
+
 enum {
     DRIVER_TYPE_SERIALPORT = 0x0,
     DRIVER_TYPE_TCP = 0x1,
+    DRIVER_TYPE_REPLAY = 0x2,   // plays back a file written by RPlidarDriver::startRecording
+    DRIVER_TYPE_UDP = 0x3,      // network lidars sending their scan data as datagrams of whole frames
+};
+
+/// Replay speed in percent of the recorded speed, see RPlidarDriver::connect
+enum {
+    REPLAY_PACE_AS_FAST_AS_POSSIBLE = 0,
+    REPLAY_PACE_ORIGINAL = 100,
 };
 
 class ChannelDevice
 {
 public:
+    virtual ~ChannelDevice() {}
     virtual bool bind(const char*, uint32_t ) = 0;
     virtual bool open() {return true;}
     virtual void close() = 0;
     virtual void flush() {return;}
     virtual bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL) = 0;
+    virtual bool isDeviceLost() {return false;}
+    virtual void cancelWait() {return;}
+    virtual void clearCancelWait() {return;}
+    virtual size_t getLostDatagramCount() {return 0;}
+    virtual int getPollHandle() {return -1;}
     virtual int senddata(const _u8 * data, size_t size) = 0;
     virtual int recvdata(unsigned char * data, size_t size) = 0;
     virtual void setDTR() {return;}
@@ -80,6 +146,77 @@ public:
     virtual void ReleaseRxTx() {return;}
 };
 
+/// Receives scan data pushed by the driver, see RPlidarDriver::setScanListener
+///
+/// Unless SCAN_LISTENER_FLAG_CONSUMER_THREAD is used, the callbacks run on the driver's
+/// cache thread, or on the reactor worker serving the driver (see RPlidarReactor), which is
+/// also the thread decoding the incoming data. While a callback
+/// runs nothing else is decoded, so every millisecond spent in it delays the following
+/// samples by a millisecond. Latency budget:
+///
+///   onSector   well under one sector period, i.e. revolution period / sectorCount
+///              (10ms per sector for 10 sectors at 10Hz).
+///   onScan     well under one revolution period minus the time spent in onSector,
+///              a few milliseconds is a good target.
+///
+/// A listener regularly going over budget builds a backlog in the kernel tty buffers
+/// until they overflow (about 64KB on Linux, a few seconds at 256000 baud) and samples
+/// get lost.
+///
+/// Anything heavier than a bounds or obstacle check belongs on the consumer thread.
+///
+/// The node arrays are read-only views into driver memory and are only valid until the
+/// callback returns.
+class ScanListener
+{
+public:
+    virtual ~ScanListener() {}
+
+    /// A complete 0-360 degree scan is available, nodes[0] carries the sync bit
+    virtual void onScan(const rplidar_response_measurement_node_hq_t * nodes, size_t count, const RplidarScanTimestamp & timestamp) = 0;
+
+    /// All the samples of one angular sector of the scan being received have arrived.
+    /// Sectors split 360 degrees into sectorCount equal parts, sectorIndex 0 starts at 0 degree.
+    /// Sectors without any sample are not reported. Always runs on the cache thread.
+    virtual void onSector(const rplidar_response_measurement_node_hq_t * /*nodes*/, size_t /*count*/, _u32 /*sectorIndex*/) {}
+};
+
+class RPlidarDriverImplCommon;
+class RPlidarReactor;
+
+/// Shared, read-only handle to one complete scan held in a driver-owned buffer pool, see RPlidarDriver::grabScanLease
+///
+/// Copying a lease shares the same buffer, the buffer goes back to the pool once the last
+/// copy is released or destroyed. Copies can be handed to other threads; a single lease
+/// object must not be used by two threads at once.
+/// All leases have to be released before the driver is disposed.
+class ScanLease
+{
+public:
+    struct Block;
+
+    ScanLease();
+    ScanLease(const ScanLease & other);
+    ScanLease & operator=(const ScanLease & other);
+    ~ScanLease();
+
+    /// Drop this reference, the lease is empty afterwards
+    void release();
+
+    bool isValid() const;
+    const rplidar_response_measurement_node_hq_t * nodes() const;
+    size_t count() const;
+    const RplidarScanTimestamp & timestamp() const;
+
+protected:
+    friend class RPlidarDriverImplCommon;
+
+    /// Takes over the reference the pool handed out with the block
+    explicit ScanLease(Block * block);
+
+    Block * _block;
+};
+
 class RPlidarDriver {
 public:
     enum {
@@ -90,16 +227,53 @@ public:
         MAX_SCAN_NODES = 8192,
     };
 
+    // Nodes per revolution each device family needs in its densest scan mode
+    // at the lowest spin rate, rounded up to a power of 2
+    enum {
+        SCAN_CAPACITY_A1 = 2048,    //  8K samples/s at 5.5Hz
+        SCAN_CAPACITY_A2 = 4096,    // 16K samples/s at 5Hz
+        SCAN_CAPACITY_A3 = 4096,    // 16K samples/s at 5Hz
+        SCAN_CAPACITY_S1 = 2048,    // 9.2K samples/s at 8Hz
+        SCAN_CAPACITY_S2 = 4096,    // 32K samples/s at 10Hz
+    };
+
     enum {
         LEGACY_SAMPLE_DURATION = 476,
     };
 
+    enum {
+        SCAN_LISTENER_FLAG_CONSUMER_THREAD = 0x1,
+    };
+
+    enum {
+        SCAN_LEASE_POOL_SIZE = 4,
+    };
+
+    // setScanFrequency, in revolutions per second
+    enum {
+        MIN_SCAN_FREQUENCY = 2,
+        MAX_SCAN_FREQUENCY = 20,
+    };
+
+    // startScanAuto
+    enum {
+        DEFAULT_DECODE_BUDGET_PERCENT = 25,
+        AUTO_SCAN_VERIFY_SCANS = 5,         // consecutive scans checked after a mode is started
+        AUTO_SCAN_MIN_DELIVERED_PERCENT = 90,
+    };
+
 public:
     /// Create an RPLIDAR Driver Instance
     /// This interface should be invoked first before any other operations
     ///
     /// \param drivertype the connection type used by the driver. 
-    static RPlidarDriver * CreateDriver(_u32 drivertype = DRIVER_TYPE_SERIALPORT);
+    ///
+    /// \param scanCapacity the max number of nodes kept per revolution, one of the SCAN_CAPACITY_* values for the
+    ///                     target device family. It must be a power of 2 no larger than MAX_SCAN_NODES.
+    ///                     The scan buffers are sized from it and allocated once, by the first connect call.
+    ///
+    /// The interface will return NULL for an unknown drivertype or an invalid scanCapacity.
+    static RPlidarDriver * CreateDriver(_u32 drivertype = DRIVER_TYPE_SERIALPORT, _u32 scanCapacity = MAX_SCAN_NODES);
 
     /// Dispose the RPLIDAR Driver Instance specified by the drv parameter
     /// Applications should invoke this interface when the driver instance is no longer used in order to free memory
@@ -117,15 +291,40 @@ public:
     ///
     /// \param flag          other flags
     ///        Reserved for future use, always set to Zero
+    ///
+    /// A DRIVER_TYPE_TCP or DRIVER_TYPE_UDP driver takes the IP address of the device and its port.
+    ///
+    /// A DRIVER_TYPE_REPLAY driver takes the path of a file written by startRecording instead of the serial port,
+    /// and a replay pace instead of the baudrate: REPLAY_PACE_ORIGINAL replays the data at the recorded timing,
+    /// REPLAY_PACE_AS_FAST_AS_POSSIBLE as fast as it is read, and other values scale the recorded speed in percent.
+    ///
+    /// The interface will return RESULT_INSUFFICIENT_MEMORY when the scan buffers cannot be allocated.
     virtual u_result connect(const char *, _u32, _u32 flag = 0) = 0;
 
 
     /// Disconnect with the RPLIDAR and close the serial port
+    /// A serial port driver can connect again afterwards, e.g. once the device is plugged back in.
     virtual void disconnect() = 0;
 
     /// Returns TRUE when the connection has been established
     virtual bool isConnected() = 0;
 
+    /// Returns TRUE while the background thread started by a scan is fetching data
+    /// A scan ends by itself when the serial port reports the device gone, e.g. after a USB disconnect.
+    virtual bool isScanning() = 0;
+
+    /// Get how long the device has been silent during the current scan
+    ///
+    /// \param idle_ms       Once the interface returns, the milliseconds since data was last received from the device,
+    ///                      or since the scan started if nothing has arrived yet.
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL when no scan is running.
+    virtual u_result getScanIdleTime(_u32 & idle_ms) = 0;
+
+    /// Returns the max number of nodes kept per revolution, as chosen by CreateDriver
+    /// Longer revolutions are cut at this size.
+    virtual _u32 getScanCapacity() = 0;
+
     /// Ask the RPLIDAR core system to reset it self
     /// The host system can use the Reset operation to help RPLIDAR escape the self-protection mode.
     ///
@@ -156,6 +355,30 @@ public:
     /// \param outUsedScanMode  The scan mode selected by lidar
     virtual u_result startScanExpress(bool force, _u16 scanMode, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Start scan in the densest mode this host can decode
+    /// The decode cost of every mode the device supports is measured on this host with the decoders the driver uses,
+    /// once per process. The densest mode whose decoding takes at most decodeBudgetPercent of one CPU is started, the
+    /// longest range one among equally dense modes. The motor must already be running.
+    ///
+    /// AUTO_SCAN_VERIFY_SCANS consecutive scans are then grabbed, and the revolutions/s they were published at are
+    /// compared to what getFrequency gives for their size. When less than AUTO_SCAN_MIN_DELIVERED_PERCENT of the
+    /// samples arrived, because revolutions or frames were dropped, the next mode in that order is tried. If none
+    /// passes, the mode with the highest delivered ratio is kept running and outSelection->verified is false.
+    ///
+    /// The scans grabbed for the check are not returned to the caller. Without the configuration protocol only
+    /// the typical mode is checked. With a threaded scan listener set, nothing can be grabbed and the densest mode
+    /// within the budget is kept unchecked.
+    ///
+    /// \param decodeBudgetPercent  Share of one CPU the decoding may take, the rest of the receive path and the
+    ///                             application need the headroom left
+    /// \param outSelection         The mode started, its decode cost and the result of the check
+    /// \param timeout              Max duration allowed for each scan grabbed for the check
+    ///
+    /// A mode that fails to start or delivers no scan within the timeout is skipped. When no mode is left running,
+    /// scanning is stopped and the interface will return the first failure to start one, or RESULT_OPERATION_TIMEOUT
+    /// when every mode started but timed out.
+    virtual u_result startScanAuto(_u32 decodeBudgetPercent = DEFAULT_DECODE_BUDGET_PERCENT, RplidarScanModeSelection * outSelection = NULL, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
     /// Retrieve the health status of the RPLIDAR
     /// The host system can use this operation to check whether RPLIDAR is in the self-protection mode.
     ///
@@ -165,11 +388,23 @@ public:
     virtual u_result getHealth(rplidar_response_device_health_t & health, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
     /// Get the device information of the RPLIDAR include the serial number, firmware version, device model etc.
+    /// Only the first call after connect queries the device, later ones are answered from the capability cache.
     /// 
     /// \param info          The device information returned from the RPLIDAR
     /// \param timeout       The operation timeout value (in millisecond) for the serial port communication  
     virtual u_result getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Keep the device capabilities on disk too, so an application restart skips the device queries
+    /// The device info, motor control support, sample durations and scan mode table are cached in memory once
+    /// queried. With a directory set, they are also stored there in one file per device serial number and
+    /// reloaded by the next connect to the same device. A firmware update invalidates the stored file.
+    ///
+    /// \param path          The directory holding the cache files, NULL to keep the cache in memory only
+    virtual u_result setCapabilityCacheDir(const char * path) = 0;
+
+    /// Drop the cached device capabilities, in memory and on disk
+    virtual u_result clearCapabilityCache() = 0;
+
     /// Get the sample duration information of the RPLIDAR.
     /// DEPRECATED, please use RplidarScanMode::us_per_sample
     ///
@@ -193,6 +428,34 @@ public:
     /// Stop RPLIDAR's motor when using accessory board
     virtual u_result stopMotor() = 0;
 
+    /// Keep the motor spinning at the given scan frequency
+    /// The revolution period is measured between the sync nodes of consecutive scans, and the motor PWM, or the rpm
+    /// of a TOF lidar, is corrected every few revolutions until the frequency is within 1% of the target. It only
+    /// regulates while scanning, starting from the command startMotor, setMotorPWM or setLidarSpinSpeed gave last,
+    /// and never starts a stopped motor. Those calls keep working, the regulation carries on from what they set.
+    ///
+    /// \param frequency     Revolutions per second, MIN_SCAN_FREQUENCY to MAX_SCAN_FREQUENCY, 0 to stop regulating and
+    ///                      leave the motor command as it is
+    ///
+    /// The interface will return RESULT_OPERATION_NOT_SUPPORT for a device without motor control, e.g. an A1, and
+    /// RESULT_INVALID_DATA for a frequency out of range. While scanning, that includes a frequency so low a revolution
+    /// of the running mode takes more samples than getScanCapacity holds; such a revolution is not measured.
+    virtual u_result setScanFrequency(float frequency) = 0;
+
+    /// Regulate the scan frequency to the given angular resolution
+    /// Samples keep coming at the rate of the scan mode, so the angle between two of them grows with the spin rate:
+    /// a coarser resolution gives more scans per second, a finer one fewer scans to process. The frequency is worked
+    /// out from the sample duration measured over the current scan and passed to setScanFrequency.
+    ///
+    /// \param degrees       Angle between two consecutive samples
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL when no scan is running, and fails like setScanFrequency
+    /// otherwise.
+    virtual u_result setAngularResolution(float degrees) = 0;
+
+    /// Get the state of the scan frequency regulation, the measured frequency is kept up to date without one too
+    virtual u_result getSpinStatus(RplidarSpinStatus & status) = 0;
+
     /// Check whether the device support motor control.
     /// Note: this API will disable grab.
     /// 
@@ -288,6 +551,61 @@ public:
     /// \The caller application can set the timeout value to Zero(0) to make this interface always returns immediately to achieve non-block operation.
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Same as grabScanDataHq, but hands out the scan data held by the driver instead of copying it.
+    ///
+    /// \param nodebuffer     Once the interface returns, points to the grabbed scan data. The data stays untouched by the driver
+    ///                       until the next call to grabScanData, grabScanDataHq or grabScanDataHqNoCopy.
+    ///
+    /// \param count          Once the interface returns, this parameter will store the actual received data count.
+    ///
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that no complete 360-degrees' scan can be retrieved withing the given timeout duration.
+    virtual u_result grabScanDataHqNoCopy(const rplidar_response_measurement_node_hq_t * & nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Same as grabScanDataHq, but the scan is copied once into a buffer from a pool of SCAN_LEASE_POOL_SIZE
+    /// buffers and handed out as a ref-counted lease, so several consumers can share it without copies of their own.
+    ///
+    /// \param lease         Once the interface returns, holds the grabbed scan. Whatever the lease held before is released.
+    ///
+    /// \param timeout       Max duration allowed to wait for a complete scan data.
+    ///
+    /// The interface will return RESULT_INSUFFICIENT_MEMORY when all pooled buffers are still leased out, and
+    /// RESULT_OPERATION_TIMEOUT when no complete 360-degrees' scan can be retrieved withing the given timeout duration.
+    virtual u_result grabScanLease(ScanLease & lease, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Get the timing of the scan returned by the last successful call to grabScanData, grabScanDataHq or grabScanDataHqNoCopy
+    ///
+    /// \param timestamp     Host time of the first sample and the measured sample duration of that scan.
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL if no scan has been grabbed yet.
+    virtual u_result getGrabbedScanTimestamp(RplidarScanTimestamp & timestamp) = 0;
+
+    /// Map a time of the device clock, as carried by HQ capsules (time_stamp, in microseconds), onto the host clock.
+    /// The mapping compensates the offset and the drift between both clocks and is updated continuously in HQ mode.
+    ///
+    /// \param device_us     Device time to convert.
+    ///
+    /// \param host_us       Once the interface returns, the host CLOCK_MONOTONIC time in microseconds (rp::arch::rp_getus).
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL if no HQ capsule has been received yet.
+    virtual u_result mapDeviceTimeToHost(_u64 device_us, _u64 & host_us) = 0;
+
+    /// Register a listener the driver pushes every complete scan to, as soon as the sync bit of the following scan arrives.
+    /// This saves the wake-up and copy of grabScanDataHq. See ScanListener for the latency budget of the callbacks.
+    ///
+    /// \param listener      The listener to call, or NULL to remove the current one. It must stay alive until it is removed.
+    ///
+    /// \param sectorCount   Number of sectors for ScanListener::onSector, at least 3. Zero disables the sector callbacks.
+    ///
+    /// \param flags         SCAN_LISTENER_FLAG_CONSUMER_THREAD moves onScan to a separate thread started by the driver, so
+    ///                      heavy processing does not hold up the data decoding. Scans arriving while onScan is still busy
+    ///                      are skipped, the callback always gets the most recent one. grabScanData, grabScanDataHq and
+    ///                      grabScanDataHqNoCopy return RESULT_OPERATION_NOT_SUPPORT while such a listener is registered.
+    ///
+    /// The listener can only be changed while no scan is running, RESULT_OPERATION_FAIL is returned otherwise.
+    virtual u_result setScanListener(ScanListener * listener, _u32 sectorCount = 0, _u32 flags = 0) = 0;
+
     /// Ascending the scan data according to the angle value in the scan.
     ///
     /// \param nodebuffer     Buffer provided by the caller application to do the reorder. Should be retrived from the grabScanData
@@ -328,6 +646,60 @@ public:
     /// The interface will return RESULT_REMAINING_DATA to indicate that the given buffer is full, but that there remains data to be read.
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count) = 0;
 
+    /// Return how many received scan points were discarded because the buffer behind getScanDataWithInterval/getScanDataWithIntervalHq
+    /// was full, i.e. the caller did not retrieve the points fast enough.
+    ///
+    /// \param dropCount      Once the interface returns, this parameter will store the number of points discarded since the last call.
+    virtual u_result getScanDataWithIntervalDropCount(size_t & dropCount) = 0;
+
+    /// Return how many scan data datagrams were lost on the way or dropped as malformed, DRIVER_TYPE_UDP only
+    /// Losses are detected when the socket receive queue overflows, and when a datagram does not hold whole
+    /// frames. The scan data protocol carries no sequence numbers, so datagrams lost on the network go unnoticed.
+    /// A lost datagram only leaves a gap in the scan, the frames following it are decoded right away.
+    ///
+    /// \param lostCount      Once the interface returns, this parameter will store the number of datagrams lost since the last call.
+    ///
+    /// The interface will return RESULT_OPERATION_NOT_SUPPORT for drivers not receiving datagrams.
+    virtual u_result getDatagramLossCount(size_t & lostCount) = 0;
+
+    /// Record everything exchanged with the device to a file, for a DRIVER_TYPE_REPLAY driver to play back
+    /// Received data is stored with the time it arrived. The replay answers the commands of the replaying driver
+    /// with the data recorded after the same commands, so it has to go through the recorded steps: start recording
+    /// before connect, and give both drivers the same capability cache state (e.g. no cache directory), since the
+    /// cache decides which queries reach the device.
+    ///
+    /// \param path          The file to record to, it is overwritten
+    ///
+    /// Recording can only be started and stopped while no scan is running, RESULT_OPERATION_FAIL is returned otherwise.
+    virtual u_result startRecording(const char * path) = 0;
+
+    /// Stop recording and close the recording file
+    virtual u_result stopRecording() = 0;
+
+    /// Receive the scan data on the threads of a reactor instead of a cache thread of the driver's own
+    /// Takes effect with the next scan started. A driver stays attached across disconnect and connect.
+    ///
+    /// \param reactor       The reactor to attach to, NULL to go back to a cache thread of the driver's own.
+    ///
+    /// The reactor can only be changed while no scan is running, RESULT_OPERATION_FAIL is returned otherwise.
+    /// Starting a scan returns RESULT_OPERATION_NOT_SUPPORT if the driver's channel cannot be waited on by a reactor.
+    virtual u_result setReactor(RPlidarReactor * reactor) = 0;
+
+    /// Set the scheduling and the CPUs of the cache thread, which receives and decodes the scan data
+    /// Applied right away to a running cache thread, and to every cache thread started afterwards. A driver attached
+    /// to a reactor has no cache thread, see RPlidarReactor::setThreadAttributes instead.
+    ///
+    /// \param attributes    The attributes to apply.
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL if the OS refuses an attribute for the running cache thread,
+    /// typically a real-time policy without the privilege. The other attributes are applied all the same, and a cache
+    /// thread started later on keeps the default scheduling then, see getCacheThreadAttributesResult.
+    virtual u_result setCacheThreadAttributes(const RplidarThreadAttributes & attributes) = 0;
+
+    /// Get whether the OS accepted the cache thread attributes the latest time they were applied
+    /// A scan started while the attributes are refused still runs. RESULT_OK as long as none were applied.
+    virtual u_result getCacheThreadAttributesResult() = 0;
+
     virtual ~RPlidarDriver() {}
 protected:
     RPlidarDriver(){}
@@ -0,0 +1,89 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+/// Receives the scan data of several drivers on shared threads, see RPlidarDriver::setReactor
+///
+/// Without a reactor every scanning driver runs a cache thread of its own, blocked in a wait
+/// on its port. A reactor replaces those with a single thread waiting on the ports of all its
+/// scanning drivers at once, and a small fixed pool of worker threads decoding the data of
+/// whichever ports turned readable. A driver is served by one worker at a time, so its data
+/// is still decoded in order; different drivers are decoded in parallel.
+///
+/// Scan listener callbacks of drivers on a reactor run on a worker, which holds up the
+/// decoding of the other drivers as well. Keep them within the ScanListener budget or use
+/// SCAN_LISTENER_FLAG_CONSUMER_THREAD.
+///
+/// Serial port, TCP and UDP drivers can use a reactor; a DRIVER_TYPE_REPLAY driver cannot.
+/// All drivers have to be detached before the reactor is disposed.
+class RPlidarReactor
+{
+public:
+    enum {
+        DEFAULT_WORKER_COUNT = 2,
+        MAX_WORKER_COUNT = 8,
+    };
+
+public:
+    /// Create a reactor and start its threads
+    ///
+    /// \param workerCount   The number of decoding threads, from 1 to MAX_WORKER_COUNT.
+    ///
+    /// The interface will return NULL if the count is out of range or the threads cannot be started.
+    static RPlidarReactor * CreateReactor(_u32 workerCount = DEFAULT_WORKER_COUNT);
+
+    /// Stop the threads and dispose the reactor
+    static void DisposeReactor(RPlidarReactor * reactor);
+
+    /// Get the number of drivers attached through RPlidarDriver::setReactor
+    virtual size_t getDriverCount() = 0;
+
+    /// Get the number of drivers currently scanning, i.e. whose ports are being waited on
+    virtual size_t getScanningCount() = 0;
+
+    /// Set the scheduling and the CPUs of the reactor thread and of all the workers
+    /// The workers are named after attributes.name followed by their index.
+    ///
+    /// The interface will return RESULT_OPERATION_FAIL if the OS refuses the attributes for any of the threads.
+    virtual u_result setThreadAttributes(const RplidarThreadAttributes & attributes) = 0;
+
+    virtual ~RPlidarReactor() {}
+protected:
+    RPlidarReactor() {}
+};
+
+}}}
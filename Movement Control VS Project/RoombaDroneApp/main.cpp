@@ -5,6 +5,7 @@
 #include <wiringPi.h>          // to control Raspberry Pi digital pins
 #include "include/rplidar.h"   // RPLidar standard SDK
 #include "src/datetime.h"      // to have current time for logging
+#include "src/hal/thread.h"    // to pin and prioritize the control loop
 #include <algorithm>           // to sort arrays
 
 // Raspberry PI prerequisites:
@@ -172,6 +173,8 @@ void GetInput(WheelControl* wheelControl);
 
 int distanceToObstacleInFrontLimit = 3000; // mm
 int rideDuration = 2; // s
+float idleScanFrequency = 7; // Hz, finer angular resolution while the way is clear
+float avoidingScanFrequency = 12; // Hz, fresher scans while turning away from obstacles
 
 datetime movementStart;
 datetime defaultTime = datetime(2000, 1, 1, 0, 0, 0);
@@ -201,7 +204,21 @@ void ctrlc(int) {
 	ctrl_c_pressed = true;
 }
 
-void onFinished(RPlidarDriver* driver) {
+// logs Lidar outages, the connection manager reconnects and restores the scan by itself
+class LidarLinkLog : public ConnectionListener {
+public:
+	void onConnectionLost() {
+		std::cout << jed_utils::datetime().to_string() << " Lidar connection lost, waiting for the device\n";
+	}
+
+	void onConnectionRestored(_u32 outage_ms) {
+		std::cout << jed_utils::datetime().to_string() << " Lidar connection restored after " << outage_ms << " ms\n";
+	}
+};
+
+void onFinished(RPlidarConnectionManager* lidarLink, RPlidarDriver* driver) {
+	// the manager uses the driver, so it goes first
+	RPlidarConnectionManager::DisposeManager(lidarLink);
 	RPlidarDriver::DisposeDriver(driver);
 	driver = NULL;
 }
@@ -247,41 +264,43 @@ int main(void)
 	std::cout << jed_utils::datetime().to_string() << " App started\n";
 
 	// create the driver instance
-	RPlidarDriver* driver = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+	RPlidarDriver* driver = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT, RPlidarDriver::SCAN_CAPACITY_A1);
 
 	if (!driver) {
 		std::cout << jed_utils::datetime().to_string() << " Insufficent memory, exit.\n";
 		exit(-2);
 	}
 
+	// keep the lidar capabilities next to the .out file, so restarts skip the device queries
+	driver->setCapabilityCacheDir(".");
+
+	// keeps the Lidar connected, reconnecting as soon as it reappears after a USB glitch or brown-out
+	RPlidarConnectionManager* lidarLink = RPlidarConnectionManager::CreateManager(driver);
+	LidarLinkLog lidarLinkLog;
+	lidarLink->setListener(&lidarLinkLog);
+
 	std::cout << jed_utils::datetime().to_string() << " Connecting to Lidar\n";
 
 	rplidar_response_device_info_t devInfo;
 
-	// check for the Lidar and connect to it
+	// wait for the Lidar to show up on the port
 	// if it doesn't find the device in 15 minutes - throw an error and end the program
-	while (connectionTimeout < 900) {
-		if (IS_OK(driver->connect(comPath, baudrate))) {
-			opResult = driver->getDeviceInfo(devInfo);
-			if (IS_OK(opResult)) {
-				std::cout << jed_utils::datetime().to_string() << " Connected to Lidar\n";
-				connectSuccess = true;
-				break;
-			}
+	if (IS_OK(lidarLink->start(comPath, baudrate)) && IS_OK(lidarLink->waitForLink(900 * 1000))) {
+		opResult = driver->getDeviceInfo(devInfo);
+		if (IS_OK(opResult)) {
+			std::cout << jed_utils::datetime().to_string() << " Connected to Lidar\n";
+			connectSuccess = true;
 		}
-		std::cout << jed_utils::datetime().to_string() << " Failed connecting to Lidar. " << connectionTimeout << "\\\900 \n";
-		delay(1000);
-		connectionTimeout++;
 	}
 
 	if (!connectSuccess) {
 		std::cout << jed_utils::datetime().to_string() << " Cannot bind to the pre-defined serial port: " << comPath << ", exit\n";
-		onFinished(driver);
+		onFinished(lidarLink, driver);
 	}
 
 	// check Lidar health
 	if (!checkLidarHealth(driver)) {
-		onFinished(driver);
+		onFinished(lidarLink, driver);
 	}
 
 	// create detection of ctrl + c pressed
@@ -307,7 +326,7 @@ int main(void)
 
 	if (!connectSuccess) {
 		std::cout << jed_utils::datetime().to_string() << " Failed to open results.txt file, exit.\n";
-		onFinished(driver);
+		onFinished(lidarLink, driver);
 	}
 
 	// set-up movement controls
@@ -327,9 +346,43 @@ int main(void)
 	wheelControl = new WheelControl(enablePin, A, B);
 	wheelControl->Initialize();
 
-	// start scanning
-	driver->startMotor();
-	driver->startScan(0, 1);
+	// keep the lidar cache thread and this control loop off the cores the logging runs on,
+	// the cache thread above the loop so a revolution is never held up by obstacle handling
+	RplidarThreadAttributes cacheAttributes;
+	cacheAttributes.policy = THREAD_POLICY_RR;
+	cacheAttributes.priority = 60;
+	cacheAttributes.cpu_mask = 1 << 3;
+	strcpy(cacheAttributes.name, "lidar-cache");
+	driver->setCacheThreadAttributes(cacheAttributes);
+
+	// pinned and named even when real-time priority is refused
+	rp::hal::Thread controlThread = rp::hal::Thread::current();
+	bool isControlScheduled = IS_OK(controlThread.setScheduling(rp::hal::Thread::SCHED_POLICY_RR, 40));
+	isControlScheduled = IS_OK(controlThread.setAffinity(1 << 2)) && isControlScheduled;
+	if (!isControlScheduled) {
+		std::cout << jed_utils::datetime().to_string() << " Cannot run the control loop at real-time priority, keeping the default scheduling\n";
+	}
+	controlThread.setName("control-loop");
+
+	// start scanning, through the manager so a reconnect restores it
+	lidarLink->startMotor();
+	// in the densest mode this board decodes without dropping revolutions
+	RplidarScanModeSelection scanSelection;
+	if (IS_OK(lidarLink->startScanAuto(RPlidarDriver::DEFAULT_DECODE_BUDGET_PERCENT, &scanSelection))) {
+		std::cout << jed_utils::datetime().to_string() << " Scanning in " << scanSelection.mode.scan_mode << " mode at " << scanSelection.frequency << " Hz"
+			<< (scanSelection.verified ? "" : ", revolutions are dropped in every mode") << "\n";
+	}
+	// the attributes are applied as the cache thread starts
+	if (IS_FAIL(driver->getCacheThreadAttributesResult())) {
+		std::cout << jed_utils::datetime().to_string() << " Cannot set the lidar cache thread attributes\n";
+	}
+
+	// the driver keeps the spin rate on target; an A1 has no motor control and spins as it does
+	float scanFrequency = idleScanFrequency;
+	bool isSpinRegulated = IS_OK(driver->setScanFrequency(scanFrequency));
+	if (!isSpinRegulated) {
+		std::cout << jed_utils::datetime().to_string() << " Lidar spin rate cannot be regulated, keeping the default\n";
+	}
 
 	std::cout << jed_utils::datetime().to_string() << " Detection started\n";
 
@@ -346,9 +399,11 @@ int main(void)
 		lastScanData[i] = 0;
 	}
 
+	// one revolution of the A1, reused by every iteration
+	rplidar_response_measurement_node_hq_t nodes[RPlidarDriver::SCAN_CAPACITY_A1];
+
 	while (1) {
-		size_t count = 8192;
-		rplidar_response_measurement_node_hq_t nodes[count];
+		size_t count = sizeof(nodes) / sizeof(nodes[0]);
 
 		obstacleTooClose = 0;
 		leftSideArrayPos = 0;
@@ -465,6 +520,12 @@ int main(void)
 				if (leftSideMedian == rightSideMedian) { moveToLeft(wheelControl); }
 			}
 
+			// trade angular resolution for update rate while avoiding
+			float wantedFrequency = (leftSideMedian != 0 || rightSideMedian != 0) ? avoidingScanFrequency : idleScanFrequency;
+			if (isSpinRegulated && wantedFrequency != scanFrequency && IS_OK(driver->setScanFrequency(wantedFrequency))) {
+				scanFrequency = wantedFrequency;
+			}
+
 			checkMovement();
 
 			// remove last comma
@@ -488,12 +549,12 @@ int main(void)
 	}
 
 	// stop scanning
-	driver->stop();
-	driver->stopMotor();
+	lidarLink->stopScan();
+	lidarLink->stopMotor();
 
 	// end program
 	std::cout << jed_utils::datetime().to_string() << " App cancellation initiated\n";
-	onFinished(driver);
+	onFinished(lidarLink, driver);
 	resultFile.close();
 
 	return 0;
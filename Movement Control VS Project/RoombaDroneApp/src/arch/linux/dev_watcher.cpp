@@ -0,0 +1,219 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "arch_linux.h"
+#include "../../hal/types.h"
+#include "dev_watcher.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+namespace rp{ namespace arch{
+
+inotify_watcher::inotify_watcher()
+    : _inotifyfd(-1)
+    , _wd(-1)
+    , _epollfd(-1)
+    , _cancelfd(-1)
+{
+}
+
+inotify_watcher::~inotify_watcher()
+{
+    unwatch();
+}
+
+bool inotify_watcher::watch(const char * node_path)
+{
+    unwatch();
+
+    _nodePath = node_path;
+    size_t slash = _nodePath.rfind('/');
+    if (slash == std::string::npos) {
+        _dirName = ".";
+        _nodeName = _nodePath;
+    } else {
+        _dirName = slash ? _nodePath.substr(0, slash) : std::string("/");
+        _nodeName = _nodePath.substr(slash + 1);
+    }
+    if (_nodeName.empty()) return false;
+
+    _inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _epollfd = epoll_create1(EPOLL_CLOEXEC);
+    _cancelfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_inotifyfd == -1 || _epollfd == -1 || _cancelfd == -1) {
+        unwatch();
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = _inotifyfd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _inotifyfd, &ev) == -1) {
+        unwatch();
+        return false;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = _cancelfd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _cancelfd, &ev) == -1) {
+        unwatch();
+        return false;
+    }
+
+    // a missing directory, e.g. /dev/serial/by-id with no adapter plugged in,
+    // is picked up again by waitForEvent
+    _addWatch();
+    return true;
+}
+
+void inotify_watcher::unwatch()
+{
+    if (_inotifyfd != -1) ::close(_inotifyfd);
+    if (_epollfd != -1) ::close(_epollfd);
+    if (_cancelfd != -1) ::close(_cancelfd);
+
+    _inotifyfd = _epollfd = _cancelfd = -1;
+    _wd = -1;
+}
+
+bool inotify_watcher::isPresent()
+{
+    struct stat st;
+    return !_nodePath.empty() && stat(_nodePath.c_str(), &st) == 0;
+}
+
+bool inotify_watcher::_addWatch()
+{
+    _wd = inotify_add_watch(_inotifyfd, _dirName.c_str(),
+        IN_CREATE | IN_ATTRIB | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF);
+    return _wd != -1;
+}
+
+int inotify_watcher::_readEvents()
+{
+    // inotify hands out whole events only, the buffer has to be aligned for them
+    char buffer[EVENT_BUFFER_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    int  ans = EVENT_TIMEOUT;
+
+    for (;;) {
+        ssize_t len = ::read(_inotifyfd, buffer, sizeof(buffer));
+        if (len <= 0) break;
+
+        for (char * pos = buffer; pos < buffer + len; ) {
+            const struct inotify_event * event = reinterpret_cast<const struct inotify_event *>(pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                // the directory went away and took the node with it
+                if (event->mask & IN_IGNORED) _wd = -1;
+                ans = EVENT_NODE_REMOVED;
+                continue;
+            }
+            if (!event->len || _nodeName != event->name) continue;
+
+            // the last event of the batch tells the current state
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                ans = EVENT_NODE_REMOVED;
+            } else {
+                ans = EVENT_NODE_ADDED;
+            }
+        }
+    }
+    return ans;
+}
+
+int inotify_watcher::waitForEvent(_u32 timeout)
+{
+    if (_epollfd == -1) return EVENT_FAILED;
+
+    _u32 startTs = getms();
+    _u32 waitTime;
+
+    while ((waitTime = getms() - startTs) <= timeout) {
+        _u32 remainMs = timeout - waitTime;
+
+        if (_wd == -1) {
+            if (_addWatch() && isPresent()) {
+                // the directory and the node showed up between two attempts
+                return EVENT_NODE_ADDED;
+            }
+            if (_wd == -1 && remainMs > DIR_RETRY_INTERVAL) remainMs = DIR_RETRY_INTERVAL;
+        }
+
+        struct epoll_event events[2];
+        int n = epoll_wait(_epollfd, events, 2, remainMs > 0x7FFFFFFF ? -1 : (int)remainMs);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return EVENT_FAILED;
+        }
+
+        int ans = EVENT_TIMEOUT;
+        for (int pos = 0; pos < n; ++pos) {
+            if (events[pos].data.fd == _cancelfd) {
+                uint64_t signalled;
+                ::read(_cancelfd, &signalled, sizeof(signalled));
+                return EVENT_CANCELLED;
+            }
+            ans = _readEvents();
+        }
+        if (ans != EVENT_TIMEOUT) return ans;
+    }
+    return EVENT_TIMEOUT;
+}
+
+void inotify_watcher::cancel()
+{
+    if (_cancelfd == -1) return;
+
+    uint64_t signal = 1;
+    ::write(_cancelfd, &signal, sizeof(signal));
+}
+
+}} //end rp::arch
+
+//begin rp::hal
+namespace rp{ namespace hal{
+
+DeviceWatcher * DeviceWatcher::CreateWatcher()
+{
+    return new rp::arch::inotify_watcher();
+}
+
+void DeviceWatcher::ReleaseWatcher(DeviceWatcher * watcher)
+{
+    delete watcher;
+}
+
+}} //end rp::hal
@@ -0,0 +1,74 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include "../../hal/dev_watcher.h"
+
+#include <string>
+
+namespace rp{ namespace arch{
+
+class inotify_watcher : public rp::hal::DeviceWatcher
+{
+public:
+    enum {
+        EVENT_BUFFER_SIZE   = 4096,
+        DIR_RETRY_INTERVAL  = 100,  // ms between attempts to watch a directory that does not exist yet
+    };
+
+    inotify_watcher();
+    virtual ~inotify_watcher();
+
+    virtual bool watch(const char * node_path);
+    virtual void unwatch();
+    virtual bool isPresent();
+    virtual int  waitForEvent(_u32 timeout);
+    virtual void cancel();
+
+protected:
+    bool _addWatch();
+    int  _readEvents();
+
+    std::string _nodePath;
+    std::string _dirName;
+    std::string _nodeName;
+
+    int     _inotifyfd;
+    int     _wd;            // watch on _dirName, -1 while the directory is missing
+    int     _epollfd;
+    int     _cancelfd;      // eventfd signalled by cancel
+};
+
+}}
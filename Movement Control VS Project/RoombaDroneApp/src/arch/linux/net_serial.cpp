@@ -46,7 +46,8 @@
 #include <time.h>
 #include "../../hal/types.h"
 #include "net_serial.h"
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <algorithm>
 //__GNUC__
@@ -55,6 +56,7 @@
 #include <asm/ioctls.h>
 #include <asm/termbits.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 extern "C" int tcflush(int fildes, int queue_selector);
 #else
 // for other standard UNIX
@@ -183,7 +185,16 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
 
     ioctl(serial_fd, TCSETS2, &tio);
 
+    // ask the UART / USB serial driver to hand over received bytes right away
+    // instead of batching them, not every driver supports it
+    struct serial_struct serinfo;
+    if (ioctl(serial_fd, TIOCGSERIAL, &serinfo) == 0) {
+        serinfo.flags |= ASYNC_LOW_LATENCY;
+        ioctl(serial_fd, TIOCSSERIAL, &serinfo);
+    }
+
 #endif
+    _rxWatermark = 0;
 
 
     tcflush(serial_fd, TCIFLUSH);
@@ -200,28 +211,30 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
 
     //Clear the DTR bit to let the motor spin
     clearDTR();
-    do {
-        // create self pipeline for wait cancellation
-        if (pipe(_selfpipe) == -1) break;
-
-        int flags = fcntl(_selfpipe[0], F_GETFL);
-        if (flags == -1)
-            break;
 
-        flags |= O_NONBLOCK;                /* Make read end nonblocking */
-        if (fcntl(_selfpipe[0], F_SETFL, flags) == -1)
-            break;
-
-        flags = fcntl(_selfpipe[1], F_GETFL);
-        if (flags == -1)
-            break;
+    // the port and the cancellation event are watched together, so a wait
+    // returns as soon as either of them fires
+    _epollfd = epoll_create1(EPOLL_CLOEXEC);
+    _cancelfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epollfd == -1 || _cancelfd == -1) {
+        close();
+        return false;
+    }
 
-        flags |= O_NONBLOCK;                /* Make write end nonblocking */
-        if (fcntl(_selfpipe[1], F_SETFL, flags) == -1)
-            break;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = serial_fd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, serial_fd, &ev) == -1) {
+        close();
+        return false;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = _cancelfd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _cancelfd, &ev) == -1) {
+        close();
+        return false;
+    }
 
-    } while (0);
-    
     return true;
 }
 
@@ -231,13 +244,13 @@ void raw_serial::close()
         ::close(serial_fd);
     serial_fd = -1;
     
-    if (_selfpipe[0] != -1)
-        ::close(_selfpipe[0]);
+    if (_epollfd != -1)
+        ::close(_epollfd);
 
-    if (_selfpipe[1] != -1)
-        ::close(_selfpipe[1]);
+    if (_cancelfd != -1)
+        ::close(_cancelfd);
 
-    _selfpipe[0] = _selfpipe[1] = -1;
+    _epollfd = _cancelfd = -1;
 
     _operation_aborted = false;
     _is_serial_opened = false;
@@ -273,6 +286,17 @@ int raw_serial::recvdata(unsigned char * data, size_t size)
     int ans = ::read(serial_fd, data, size);
     
     if (ans == -1) ans=0;
+
+    // with VMIN above the tty layer's read chunk, a non-blocking read stops
+    // after one chunk even if more is queued, so pick up the rest here
+    if (_rxWatermark > TTY_READ_CHUNK) {
+        int chunk = ans;
+        while (chunk == TTY_READ_CHUNK && (size_t)ans < size) {
+            chunk = ::read(serial_fd, data + ans, size - ans);
+            if (chunk <= 0) break;
+            ans += chunk;
+        }
+    }
     required_rx_cnt = ans;
     return ans;
 }
@@ -303,40 +327,36 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
     if (returned_size==NULL) returned_size=(size_t *)&length;
     *returned_size = 0;
 
-    int max_fd;
-    fd_set input_set;
-    struct timeval timeout_val;
-
-    /* Initialize the input set */
-    FD_ZERO(&input_set);
-    FD_SET(serial_fd, &input_set);
+    if ( !isOpened() ) return ANS_DEV_ERR;
 
-    if (_selfpipe[0] != -1)
-        FD_SET(_selfpipe[0], &input_set);
+    if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
+    if (*returned_size >= data_count)
+    {
+        return 0;
+    }
 
-    max_fd =  std::max<int>(serial_fd, _selfpipe[0]) + 1;
+    // let the tty layer report the port readable only once the whole request
+    // is queued, rather than waking us up for every few bytes
+    _setRxWatermark(data_count);
 
-    /* Initialize the timeout structure */
-    timeout_val.tv_sec = timeout / 1000;
-    timeout_val.tv_usec = (timeout % 1000) * 1000;
+    _u32 startTs = getms();
+    _u32 waitTime;
 
-    if ( isOpened() )
+    while ( isOpened() )
     {
-        if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
-        if (*returned_size >= data_count)
-        {
-            return 0;
+        if ((waitTime = getms() - startTs) > timeout) {
+            *returned_size = 0;
+            return ANS_TIMEOUT;
         }
-    }
 
-    while ( isOpened() )
-    {
-        /* Do the select */
-        int n = ::select(max_fd, &input_set, NULL, NULL, &timeout_val);
+        // an infinite timeout (-1) maps onto epoll's own
+        _u32 remainMs = timeout - waitTime;
+        struct epoll_event events[2];
+        int n = epoll_wait(_epollfd, events, 2, remainMs > 0x7FFFFFFF ? -1 : (int)remainMs);
 
         if (n < 0)
         {
-            // select error
+            if (errno == EINTR) continue;
             *returned_size =  0;
             return ANS_DEV_ERR;
         }
@@ -346,46 +366,62 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
             *returned_size =0;
             return ANS_TIMEOUT;
         }
-        else
-        {
-            if (FD_ISSET(_selfpipe[0], &input_set)) {   
+
+        for (int pos = 0; pos < n; ++pos) {
+            if (events[pos].data.fd == _cancelfd) {
                 // require aborting the current operation
-                int ch;
-                for (;;) {                    
-                    if (::read(_selfpipe[0], &ch, 1) == -1) {
-                        break;
-                    }
-                    
-                }
+                uint64_t signalled;
+                ::read(_cancelfd, &signalled, sizeof(signalled));
+                _operation_aborted = false;
 
                 // treat as  timeout
                 *returned_size = 0;
                 return ANS_TIMEOUT;
             }
-
-            // data avaliable
-            assert (FD_ISSET(serial_fd, &input_set));
-
-
-            if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
-            if (*returned_size >= data_count)
-            {
-                return 0;
-            }
-            else 
-            {
-                int remain_timeout = timeout_val.tv_sec*1000000 + timeout_val.tv_usec;
-                int expect_remain_time = (data_count - *returned_size)*1000000*8/_baudrate;
-                if (remain_timeout > expect_remain_time)
-                    usleep(expect_remain_time);
+            if (events[pos].events & (EPOLLHUP | EPOLLERR)) {
+                // the tty was hung up, e.g. the USB adapter was unplugged
+                *returned_size = 0;
+                return ANS_DEV_ERR;
             }
         }
-        
+
+        if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
+        if (*returned_size >= data_count)
+        {
+            return 0;
+        }
+
+        // the request exceeds the watermark, or the tty ignores it: wait for
+        // the missing bytes to arrive at 10 bits per byte before polling again
+        _u64 remain_timeout = (_u64)(timeout - (getms() - startTs)) * 1000;
+        _u64 expect_remain_time = (_u64)(data_count - *returned_size)*1000000*10/_baudrate;
+        usleep((useconds_t)std::min(remain_timeout, expect_remain_time));
     }
 
     return ANS_DEV_ERR;
 }
 
+void raw_serial::_setRxWatermark(size_t bytes)
+{
+    if (bytes > MAX_RX_WATERMARK) bytes = MAX_RX_WATERMARK;
+    if (bytes == _rxWatermark) return;
+
+    // VTIME stays 0, so VMIN alone decides when the port turns readable; reads
+    // are non-blocking and still return whatever is queued
+#if !defined(__GNUC__)
+    struct termios options;
+    if (tcgetattr(serial_fd, &options)) return;
+    options.c_cc[VMIN] = (cc_t)bytes;
+    if (tcsetattr(serial_fd, TCSANOW, &options)) return;
+#else
+    struct termios2 tio;
+    if (ioctl(serial_fd, TCGETS2, &tio) == -1) return;
+    tio.c_cc[VMIN] = (cc_t)bytes;
+    if (ioctl(serial_fd, TCSETS2, &tio) == -1) return;
+#endif
+    _rxWatermark = bytes;
+}
+
 size_t raw_serial::rxqueue_count()
 {
     if  ( !isOpened() ) return 0;
@@ -417,15 +453,32 @@ void raw_serial::_init()
     _portName[0] = 0;
     required_tx_cnt = required_rx_cnt = 0;
     _operation_aborted = false;
-    _selfpipe[0] = _selfpipe[1] = -1;
+    _epollfd = _cancelfd = -1;
+    _rxWatermark = 0;
 }
 
 void raw_serial::cancelOperation()
 {
+    // stays pending until a wait consumes it, even one that has not started yet
     _operation_aborted = true;
-    if (_selfpipe[1] == -1) return;
+    if (_cancelfd == -1) return;
 
-    ::write(_selfpipe[1], "x", 1);
+    uint64_t signal = 1;
+    ::write(_cancelfd, &signal, sizeof(signal));
+}
+
+void raw_serial::clearCancelOperation()
+{
+    if (!_operation_aborted.exchange(false) || _cancelfd == -1) return;
+
+    uint64_t signalled;
+    ::read(_cancelfd, &signalled, sizeof(signalled));
+}
+
+int raw_serial::getPollHandle()
+{
+    // readable once the VMIN watermark set by the last waitfordata is reached
+    return serial_fd;
 }
 
 _u32 raw_serial::getTermBaudBitmap(_u32 baud)
@@ -36,6 +36,8 @@
 
 #include "../../hal/abs_rxtx.h"
 
+#include <atomic>
+
 namespace rp{ namespace arch{ namespace net{
 
 class raw_serial : public rp::hal::serial_rxtx
@@ -46,6 +48,11 @@ public:
         SERIAL_TX_BUFFER_SIZE = 128,
     };
 
+    enum{
+        MAX_RX_WATERMARK = 255, // VMIN is a single cc_t
+        TTY_READ_CHUNK   = 64,  // bytes the tty core moves per line discipline read
+    };
+
     raw_serial();
     virtual ~raw_serial();
     virtual bool bind(const char * portname, uint32_t baudrate, uint32_t flags = 0);
@@ -69,10 +76,13 @@ public:
     _u32 getTermBaudBitmap(_u32 baud);
 
     virtual void cancelOperation();
+    virtual void clearCancelOperation();
+    virtual int  getPollHandle();
 
 protected:
     bool open(const char * portname, uint32_t baudrate, uint32_t flags = 0);
     void _init();
+    void _setRxWatermark(size_t bytes);
 
     char _portName[200];
     uint32_t _baudrate;
@@ -83,8 +93,10 @@ protected:
     size_t required_tx_cnt;
     size_t required_rx_cnt;
 
-    int    _selfpipe[2];
-    bool   _operation_aborted;
+    int    _epollfd;
+    int    _cancelfd;       // eventfd signalled by cancelOperation
+    size_t _rxWatermark;    // current VMIN of the port
+    std::atomic<bool> _operation_aborted;   // cancelOperation no wait has consumed yet
 };
 
 }}}
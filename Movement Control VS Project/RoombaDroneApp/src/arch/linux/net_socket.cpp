@@ -167,7 +167,7 @@ u_result SocketAddress::getAddressAsString(char * buffer, size_t buffersize) con
 
         break;
     }
-    return ans<=0?RESULT_OPERATION_FAIL:RESULT_OK;
+    return ans==NULL?RESULT_OPERATION_FAIL:RESULT_OK;
 }
 
 
@@ -591,6 +591,11 @@ public:
         }
     }
 
+    virtual int getPollHandle()
+    {
+        return _socket_fd;
+    }
+
 protected:
     int  _socket_fd;
 
@@ -604,10 +609,15 @@ public:
 
     DGramSocketImpl(int fd)
         : _socket_fd(fd)
+        , _dropCount(0)
     {
         assert(fd>=0);
         int bool_true = 1;
         ::setsockopt( _socket_fd, SOL_SOCKET, SO_REUSEADDR | SO_BROADCAST , (char *)&bool_true, sizeof(bool_true) );
+#ifdef SO_RXQ_OVFL
+        // have every received datagram report the drop counter of the socket
+        ::setsockopt( _socket_fd, SOL_SOCKET, SO_RXQ_OVFL, &bool_true, sizeof(bool_true) );
+#endif
         setTimeout(DEFAULT_SOCKET_TIMEOUT, SOCKET_DIR_BOTH);
     }
 
@@ -747,9 +757,22 @@ public:
     virtual u_result recvFrom(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr)
     {
         struct sockaddr * addr = (sourceAddr?reinterpret_cast<struct sockaddr *>(const_cast<void *>(sourceAddr->getPlatformData())):NULL);
-        size_t source_addr_size = (sourceAddr?sizeof(sockaddr_storage):0);
 
-        size_t ans = ::recvfrom( _socket_fd, buf, len, 0, addr, (socklen_t*)&source_addr_size);
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = len;
+
+        _u8 control[CMSG_SPACE(sizeof(_u32))];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = addr;
+        msg.msg_namelen = (sourceAddr?sizeof(sockaddr_storage):0);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        size_t ans = ::recvmsg( _socket_fd, &msg, 0);
         if (ans == (size_t)-1) {
             recv_len = 0;  
             switch (errno) {
@@ -762,11 +785,29 @@ public:
                     return RESULT_OPERATION_FAIL;
             }
 
-        } else {
-            recv_len = ans;
-            return RESULT_OK;
         }
 
+#ifdef SO_RXQ_OVFL
+        for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                memcpy(&_dropCount, CMSG_DATA(cmsg), sizeof(_dropCount));
+            }
+        }
+#endif
+
+        recv_len = ans;
+        return (msg.msg_flags & MSG_TRUNC)?RESULT_INVALID_DATA:RESULT_OK;
+    }
+
+    virtual u_result getDropCount(_u32 & dropCount)
+    {
+        dropCount = _dropCount;
+        return RESULT_OK;
+    }
+
+    virtual int getPollHandle()
+    {
+        return _socket_fd;
     }
 
 #if 0
@@ -797,6 +838,7 @@ public:
     
 protected:
     int  _socket_fd;
+    _u32 _dropCount;
 
 };
 
@@ -0,0 +1,153 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "arch_linux.h"
+#include "../../hal/types.h"
+#include "poller.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace rp{ namespace arch{
+
+epoll_poller::epoll_poller()
+    : _epollfd(-1)
+    , _cancelfd(-1)
+{
+    _epollfd = epoll_create1(EPOLL_CLOEXEC);
+    _cancelfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epollfd == -1 || _cancelfd == -1) return;
+
+    // the cancel descriptor has no data, which tells it apart from the handles
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _cancelfd, &ev) == -1) {
+        ::close(_cancelfd);
+        _cancelfd = -1;
+    }
+}
+
+epoll_poller::~epoll_poller()
+{
+    if (_epollfd != -1) ::close(_epollfd);
+    if (_cancelfd != -1) ::close(_cancelfd);
+}
+
+bool epoll_poller::add(int handle, void * data)
+{
+    return _control(EPOLL_CTL_ADD, handle, data);
+}
+
+bool epoll_poller::rearm(int handle, void * data)
+{
+    return _control(EPOLL_CTL_MOD, handle, data);
+}
+
+void epoll_poller::remove(int handle)
+{
+    if (_epollfd == -1 || handle < 0) return;
+
+    // kernels before 2.6.9 insist on an event even though it is ignored
+    struct epoll_event ev;
+    epoll_ctl(_epollfd, EPOLL_CTL_DEL, handle, &ev);
+}
+
+bool epoll_poller::_control(int op, int handle, void * data)
+{
+    if (_epollfd == -1 || handle < 0 || !data) return false;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = data;
+    return epoll_ctl(_epollfd, op, handle, &ev) == 0;
+}
+
+int epoll_poller::waitForEvents(void ** data, size_t maxCount, size_t & count, _u32 timeout)
+{
+    count = 0;
+    if (!isValid()) return EVENT_FAILED;
+
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    if (maxCount > MAX_EVENTS_PER_WAIT) maxCount = MAX_EVENTS_PER_WAIT;
+
+    int n = epoll_wait(_epollfd, events, (int)maxCount, timeout > 0x7FFFFFFF ? -1 : (int)timeout);
+    if (n < 0) {
+        return errno == EINTR ? EVENT_TIMEOUT : EVENT_FAILED;
+    }
+
+    bool cancelled = false;
+    for (int pos = 0; pos < n; ++pos) {
+        if (!events[pos].data.ptr) {
+            uint64_t signalled;
+            ::read(_cancelfd, &signalled, sizeof(signalled));
+            cancelled = true;
+            continue;
+        }
+        data[count++] = events[pos].data.ptr;
+    }
+
+    if (cancelled) return EVENT_CANCELLED;
+    return count ? EVENT_READY : EVENT_TIMEOUT;
+}
+
+void epoll_poller::cancel()
+{
+    if (_cancelfd == -1) return;
+
+    uint64_t signal = 1;
+    ::write(_cancelfd, &signal, sizeof(signal));
+}
+
+}} //end rp::arch
+
+//begin rp::hal
+namespace rp{ namespace hal{
+
+Poller * Poller::CreatePoller()
+{
+    rp::arch::epoll_poller * poller = new rp::arch::epoll_poller();
+    if (!poller->isValid()) {
+        delete poller;
+        return NULL;
+    }
+    return poller;
+}
+
+void Poller::ReleasePoller(Poller * poller)
+{
+    delete poller;
+}
+
+}} //end rp::hal
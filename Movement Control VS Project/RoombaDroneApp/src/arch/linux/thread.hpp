@@ -77,22 +77,18 @@ u_result Thread::setPriority( priority_val_t p)
     switch(p)
     {
     case PRIORITY_REALTIME:
-        //pthread_priority = pthread_priority_max;
-        current_policy = SCHED_RR;
-        break;
+        return setScheduling(SCHED_POLICY_RR, PRIORITY_LEVEL_MAX);
     case PRIORITY_HIGH:
-        //pthread_priority = (pthread_priority_max + pthread_priority_min)/2;
-        current_policy = SCHED_RR;
-        break;
+        return setScheduling(SCHED_POLICY_RR, (PRIORITY_LEVEL_MIN + PRIORITY_LEVEL_MAX) / 2);
     case PRIORITY_NORMAL:
     case PRIORITY_LOW:
     case PRIORITY_IDLE:
-        //pthread_priority = 0;
-        current_policy = SCHED_OTHER;
         break;
     }
 
-    current_param.__sched_priority = current_policy;
+    // the time shared policy has a single static priority
+    current_policy = SCHED_OTHER;
+    current_param.sched_priority = 0;
     if ( (ans = pthread_setschedparam( (pthread_t) this->_handle, current_policy, &current_param)) )
     {
         return RESULT_OPERATION_FAIL;
@@ -100,6 +96,83 @@ u_result Thread::setPriority( priority_val_t p)
     return  RESULT_OK;
 }
 
+u_result Thread::setScheduling(sched_policy_t policy, int priorityLevel)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+
+    int osPolicy;
+    switch (policy)
+    {
+    case SCHED_POLICY_FIFO:
+        osPolicy = SCHED_FIFO;
+        break;
+    case SCHED_POLICY_RR:
+        osPolicy = SCHED_RR;
+        break;
+    default:
+        osPolicy = SCHED_OTHER;
+        break;
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (osPolicy != SCHED_OTHER)
+    {
+        int minPriority = sched_get_priority_min(osPolicy);
+        int maxPriority = sched_get_priority_max(osPolicy);
+        if (minPriority == -1 || maxPriority == -1) return RESULT_OPERATION_NOT_SUPPORT;
+
+        if (priorityLevel < PRIORITY_LEVEL_MIN) priorityLevel = PRIORITY_LEVEL_MIN;
+        if (priorityLevel > PRIORITY_LEVEL_MAX) priorityLevel = PRIORITY_LEVEL_MAX;
+        param.sched_priority = minPriority + (maxPriority - minPriority) * (priorityLevel - PRIORITY_LEVEL_MIN) / (PRIORITY_LEVEL_MAX - PRIORITY_LEVEL_MIN);
+    }
+
+    if (pthread_setschedparam((pthread_t)this->_handle, osPolicy, &param))
+    {
+        // EPERM for real-time policies without the privilege
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+u_result Thread::setAffinity(_u64 cpuMask)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!cpuMask || (cpuMask & ((_u64)1 << cpu))) CPU_SET(cpu, &cpus);
+    }
+
+    if (pthread_setaffinity_np((pthread_t)this->_handle, sizeof(cpus), &cpus))
+    {
+        // EINVAL if none of the CPUs is online
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+u_result Thread::setName(const char * name)
+{
+    if (!this->_handle || !name) return RESULT_OPERATION_FAIL;
+
+    // the kernel keeps 15 characters and the terminating zero
+    char shortName[16];
+    strncpy(shortName, name, sizeof(shortName) - 1);
+    shortName[sizeof(shortName) - 1] = 0;
+
+    return pthread_setname_np((pthread_t)this->_handle, shortName) ? RESULT_OPERATION_FAIL : RESULT_OK;
+}
+
+Thread Thread::current()
+{
+    Thread self;
+    self._handle = (_word_size_t)pthread_self();
+    return self;
+}
+
 Thread::priority_val_t Thread::getPriority()
 {
     if (!this->_handle) return PRIORITY_NORMAL;
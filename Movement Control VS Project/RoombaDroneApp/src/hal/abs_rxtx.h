@@ -72,6 +72,11 @@ public:
     virtual void setDTR() = 0;
     virtual void clearDTR() = 0;
     virtual void cancelOperation() {}
+    // drops a cancelOperation no wait has consumed
+    virtual void clearCancelOperation() {}
+
+    // descriptor that turns readable with the data waitfordata waits for, -1 if there is none
+    virtual int getPollHandle() { return -1; }
 
     virtual bool isOpened()
     {
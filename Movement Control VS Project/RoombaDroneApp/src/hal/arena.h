@@ -0,0 +1,112 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+
+#include <new>
+
+namespace rp{ namespace hal{ 
+
+// Bump allocator carving fixed buffers out of a single heap block.
+//
+// The block is allocated once by reserve() and handed out piece by piece,
+// each piece starting on its own cache line. Pieces are never freed on their
+// own; they all live until the arena is destroyed.
+class Arena
+{
+public:
+    enum {
+        ALIGNMENT = 64,
+    };
+
+    Arena()
+        : _block(NULL)
+        , _size(0)
+        , _used(0)
+    {
+    }
+
+    ~Arena()
+    {
+        delete [] _block;
+    }
+
+    // returns false if the arena already holds a block or the allocation failed
+    bool reserve(size_t size)
+    {
+        if (_block) return false;
+
+        _block = new (std::nothrow) unsigned char[size + ALIGNMENT - 1];
+        if (!_block) return false;
+
+        _size = size;
+        _used = (ALIGNMENT - ((size_t)_block & (ALIGNMENT - 1))) & (ALIGNMENT - 1);
+        _size += _used;
+        return true;
+    }
+
+    // returns NULL when the reserved block is exhausted
+    template <typename T>
+    T * alloc(size_t count)
+    {
+        size_t bytes = footprint<T>(count);
+        if (!_block || bytes > _size - _used) return NULL;
+
+        T * piece = reinterpret_cast<T *>(_block + _used);
+        _used += bytes;
+        return piece;
+    }
+
+    bool isReserved() const
+    {
+        return _block != NULL;
+    }
+
+    // space needed for count elements of T, including the alignment padding
+    template <typename T>
+    static size_t footprint(size_t count)
+    {
+        return (count * sizeof(T) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    }
+
+protected:
+    unsigned char * _block;
+    size_t          _size;
+    size_t          _used;
+
+private:
+    Arena(const Arena &);
+    Arena & operator=(const Arena &);
+};
+
+}}
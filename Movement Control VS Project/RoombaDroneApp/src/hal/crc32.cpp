@@ -0,0 +1,343 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../sdkcommon.h"
+#include "crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_HAS_PCLMUL
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__linux__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FEATURE_CRC32)))
+#define CRC32_HAS_ARMV8
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#if defined(__aarch64__) && !defined(__ARM_FEATURE_CRC32)
+// build the ARMv8 path even if the toolchain targets the baseline ISA,
+// it is only called after checking the CPU capabilities at runtime
+#pragma GCC push_options
+#pragma GCC target("+crc")
+#define CRC32_ARMV8_PUSHED_OPTIONS
+#endif
+#include <arm_acle.h>
+#endif
+
+namespace rp{ namespace hal{ 
+
+typedef _u32 (*crc32_update_fn)(_u32 crc, const _u8 * data, size_t len);
+
+//------
+// lookup tables, generated at compile time
+// table[0] is the classic bytewise table, table[k] advances a byte by k more
+// zero bytes, as needed by slicing-by-8
+
+struct crc32_tables_t {
+    _u32 table[8][256];
+};
+
+static constexpr crc32_tables_t _crc32_make_tables()
+{
+    crc32_tables_t tables = {};
+
+    for (_u32 i = 0; i < 256; ++i) {
+        _u32 c = i;
+        for (int j = 0; j < 8; ++j) {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        tables.table[0][i] = c;
+    }
+
+    for (_u32 i = 0; i < 256; ++i) {
+        for (int k = 1; k < 8; ++k) {
+            _u32 prev = tables.table[k - 1][i];
+            tables.table[k][i] = (prev >> 8) ^ tables.table[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr crc32_tables_t CRC32_TABLES = _crc32_make_tables();
+
+static inline _u32 _load_le32(const _u8 * data)
+{
+    return (_u32)data[0] | ((_u32)data[1] << 8) | ((_u32)data[2] << 16) | ((_u32)data[3] << 24);
+}
+
+//------
+// software implementations
+
+static _u32 _crc32_update_bytewise(_u32 crc, const _u8 * data, size_t len)
+{
+    const _u32 * table = CRC32_TABLES.table[0];
+    while (len--) {
+        crc = (crc >> 8) ^ table[(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+static _u32 _crc32_update_slicing_by_8(_u32 crc, const _u8 * data, size_t len)
+{
+    const _u32 (* table)[256] = CRC32_TABLES.table;
+
+    while (len >= 8) {
+        _u32 one = _load_le32(data) ^ crc;
+        _u32 two = _load_le32(data + 4);
+        crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^ table[5][(one >> 16) & 0xFF] ^ table[4][one >> 24]
+            ^ table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^ table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+        data += 8;
+        len -= 8;
+    }
+    return _crc32_update_bytewise(crc, data, len);
+}
+
+//------
+// ARMv8 CRC32 instructions, same polynomial as above
+
+#ifdef CRC32_HAS_ARMV8
+static _u32 _crc32_update_armv8(_u32 crc, const _u8 * data, size_t len)
+{
+    while (len >= 8) {
+        crc = __crc32w(crc, _load_le32(data));
+        crc = __crc32w(crc, _load_le32(data + 4));
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32b(crc, *data++);
+    }
+    return crc;
+}
+
+static bool _crc32_armv8_supported()
+{
+#if defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return (getauxval(AT_HWCAP2) & HWCAP2_CRC32) != 0;
+#endif
+}
+#endif
+
+#ifdef CRC32_ARMV8_PUSHED_OPTIONS
+#pragma GCC pop_options
+#endif
+
+//------
+// x86 PCLMULQDQ folding, see Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction". The constants are the bit
+// reflected folding distances for the polynomial above.
+
+#ifdef CRC32_HAS_PCLMUL
+__attribute__((target("pclmul,sse4.1")))
+static _u32 _crc32_fold_pclmul(_u32 crc, const _u8 * data, size_t len)
+{
+    // len must be at least 64 and a multiple of 16
+    static const _u64 k1k2[] __attribute__((aligned(16))) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const _u64 k3k4[] __attribute__((aligned(16))) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const _u64 k5k0[] __attribute__((aligned(16))) = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const _u64 poly[] __attribute__((aligned(16))) = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    data += 64;
+    len -= 64;
+
+    // fold 4 x 128 bits in parallel
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(data + 0x30)));
+        data += 64;
+        len -= 64;
+    }
+
+    // fold into a single 128 bit value
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (_u32)_mm_extract_epi32(x1, 1);
+}
+
+static _u32 _crc32_update_pclmul(_u32 crc, const _u8 * data, size_t len)
+{
+    if (len >= 64) {
+        size_t folded = (len & ~(size_t)15);
+        crc = _crc32_fold_pclmul(crc, data, folded);
+        data += folded;
+        len -= folded;
+    }
+    return _crc32_update_slicing_by_8(crc, data, len);
+}
+
+static bool _crc32_pclmul_supported()
+{
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+//------
+
+static crc32_update_fn _crc32_get_update_fn(crc32_impl_t impl)
+{
+    switch (impl) {
+    case CRC32_IMPL_BYTEWISE:
+        return _crc32_update_bytewise;
+    case CRC32_IMPL_SLICING_BY_8:
+        return _crc32_update_slicing_by_8;
+#ifdef CRC32_HAS_ARMV8
+    case CRC32_IMPL_ARMV8:
+        return _crc32_armv8_supported() ? _crc32_update_armv8 : NULL;
+#endif
+#ifdef CRC32_HAS_PCLMUL
+    case CRC32_IMPL_PCLMUL:
+        return _crc32_pclmul_supported() ? _crc32_update_pclmul : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+bool crc32_is_supported(crc32_impl_t impl)
+{
+    return _crc32_get_update_fn(impl) != NULL;
+}
+
+crc32_impl_t crc32_selected_impl()
+{
+    // thread safe one-time selection, the CPU does not change under our feet
+    static const crc32_impl_t selected = []() {
+        if (crc32_is_supported(CRC32_IMPL_ARMV8)) return CRC32_IMPL_ARMV8;
+        if (crc32_is_supported(CRC32_IMPL_PCLMUL)) return CRC32_IMPL_PCLMUL;
+        return CRC32_IMPL_SLICING_BY_8;
+    }();
+    return selected;
+}
+
+const char * crc32_impl_name(crc32_impl_t impl)
+{
+    switch (impl) {
+    case CRC32_IMPL_BYTEWISE:
+        return "bytewise";
+    case CRC32_IMPL_SLICING_BY_8:
+        return "slicing-by-8";
+    case CRC32_IMPL_ARMV8:
+        return "armv8";
+    case CRC32_IMPL_PCLMUL:
+        return "pclmul";
+    default:
+        return "unknown";
+    }
+}
+
+static inline _u32 _crc32_padded(crc32_update_fn update, const void * data, size_t len)
+{
+    static const _u8 zeros[4] = { 0, 0, 0, 0 };
+
+    _u32 crc = update(0xFFFFFFFF, reinterpret_cast<const _u8 *>(data), len);
+    crc = update(crc, zeros, (4 - len) & 0x3); // zero padding
+    return crc ^ 0xFFFFFFFF;
+}
+
+_u32 crc32_padded(const void * data, size_t len)
+{
+    static const crc32_update_fn update = _crc32_get_update_fn(crc32_selected_impl());
+    return _crc32_padded(update, data, len);
+}
+
+_u32 crc32_padded(crc32_impl_t impl, const void * data, size_t len)
+{
+    crc32_update_fn update = _crc32_get_update_fn(impl);
+    if (!update) {
+        update = _crc32_update_slicing_by_8;
+    }
+    return _crc32_padded(update, data, len);
+}
+
+}}
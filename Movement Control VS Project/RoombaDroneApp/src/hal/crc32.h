@@ -0,0 +1,65 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp{ namespace hal{ 
+
+// CRC-32 (polynomial 0x04C11DB7, bit reflected, as used by zlib/Ethernet)
+// with the RPLIDAR convention of zero padding the message to a multiple of
+// 4 bytes before the final xor. This is the checksum carried by the HQ
+// capsules.
+//
+// Several implementations are built in; crc32_padded() uses the fastest one
+// supported by the CPU it runs on, the other overload allows to pick one
+// explicitly (e.g. for verification and benchmarking) and falls back to
+// slicing-by-8 if the CPU lacks the requested instructions.
+
+enum crc32_impl_t {
+    CRC32_IMPL_BYTEWISE = 0,    // one table lookup per byte
+    CRC32_IMPL_SLICING_BY_8,    // 8 table lookups per 8 bytes
+    CRC32_IMPL_ARMV8,           // ARMv8 CRC32 instructions
+    CRC32_IMPL_PCLMUL,          // x86 carry-less multiplication folding
+
+    CRC32_IMPL_COUNT,
+};
+
+bool            crc32_is_supported(crc32_impl_t impl);
+crc32_impl_t    crc32_selected_impl();
+const char *    crc32_impl_name(crc32_impl_t impl);
+
+_u32 crc32_padded(const void * data, size_t len);
+_u32 crc32_padded(crc32_impl_t impl, const void * data, size_t len);
+
+}}
@@ -0,0 +1,76 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include "types.h"
+
+namespace rp{ namespace hal{
+
+// Reports a device node, such as /dev/ttyUSB0, appearing and vanishing.
+//
+// Only the directory holding the node is watched, so the node itself does
+// not need to exist when watch() is called. A node counts as added once it
+// is created or its attributes change, the latter covering udev applying
+// the permissions after the kernel created it.
+class DeviceWatcher
+{
+public:
+    enum {
+        EVENT_FAILED       = -1,
+        EVENT_TIMEOUT      = 0,
+        EVENT_NODE_ADDED   = 1,
+        EVENT_NODE_REMOVED = 2,
+        EVENT_CANCELLED    = 3,
+    };
+
+    static DeviceWatcher * CreateWatcher();
+    static void ReleaseWatcher(DeviceWatcher *);
+
+    virtual ~DeviceWatcher() {}
+
+    virtual bool watch(const char * node_path) = 0;
+    virtual void unwatch() = 0;
+
+    // whether the node currently exists
+    virtual bool isPresent() = 0;
+
+    // wait for the next add or remove of the node, or for cancel()
+    virtual int waitForEvent(_u32 timeout) = 0;
+
+    // make the pending or the next waitForEvent return EVENT_CANCELLED
+    virtual void cancel() = 0;
+};
+
+}}
@@ -33,8 +33,17 @@
  */
 
 #pragma once
+
+#if defined(__linux__)
+#include <atomic>
+#endif
+
 namespace rp{ namespace hal{
 
+// On Linux the event is a futex word: set() and a wait() on a signalled event
+// stay in user space, the kernel is only entered to sleep or to wake a
+// sleeper, and deadlines are taken on CLOCK_MONOTONIC so a clock step does
+// not stretch or cut a timeout. Any number of threads may wait.
 class Event
 {
 public:
@@ -49,6 +58,10 @@ public:
     Event(bool isAutoReset = true, bool isSignal = false)
 #ifdef _WIN32
         : _event(NULL)
+#elif defined(__linux__)
+        : _state(isSignal ? 1 : 0)
+        , _waiters(0)
+        , _isAutoReset(isAutoReset)
 #else
         : _is_signalled(isSignal)
         , _isAutoReset(isAutoReset)
@@ -56,6 +69,8 @@ public:
     {
 #ifdef _WIN32
         _event = CreateEvent(NULL, isAutoReset?FALSE:TRUE, isSignal?TRUE:FALSE, NULL); 
+#elif defined(__linux__)
+        static_assert(sizeof(_state) == sizeof(int), "the futex word must be a plain int");
 #else
         pthread_mutex_init(&_cond_locker, NULL);
         pthread_cond_init(&_cond_var, NULL);
@@ -72,6 +87,12 @@ public:
         if (isSignal){
 #ifdef _WIN32
             SetEvent(_event);
+#elif defined(__linux__)
+            // the exchange and the waiter count are both sequentially consistent: either
+            // the waiter count is seen here or the futex wait sees the signalled word
+            if (_state.exchange(1) == 0 && _waiters.load() > 0) {
+                syscall(SYS_futex, (int *)&_state, FUTEX_WAKE_PRIVATE, _isAutoReset ? 1 : INT_MAX, NULL, NULL, 0);
+            }
 #else
             pthread_mutex_lock(&_cond_locker);
                
@@ -87,6 +108,8 @@ public:
         {
 #ifdef _WIN32
             ResetEvent(_event);
+#elif defined(__linux__)
+            _state.store(0);
 #else
             pthread_mutex_lock(&_cond_locker);
             _is_signalled = false;
@@ -108,6 +131,46 @@ public:
             return EVENT_TIMEOUT;
         }
         return EVENT_OK;
+#elif defined(__linux__)
+        if (_tryConsume()) return EVENT_OK;
+        if (timeout == 0) return EVENT_TIMEOUT;
+
+        timespec deadline;
+        if (timeout != 0xFFFFFFFF) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeout / 1000;
+            deadline.tv_nsec += (timeout % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000) {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+
+        for (;;) {
+            int err = 0;
+
+            ++_waiters;
+            // an absolute FUTEX_WAIT_BITSET deadline is measured on CLOCK_MONOTONIC
+            if (_state.load() == 0 && syscall(SYS_futex, (int *)&_state, FUTEX_WAIT_BITSET_PRIVATE, 0,
+                    (timeout == 0xFFFFFFFF) ? NULL : &deadline, NULL, FUTEX_BITSET_MATCH_ANY) == -1) {
+                err = errno;
+            }
+            --_waiters;
+
+            // another waiter of an auto reset event may have taken the signal, sleep again
+            if (_tryConsume()) return EVENT_OK;
+
+            switch (err) {
+            case 0:
+            case EAGAIN:
+            case EINTR:
+                break;
+            case ETIMEDOUT:
+                return EVENT_TIMEOUT;
+            default:
+                return EVENT_FAILED;
+            }
+        }
 #else
         unsigned long ans = EVENT_OK;
         pthread_mutex_lock( &_cond_locker );
@@ -164,10 +227,23 @@ _final:
     }
 protected:
 
+#if defined(__linux__)
+    bool _tryConsume()
+    {
+        if (!_isAutoReset) return _state.load() != 0;
+
+        int expected = 1;
+        return _state.compare_exchange_strong(expected, 0);
+    }
+
+#endif
+
     void release()
     {
 #ifdef _WIN32
         CloseHandle(_event);
+#elif defined(__linux__)
+        // nothing is held in the kernel while nobody waits
 #else
         pthread_mutex_destroy(&_cond_locker);
         pthread_cond_destroy(&_cond_var);
@@ -176,6 +252,10 @@ protected:
 
 #ifdef _WIN32
         HANDLE _event;
+#elif defined(__linux__)
+        std::atomic<int>       _state;      // the futex word, 1 while signalled
+        std::atomic<int>       _waiters;    // threads in or entering the futex wait
+        bool                   _isAutoReset;
 #else
         pthread_cond_t         _cond_var;
         pthread_mutex_t        _cond_locker;
@@ -0,0 +1,79 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include "types.h"
+
+namespace rp{ namespace hal{
+
+// Waits on the handles of several devices at once, so a single thread can
+// serve all of them.
+//
+// A handle is reported once when it turns readable or hangs up, and is not
+// reported again until it is rearmed. This lets the thread that handles the
+// data be a different one from the thread that waits, without the handle
+// firing again while its data is still being read.
+class Poller
+{
+public:
+    enum {
+        EVENT_FAILED    = -1,
+        EVENT_TIMEOUT   = 0,
+        EVENT_READY     = 1,
+        EVENT_CANCELLED = 2,
+    };
+
+    static Poller * CreatePoller();
+    static void ReleasePoller(Poller *);
+
+    virtual ~Poller() {}
+
+    // start watching handle, data is what waitForEvents hands back for it
+    virtual bool add(int handle, void * data) = 0;
+
+    // watch a handle that has been reported again
+    virtual bool rearm(int handle, void * data) = 0;
+
+    virtual void remove(int handle) = 0;
+
+    // wait until handles are ready and store the data of at most maxCount of
+    // them, a timeout of 0xFFFFFFFF waits without a limit
+    virtual int waitForEvents(void ** data, size_t maxCount, size_t & count, _u32 timeout) = 0;
+
+    // make the pending or the next waitForEvents return EVENT_CANCELLED
+    virtual void cancel() = 0;
+};
+
+}}
@@ -90,6 +90,9 @@ public:
 
     virtual u_result waitforSent(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT) = 0;
     virtual u_result waitforData(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT)  = 0;
+
+    // descriptor to wait on for readability together with other devices
+    virtual int getPollHandle() = 0;
 protected:
     SocketBase() {} 
 };
@@ -139,8 +142,13 @@ public:
     
     virtual u_result sendTo(const SocketAddress & target, const void * buffer, size_t len) = 0;
    
+    // a datagram larger than len is cut short and RESULT_INVALID_DATA is returned
     virtual u_result recvFrom(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr = NULL) = 0;
 
+    // datagrams dropped by the OS because the receive queue was full, counted
+    // since the socket was created and updated by recvFrom
+    virtual u_result getDropCount(_u32 & dropCount) = 0;
+
     
 protected:
     virtual ~DGramSocket() {} // use dispose();
@@ -0,0 +1,143 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace rp{ namespace hal{ 
+
+// Lock-free ring buffer between exactly one producer thread and exactly one
+// consumer thread.
+//
+// Elements are copied in and out in bulk. When the ring is full the producer
+// does not wait: the elements that do not fit are dropped and counted, and the
+// consumer can collect the count with takeDropped().
+//
+// The ring does not own its storage; attach() hands it a buffer whose
+// capacity is a power of 2 before either side touches the ring.
+template <typename T>
+class SpscRing
+{
+public:
+    SpscRing()
+        : _head(0)
+        , _tail(0)
+        , _dropped(0)
+        , _buffer(NULL)
+        , _capacity(0)
+    {
+    }
+
+    void attach(T * storage, size_t capacity)
+    {
+        assert((capacity & (capacity - 1)) == 0);
+        _buffer = storage;
+        _capacity = capacity;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+    }
+
+    // producer side, returns the number of elements actually stored
+    size_t push(const T * items, size_t count)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t room = _capacity - (tail - _head.load(std::memory_order_acquire));
+
+        if (count > room) {
+            _dropped.fetch_add(count - room, std::memory_order_relaxed);
+            count = room;
+        }
+        if (!count) return 0;
+
+        size_t pos = (tail & (_capacity - 1));
+        size_t first = _capacity - pos;
+        if (first > count) first = count;
+        memcpy(_buffer + pos, items, first * sizeof(T));
+        memcpy(_buffer, items + first, (count - first) * sizeof(T));
+
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // consumer side, returns the number of elements copied to dest
+    size_t pop(T * dest, size_t maxCount)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t count = _tail.load(std::memory_order_acquire) - head;
+        if (count > maxCount) count = maxCount;
+        if (!count) return 0;
+
+        size_t pos = (head & (_capacity - 1));
+        size_t first = _capacity - pos;
+        if (first > count) first = count;
+        memcpy(dest, _buffer + pos, first * sizeof(T));
+        memcpy(dest + first, _buffer, (count - first) * sizeof(T));
+
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    // number of elements dropped since the previous call
+    size_t takeDropped()
+    {
+        return _dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+protected:
+    enum {
+        CACHE_LINE_SIZE = 64,
+    };
+
+    // keep the consumer and producer indices on separate cache lines. The ring
+    // may start anywhere in a line, so a whole line of padding goes around each
+    // of them rather than aligning them, which would over-align the owner
+    char                    _headPadBefore[CACHE_LINE_SIZE];
+    std::atomic<size_t>     _head;
+    char                    _headPad[CACHE_LINE_SIZE];
+    std::atomic<size_t>     _tail;
+    std::atomic<size_t>     _dropped;
+    char                    _tailPad[CACHE_LINE_SIZE];
+    T *                     _buffer;
+    size_t                  _capacity;
+};
+
+}}
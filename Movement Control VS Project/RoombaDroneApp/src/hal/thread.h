@@ -52,6 +52,19 @@ public:
 		PRIORITY_IDLE     = 4,
 	};
 
+    enum sched_policy_t
+    {
+        SCHED_POLICY_DEFAULT = 0,   // time shared, SCHED_OTHER
+        SCHED_POLICY_FIFO    = 1,   // real-time, runs until it blocks or a higher priority preempts it
+        SCHED_POLICY_RR      = 2,   // real-time, round robin among threads of the same priority
+    };
+
+    enum
+    {
+        PRIORITY_LEVEL_MIN = 0,
+        PRIORITY_LEVEL_MAX = 100,
+    };
+
     template <class T, u_result (T::*PROC)(void)>
     static Thread create_member(T * pthis)
     {
@@ -75,6 +88,20 @@ public:
 	u_result setPriority( priority_val_t p);
 	priority_val_t getPriority();
 
+    // priorityLevel only matters to the real-time policies, it is spread from
+    // PRIORITY_LEVEL_MIN to PRIORITY_LEVEL_MAX over the priority range the OS
+    // gives the policy. Real-time policies usually need CAP_SYS_NICE or root.
+    u_result setScheduling(sched_policy_t policy, int priorityLevel = PRIORITY_LEVEL_MIN);
+
+    // bit n of cpuMask allows CPU n, 0 allows all of them
+    u_result setAffinity(_u64 cpuMask);
+
+    // name shown by top -H and ps -L, cut to 15 characters
+    u_result setName(const char * name);
+
+    // the calling thread, it must not be joined
+    static Thread current();
+
     bool operator== ( const Thread & right) { return this->_handle == right._handle; }
 protected:
     Thread( thread_proc_t proc, void * data ): _data(data),_func(proc), _handle(0)  {}
@@ -0,0 +1,104 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace rp{ namespace hal{ 
+
+// Wait-free triple buffer for handing the latest value from exactly one
+// producer thread to exactly one consumer thread.
+//
+// The producer always owns the back buffer and the consumer the front one.
+// Publishing swaps the back buffer with the shared middle one; fetching swaps
+// the middle one with the front buffer if it carries unseen data. Neither side
+// ever waits for the other, a slow consumer simply skips the stale values.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+        : _back(0)
+        , _middle(1)
+        , _front(2)
+    {
+    }
+
+    // producer side
+    T & back()
+    {
+        return _buffers[_back];
+    }
+
+    void publish()
+    {
+        _back = _middle.exchange(_back | DIRTY_FLAG, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // consumer side, returns false if nothing was published since the last fetch
+    bool fetch()
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & DIRTY_FLAG)) {
+            return false;
+        }
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T & front() const
+    {
+        return _buffers[_front];
+    }
+
+    // direct access to all three buffers, only for setting them up while
+    // neither the producer nor the consumer is running
+    T & buffer(size_t index)
+    {
+        return _buffers[index];
+    }
+
+protected:
+    enum {
+        INDEX_MASK = 0x3,
+        DIRTY_FLAG = 0x4,
+    };
+
+    T                       _buffers[3];
+    unsigned int            _back;
+    std::atomic<unsigned int> _middle;
+    unsigned int            _front;
+};
+
+}}
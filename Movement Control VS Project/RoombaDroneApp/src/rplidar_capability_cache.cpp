@@ -0,0 +1,303 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdkcommon.h"
+#include "rplidar_capability_cache.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// storage file layout, in host byte order:
+//   magic, device info, flags, motor ctrl support, sample rate, entry count,
+//   then per entry: type, reserve size (_u8), reserve, answer size (_u16), answer
+static const char   _storageMagic[8] = { 'R', 'P', 'C', 'A', 'P', 'S', '0', '1' };
+
+enum {
+    STORAGE_FLAG_MOTOR_CTRL  = 0x1,
+    STORAGE_FLAG_SAMPLE_RATE = 0x2,
+};
+
+static bool _sameDevice(const rplidar_response_device_info_t & a, const rplidar_response_device_info_t & b)
+{
+    return a.model == b.model && a.firmware_version == b.firmware_version
+        && a.hardware_version == b.hardware_version
+        && !memcmp(a.serialnum, b.serialnum, sizeof(a.serialnum));
+}
+
+template <typename T>
+static bool _readValue(FILE * file, T & value)
+{
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+template <typename T>
+static bool _writeValue(FILE * file, const T & value)
+{
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool _readBytes(FILE * file, std::vector<_u8> & bytes, size_t size)
+{
+    bytes.resize(size);
+    return !size || fread(&bytes[0], size, 1, file) == 1;
+}
+
+static bool _writeBytes(FILE * file, const std::vector<_u8> & bytes)
+{
+    return bytes.empty() || fwrite(&bytes[0], bytes.size(), 1, file) == 1;
+}
+
+CapabilityCache::CapabilityCache()
+{
+    _reset();
+}
+
+void CapabilityCache::setStorageDir(const char * path)
+{
+    _storageDir = path ? path : "";
+}
+
+void CapabilityCache::unconfirm()
+{
+    _isConfirmed = false;
+}
+
+void CapabilityCache::clear()
+{
+    std::string path = _storagePath();
+    if (!path.empty()) {
+        remove(path.c_str());
+    }
+    _reset();
+}
+
+void CapabilityCache::_reset()
+{
+    _isConfirmed = false;
+    _hasDeviceInfo = false;
+    _hasMotorCtrlSupport = false;
+    _motorCtrlSupport = false;
+    _hasSampleRate = false;
+    _confs.clear();
+}
+
+bool CapabilityCache::getDeviceInfo(rplidar_response_device_info_t & info) const
+{
+    if (!_isConfirmed) return false;
+    info = _deviceInfo;
+    return true;
+}
+
+void CapabilityCache::setDeviceInfo(const rplidar_response_device_info_t & info)
+{
+    if (!_hasDeviceInfo || !_sameDevice(_deviceInfo, info)) {
+        _reset();
+        _deviceInfo = info;
+        _hasDeviceInfo = true;
+        _load(info);
+    }
+    _isConfirmed = true;
+}
+
+bool CapabilityCache::getMotorCtrlSupport(bool & support) const
+{
+    if (!_isConfirmed || !_hasMotorCtrlSupport) return false;
+    support = _motorCtrlSupport;
+    return true;
+}
+
+void CapabilityCache::setMotorCtrlSupport(bool support)
+{
+    if (!_isConfirmed) return;
+    _motorCtrlSupport = support;
+    _hasMotorCtrlSupport = true;
+    _save();
+}
+
+bool CapabilityCache::getSampleRate(rplidar_response_sample_rate_t & rate) const
+{
+    if (!_isConfirmed || !_hasSampleRate) return false;
+    rate = _sampleRate;
+    return true;
+}
+
+void CapabilityCache::setSampleRate(const rplidar_response_sample_rate_t & rate)
+{
+    if (!_isConfirmed) return;
+    _sampleRate = rate;
+    _hasSampleRate = true;
+    _save();
+}
+
+bool CapabilityCache::getLidarConf(_u32 type, const std::vector<_u8> & reserve, std::vector<_u8> & answer) const
+{
+    if (!_isConfirmed) return false;
+    for (size_t pos = 0; pos < _confs.size(); ++pos) {
+        if (_confs[pos].type == type && _confs[pos].reserve == reserve) {
+            answer = _confs[pos].answer;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CapabilityCache::setLidarConf(_u32 type, const std::vector<_u8> & reserve, const std::vector<_u8> & answer)
+{
+    if (!_isConfirmed || !isStaticConf(type) || reserve.size() > 0xFF || answer.size() > 0xFFFF) return;
+
+    std::vector<_u8> existing;
+    if (getLidarConf(type, reserve, existing)) return;
+
+    conf_entry_t entry;
+    entry.type = type;
+    entry.reserve = reserve;
+    entry.answer = answer;
+    _confs.push_back(entry);
+    _save();
+}
+
+bool CapabilityCache::isStaticConf(_u32 type)
+{
+    switch (type) {
+    case RPLIDAR_CONF_ANGLE_RANGE:
+    case RPLIDAR_CONF_SCAN_COMMAND_BITMAP:
+    case RPLIDAR_CONF_MIN_ROT_FREQ:
+    case RPLIDAR_CONF_MAX_ROT_FREQ:
+    case RPLIDAR_CONF_MAX_DISTANCE:
+    case RPLIDAR_CONF_SCAN_MODE_COUNT:
+    case RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE:
+    case RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE:
+    case RPLIDAR_CONF_SCAN_MODE_ANS_TYPE:
+    case RPLIDAR_CONF_SCAN_MODE_TYPICAL:
+    case RPLIDAR_CONF_SCAN_MODE_NAME:
+        return true;
+    }
+    return false;
+}
+
+std::string CapabilityCache::_storagePath() const
+{
+    if (_storageDir.empty() || !_hasDeviceInfo) return std::string();
+
+    static const char hexDigits[] = "0123456789ABCDEF";
+    std::string path = _storageDir;
+    if (path[path.size() - 1] != '/') path += '/';
+    path += "rplidar_";
+    for (size_t pos = 0; pos < sizeof(_deviceInfo.serialnum); ++pos) {
+        path += hexDigits[_deviceInfo.serialnum[pos] >> 4];
+        path += hexDigits[_deviceInfo.serialnum[pos] & 0xF];
+    }
+    path += ".cap";
+    return path;
+}
+
+bool CapabilityCache::_load(const rplidar_response_device_info_t & info)
+{
+    std::string path = _storagePath();
+    if (path.empty()) return false;
+
+    FILE * file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    char magic[sizeof(_storageMagic)];
+    rplidar_response_device_info_t storedInfo;
+    _u8 flags, motorCtrlSupport;
+    rplidar_response_sample_rate_t sampleRate;
+    _u32 entryCount;
+
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && !memcmp(magic, _storageMagic, sizeof(magic))
+        && _readValue(file, storedInfo) && _sameDevice(storedInfo, info)
+        && _readValue(file, flags) && _readValue(file, motorCtrlSupport)
+        && _readValue(file, sampleRate) && _readValue(file, entryCount);
+
+    // a firmware update changes the firmware version, which turns the stored
+    // entries down along with corrupted files
+    std::vector<conf_entry_t> confs;
+    for (_u32 pos = 0; ok && pos < entryCount; ++pos) {
+        conf_entry_t entry;
+        _u8 reserveSize;
+        _u16 answerSize;
+        ok = _readValue(file, entry.type) && isStaticConf(entry.type)
+            && _readValue(file, reserveSize) && _readBytes(file, entry.reserve, reserveSize)
+            && _readValue(file, answerSize) && _readBytes(file, entry.answer, answerSize);
+        if (ok) confs.push_back(entry);
+    }
+    fclose(file);
+
+    if (!ok) return false;
+
+    _hasMotorCtrlSupport = (flags & STORAGE_FLAG_MOTOR_CTRL) != 0;
+    _motorCtrlSupport = motorCtrlSupport != 0;
+    _hasSampleRate = (flags & STORAGE_FLAG_SAMPLE_RATE) != 0;
+    _sampleRate = sampleRate;
+    _confs.swap(confs);
+    return true;
+}
+
+void CapabilityCache::_save() const
+{
+    std::string path = _storagePath();
+    if (path.empty()) return;
+
+    // write a temporary file and move it over the old one, so a crash never
+    // leaves a truncated file behind
+    std::string tempPath = path + ".tmp";
+    FILE * file = fopen(tempPath.c_str(), "wb");
+    if (!file) return;
+
+    _u8 flags = (_hasMotorCtrlSupport ? STORAGE_FLAG_MOTOR_CTRL : 0) | (_hasSampleRate ? STORAGE_FLAG_SAMPLE_RATE : 0);
+    _u8 motorCtrlSupport = _motorCtrlSupport ? 1 : 0;
+    rplidar_response_sample_rate_t sampleRate;
+    if (_hasSampleRate) {
+        sampleRate = _sampleRate;
+    } else {
+        memset(&sampleRate, 0, sizeof(sampleRate));
+    }
+    _u32 entryCount = (_u32)_confs.size();
+
+    bool ok = fwrite(_storageMagic, sizeof(_storageMagic), 1, file) == 1
+        && _writeValue(file, _deviceInfo) && _writeValue(file, flags) && _writeValue(file, motorCtrlSupport)
+        && _writeValue(file, sampleRate) && _writeValue(file, entryCount);
+
+    for (size_t pos = 0; ok && pos < _confs.size(); ++pos) {
+        const conf_entry_t & entry = _confs[pos];
+        ok = _writeValue(file, entry.type)
+            && _writeValue(file, (_u8)entry.reserve.size()) && _writeBytes(file, entry.reserve)
+            && _writeValue(file, (_u16)entry.answer.size()) && _writeBytes(file, entry.answer);
+    }
+
+    if (fclose(file) || !ok || rename(tempPath.c_str(), path.c_str())) {
+        remove(tempPath.c_str());
+    }
+}
+
+}}}
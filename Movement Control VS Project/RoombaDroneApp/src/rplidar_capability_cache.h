@@ -0,0 +1,105 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Answers of the device queries that never change for a given device and
+// firmware: device info, the accessory board flag, the legacy sample rates
+// and the static configuration entries such as the scan mode table.
+//
+// Nothing is served before setDeviceInfo() has confirmed which device is on
+// the line. When the confirmed device differs from the one the entries were
+// collected from, they are dropped. With a storage directory set, the
+// entries of each device are also kept in a file named after its serial
+// number, so they survive restarts.
+class CapabilityCache
+{
+public:
+    CapabilityCache();
+
+    void setStorageDir(const char * path);
+
+    // forget which device is on the line, e.g. after the link was reopened;
+    // the entries are kept until setDeviceInfo() tells whether they still apply
+    void unconfirm();
+
+    // drop all entries, including the stored ones of the current device
+    void clear();
+
+    bool getDeviceInfo(rplidar_response_device_info_t & info) const;
+    void setDeviceInfo(const rplidar_response_device_info_t & info);
+
+    bool getMotorCtrlSupport(bool & support) const;
+    void setMotorCtrlSupport(bool support);
+
+    bool getSampleRate(rplidar_response_sample_rate_t & rate) const;
+    void setSampleRate(const rplidar_response_sample_rate_t & rate);
+
+    bool getLidarConf(_u32 type, const std::vector<_u8> & reserve, std::vector<_u8> & answer) const;
+    void setLidarConf(_u32 type, const std::vector<_u8> & reserve, const std::vector<_u8> & answer);
+
+    // whether a configuration entry is fixed by the firmware
+    static bool isStaticConf(_u32 type);
+
+protected:
+    struct conf_entry_t {
+        _u32                type;
+        std::vector<_u8>    reserve;
+        std::vector<_u8>    answer;
+    };
+
+    void _reset();
+    std::string _storagePath() const;
+    bool _load(const rplidar_response_device_info_t & info);
+    void _save() const;
+
+    std::string         _storageDir;
+
+    bool                _isConfirmed;
+    bool                _hasDeviceInfo;
+    rplidar_response_device_info_t _deviceInfo;
+
+    bool                _hasMotorCtrlSupport;
+    bool                _motorCtrlSupport;
+    bool                _hasSampleRate;
+    rplidar_response_sample_rate_t _sampleRate;
+
+    std::vector<conf_entry_t> _confs;
+};
+
+}}}
@@ -0,0 +1,756 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_capsule_decoder.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAPSULE_DECODER_HAS_X86
+#include <immintrin.h>
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CAPSULE_DECODER_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// floor(n / 90) == (n * DIV90_MAGIC) >> 32 for every n < 2^23, which covers
+// (angle_q6 << 8) for all angles below 360 degrees
+static const _u32 DIV90_MAGIC = 47721859;
+
+static const int ANGLE_RANGE_Q6 = (360 << 6);
+static const int ANGLE_RANGE_Q16 = (360 << 16);
+
+static const _u8 NODE_QUALITY = (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT);
+
+// samples unpacked from a capsule, one entry per node, ready for the SIMD kernels
+struct capsule_lanes_t {
+    int     offset_q16[CapsuleDecoder::DENSE_CAPSULE_NODES];
+    _u32    dist_q2[CapsuleDecoder::DENSE_CAPSULE_NODES];
+};
+
+static inline bool _isStartAngleInRange(_u16 start_angle_sync_q6)
+{
+    return (start_angle_sync_q6 & 0x7FFF) < ANGLE_RANGE_Q6;
+}
+
+static inline int _capsuleAngleDiff_q8(_u16 start_angle_sync_q6, _u16 next_start_angle_sync_q6)
+{
+    int currentStartAngle_q8 = ((next_start_angle_sync_q6 & 0x7FFF) << 2);
+    int prevStartAngle_q8 = ((start_angle_sync_q6 & 0x7FFF) << 2);
+
+    int diffAngle_q8 = (currentStartAngle_q8) - (prevStartAngle_q8);
+    if (prevStartAngle_q8 >  currentStartAngle_q8) {
+        diffAngle_q8 += (360<<8);
+    }
+    return diffAngle_q8;
+}
+
+//------
+// scalar reference
+
+static size_t _decodeCapsuleScalar(const rplidar_response_capsule_measurement_nodes_t & capsule, const rplidar_response_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    size_t nodeCount = 0;
+    int diffAngle_q8 = _capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6);
+
+    int angleInc_q16 = (diffAngle_q8 << 3);
+    int currentAngle_raw_q16 = (((capsule.start_angle_sync_q6 & 0x7FFF) << 2) << 8);
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos)
+    {
+        int dist_q2[2];
+        int angle_q6[2];
+        int syncBit[2];
+
+        dist_q2[0] = (capsule.cabins[pos].distance_angle_1 & 0xFFFC);
+        dist_q2[1] = (capsule.cabins[pos].distance_angle_2 & 0xFFFC);
+
+        int angle_offset1_q3 = ( (capsule.cabins[pos].offset_angles_q3 & 0xF) | ((capsule.cabins[pos].distance_angle_1 & 0x3)<<4));
+        int angle_offset2_q3 = ( (capsule.cabins[pos].offset_angles_q3 >> 4) | ((capsule.cabins[pos].distance_angle_2 & 0x3)<<4));
+
+        angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3<<13))>>10);
+        syncBit[0] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
+        currentAngle_raw_q16 += angleInc_q16;
+
+
+        angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3<<13))>>10);
+        syncBit[1] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
+        currentAngle_raw_q16 += angleInc_q16;
+
+        for (int cpos = 0; cpos < 2; ++cpos) {
+
+            if (angle_q6[cpos] < 0) angle_q6[cpos] += (360<<6);
+            if (angle_q6[cpos] >= (360<<6)) angle_q6[cpos] -= (360<<6);
+
+            rplidar_response_measurement_node_hq_t node;
+
+            node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
+            node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
+            node.quality = dist_q2[cpos] ? NODE_QUALITY : 0;
+            node.dist_mm_q2 = dist_q2[cpos];
+
+            nodebuffer[nodeCount++] = node;
+         }
+    }
+    return nodeCount;
+}
+
+static size_t _decodeDenseCapsuleScalar(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, const rplidar_response_dense_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    size_t nodeCount = 0;
+    int diffAngle_q8 = _capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6);
+
+    int angleInc_q16 = (diffAngle_q8 << 8)/40;
+    int currentAngle_raw_q16 = (((capsule.start_angle_sync_q6 & 0x7FFF) << 2) << 8);
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos)
+    {
+        int dist_q2;
+        int angle_q6;
+        int syncBit;
+        const int dist = static_cast<const int>(capsule.cabins[pos].distance);
+        dist_q2 = dist << 2;
+        angle_q6 = (currentAngle_raw_q16 >> 10);
+        syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+        currentAngle_raw_q16 += angleInc_q16;
+
+        if (angle_q6 < 0) angle_q6 += (360 << 6);
+        if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
+
+        rplidar_response_measurement_node_hq_t node;
+
+        node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
+        node.flag = (syncBit | ((!syncBit) << 1));
+        node.quality = dist_q2 ? NODE_QUALITY : 0;
+        node.dist_mm_q2 = dist_q2;
+
+        nodebuffer[nodeCount++] = node;
+    }
+    return nodeCount;
+}
+
+//------
+// SIMD kernels
+//
+// Each lane handles one node: lane i starts at angle_q16 + i * angleInc_q16.
+// Given in-range start angles, the raw angles stay below 2 * (360 << 16), so
+// the modulo of the sync bit test becomes a single conditional subtraction,
+// and the normalized angle_q6 stays below 2^15, so the division by 90 can be
+// done with DIV90_MAGIC.
+//
+// A node is assembled as two 32 bit words:
+//   lo = angle_z_q14 | dist_mm_q2[15:0] << 16
+//   hi = dist_mm_q2[31:16] | quality << 16 | flag << 24
+
+#ifdef CAPSULE_DECODER_HAS_X86
+SSE41_TARGET static inline __m128i _div90_sse41(__m128i n)
+{
+    const __m128i magic = _mm_set1_epi32(DIV90_MAGIC);
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(n, magic), 32);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(n, 32), magic);
+    return _mm_blend_epi16(even, odd, 0xCC);
+}
+
+SSE41_TARGET static void _decodeLanesSSE41(const capsule_lanes_t & lanes, int angle_q16, int angleInc_q16, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i range_q6 = _mm_set1_epi32(ANGLE_RANGE_Q6);
+    const __m128i range_q16 = _mm_set1_epi32(ANGLE_RANGE_Q16);
+    const __m128i inc = _mm_set1_epi32(angleInc_q16);
+    const __m128i quality = _mm_set1_epi32(NODE_QUALITY);
+    const __m128i flag_nosync = _mm_set1_epi32(2);
+
+    __m128i angle = _mm_add_epi32(_mm_set1_epi32(angle_q16), _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), inc));
+    const __m128i inc4 = _mm_slli_epi32(inc, 2);
+
+    for (size_t pos = 0; pos < count; pos += 4) {
+        __m128i offset = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes.offset_q16 + pos));
+        __m128i dist = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes.dist_q2 + pos));
+
+        __m128i angle_q6 = _mm_srai_epi32(_mm_sub_epi32(angle, offset), 10);
+        angle_q6 = _mm_add_epi32(angle_q6, _mm_and_si128(_mm_cmplt_epi32(angle_q6, zero), range_q6));
+        angle_q6 = _mm_sub_epi32(angle_q6, _mm_andnot_si128(_mm_cmplt_epi32(angle_q6, range_q6), range_q6));
+
+        __m128i next = _mm_add_epi32(angle, inc);
+        next = _mm_sub_epi32(next, _mm_andnot_si128(_mm_cmplt_epi32(next, range_q16), range_q16));
+        __m128i sync = _mm_cmplt_epi32(next, inc);
+
+        __m128i angle_z_q14 = _div90_sse41(_mm_slli_epi32(angle_q6, 8));
+        __m128i flag = _mm_add_epi32(flag_nosync, sync);
+        __m128i q = _mm_andnot_si128(_mm_cmpeq_epi32(dist, zero), quality);
+
+        __m128i lo = _mm_or_si128(angle_z_q14, _mm_slli_epi32(dist, 16));
+        __m128i hi = _mm_or_si128(_mm_srli_epi32(dist, 16), _mm_or_si128(_mm_slli_epi32(q, 16), _mm_slli_epi32(flag, 24)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(nodebuffer + pos), _mm_unpacklo_epi32(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(nodebuffer + pos + 2), _mm_unpackhi_epi32(lo, hi));
+
+        angle = _mm_add_epi32(angle, inc4);
+    }
+}
+
+AVX2_TARGET static inline __m256i _div90_avx2(__m256i n)
+{
+    const __m256i magic = _mm256_set1_epi32(DIV90_MAGIC);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, magic), 32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(n, 32), magic);
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+AVX2_TARGET static void _decodeLanesAVX2(const capsule_lanes_t & lanes, int angle_q16, int angleInc_q16, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i range_q6 = _mm256_set1_epi32(ANGLE_RANGE_Q6);
+    const __m256i range_q16 = _mm256_set1_epi32(ANGLE_RANGE_Q16);
+    const __m256i inc = _mm256_set1_epi32(angleInc_q16);
+    const __m256i quality = _mm256_set1_epi32(NODE_QUALITY);
+    const __m256i flag_nosync = _mm256_set1_epi32(2);
+
+    __m256i angle = _mm256_add_epi32(_mm256_set1_epi32(angle_q16), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), inc));
+    const __m256i inc8 = _mm256_slli_epi32(inc, 3);
+
+    for (size_t pos = 0; pos < count; pos += 8) {
+        __m256i offset = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes.offset_q16 + pos));
+        __m256i dist = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes.dist_q2 + pos));
+
+        __m256i angle_q6 = _mm256_srai_epi32(_mm256_sub_epi32(angle, offset), 10);
+        angle_q6 = _mm256_add_epi32(angle_q6, _mm256_and_si256(_mm256_cmpgt_epi32(zero, angle_q6), range_q6));
+        angle_q6 = _mm256_sub_epi32(angle_q6, _mm256_andnot_si256(_mm256_cmpgt_epi32(range_q6, angle_q6), range_q6));
+
+        __m256i next = _mm256_add_epi32(angle, inc);
+        next = _mm256_sub_epi32(next, _mm256_andnot_si256(_mm256_cmpgt_epi32(range_q16, next), range_q16));
+        __m256i sync = _mm256_cmpgt_epi32(inc, next);
+
+        __m256i angle_z_q14 = _div90_avx2(_mm256_slli_epi32(angle_q6, 8));
+        __m256i flag = _mm256_add_epi32(flag_nosync, sync);
+        __m256i q = _mm256_andnot_si256(_mm256_cmpeq_epi32(dist, zero), quality);
+
+        __m256i lo = _mm256_or_si256(angle_z_q14, _mm256_slli_epi32(dist, 16));
+        __m256i hi = _mm256_or_si256(_mm256_srli_epi32(dist, 16), _mm256_or_si256(_mm256_slli_epi32(q, 16), _mm256_slli_epi32(flag, 24)));
+
+        // unpack works per 128 bit half: nodes 0,1,4,5 and 2,3,6,7
+        __m256i nodes0 = _mm256_unpacklo_epi32(lo, hi);
+        __m256i nodes1 = _mm256_unpackhi_epi32(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(nodebuffer + pos), _mm256_permute2x128_si256(nodes0, nodes1, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(nodebuffer + pos + 4), _mm256_permute2x128_si256(nodes0, nodes1, 0x31));
+
+        angle = _mm256_add_epi32(angle, inc8);
+    }
+}
+#endif
+
+#ifdef CAPSULE_DECODER_HAS_NEON
+static inline uint32x4_t _div90_neon(uint32x4_t n)
+{
+    const uint32x2_t magic = vdup_n_u32(DIV90_MAGIC);
+    uint64x2_t lo = vmull_u32(vget_low_u32(n), magic);
+    uint64x2_t hi = vmull_u32(vget_high_u32(n), magic);
+    return vcombine_u32(vshrn_n_u64(lo, 32), vshrn_n_u64(hi, 32));
+}
+
+static void _decodeLanesNEON(const capsule_lanes_t & lanes, int angle_q16, int angleInc_q16, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    static const int32_t LANE_INDEX[4] = { 0, 1, 2, 3 };
+
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t range_q6 = vdupq_n_s32(ANGLE_RANGE_Q6);
+    const int32x4_t range_q16 = vdupq_n_s32(ANGLE_RANGE_Q16);
+    const int32x4_t inc = vdupq_n_s32(angleInc_q16);
+    const uint32x4_t quality = vdupq_n_u32(NODE_QUALITY);
+    const uint32x4_t flag_nosync = vdupq_n_u32(2);
+
+    int32x4_t angle = vmlaq_s32(vdupq_n_s32(angle_q16), vld1q_s32(LANE_INDEX), inc);
+    const int32x4_t inc4 = vshlq_n_s32(inc, 2);
+
+    for (size_t pos = 0; pos < count; pos += 4) {
+        int32x4_t offset = vld1q_s32(lanes.offset_q16 + pos);
+        uint32x4_t dist = vld1q_u32(lanes.dist_q2 + pos);
+
+        int32x4_t angle_q6 = vshrq_n_s32(vsubq_s32(angle, offset), 10);
+        angle_q6 = vaddq_s32(angle_q6, vandq_s32(vreinterpretq_s32_u32(vcltq_s32(angle_q6, zero)), range_q6));
+        angle_q6 = vsubq_s32(angle_q6, vandq_s32(vreinterpretq_s32_u32(vcgeq_s32(angle_q6, range_q6)), range_q6));
+
+        int32x4_t next = vaddq_s32(angle, inc);
+        next = vsubq_s32(next, vandq_s32(vreinterpretq_s32_u32(vcgeq_s32(next, range_q16)), range_q16));
+        uint32x4_t sync = vcltq_s32(next, inc);
+
+        uint32x4_t angle_z_q14 = _div90_neon(vreinterpretq_u32_s32(vshlq_n_s32(angle_q6, 8)));
+        uint32x4_t flag = vaddq_u32(flag_nosync, sync);
+        uint32x4_t q = vbicq_u32(quality, vceqq_u32(dist, vdupq_n_u32(0)));
+
+        // vst2 interleaves the two words of each node
+        uint32x4x2_t nodes;
+        nodes.val[0] = vorrq_u32(angle_z_q14, vshlq_n_u32(dist, 16));
+        nodes.val[1] = vorrq_u32(vshrq_n_u32(dist, 16), vorrq_u32(vshlq_n_u32(q, 16), vshlq_n_u32(flag, 24)));
+        vst2q_u32(reinterpret_cast<uint32_t *>(nodebuffer + pos), nodes);
+
+        angle = vaddq_s32(angle, inc4);
+    }
+}
+#endif
+
+typedef void (*lanes_decoder_fn)(const capsule_lanes_t & lanes, int angle_q16, int angleInc_q16, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+static lanes_decoder_fn _getLanesDecoder(CapsuleDecoder::Impl impl)
+{
+    switch (impl) {
+#ifdef CAPSULE_DECODER_HAS_X86
+    case CapsuleDecoder::IMPL_SSE41:
+        return __builtin_cpu_supports("sse4.1") ? _decodeLanesSSE41 : NULL;
+    case CapsuleDecoder::IMPL_AVX2:
+        return __builtin_cpu_supports("avx2") ? _decodeLanesAVX2 : NULL;
+#endif
+#ifdef CAPSULE_DECODER_HAS_NEON
+    case CapsuleDecoder::IMPL_NEON:
+        return _decodeLanesNEON;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+//------
+
+bool CapsuleDecoder::isSupported(Impl impl)
+{
+    return (impl == IMPL_SCALAR) || (_getLanesDecoder(impl) != NULL);
+}
+
+CapsuleDecoder::Impl CapsuleDecoder::selectedImpl()
+{
+    static const Impl selected = []() {
+        if (isSupported(IMPL_AVX2)) return IMPL_AVX2;
+        if (isSupported(IMPL_SSE41)) return IMPL_SSE41;
+        if (isSupported(IMPL_NEON)) return IMPL_NEON;
+        return IMPL_SCALAR;
+    }();
+    return selected;
+}
+
+const char * CapsuleDecoder::implName(Impl impl)
+{
+    switch (impl) {
+    case IMPL_SCALAR:
+        return "scalar";
+    case IMPL_SSE41:
+        return "sse4.1";
+    case IMPL_AVX2:
+        return "avx2";
+    case IMPL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+size_t CapsuleDecoder::decodeCapsule(const rplidar_response_capsule_measurement_nodes_t & capsule, const rplidar_response_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    return decodeCapsule(selectedImpl(), capsule, next, nodebuffer);
+}
+
+size_t CapsuleDecoder::decodeCapsule(Impl impl, const rplidar_response_capsule_measurement_nodes_t & capsule, const rplidar_response_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    lanes_decoder_fn decoder = _getLanesDecoder(impl);
+    if (!decoder || !_isStartAngleInRange(capsule.start_angle_sync_q6) || !_isStartAngleInRange(next.start_angle_sync_q6)) {
+        return _decodeCapsuleScalar(capsule, next, nodebuffer);
+    }
+
+    capsule_lanes_t lanes;
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos)
+    {
+        const rplidar_response_cabin_nodes_t & cabin = capsule.cabins[pos];
+        lanes.dist_q2[2 * pos] = (cabin.distance_angle_1 & 0xFFFC);
+        lanes.dist_q2[2 * pos + 1] = (cabin.distance_angle_2 & 0xFFFC);
+        lanes.offset_q16[2 * pos] = ((cabin.offset_angles_q3 & 0xF) | ((cabin.distance_angle_1 & 0x3) << 4)) << 13;
+        lanes.offset_q16[2 * pos + 1] = ((cabin.offset_angles_q3 >> 4) | ((cabin.distance_angle_2 & 0x3) << 4)) << 13;
+    }
+
+    int angleInc_q16 = (_capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6) << 3);
+    decoder(lanes, ((capsule.start_angle_sync_q6 & 0x7FFF) << 10), angleInc_q16, CAPSULE_NODES, nodebuffer);
+    return CAPSULE_NODES;
+}
+
+size_t CapsuleDecoder::decodeDenseCapsule(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, const rplidar_response_dense_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    return decodeDenseCapsule(selectedImpl(), capsule, next, nodebuffer);
+}
+
+size_t CapsuleDecoder::decodeDenseCapsule(Impl impl, const rplidar_response_dense_capsule_measurement_nodes_t & capsule, const rplidar_response_dense_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    lanes_decoder_fn decoder = _getLanesDecoder(impl);
+    if (!decoder || !_isStartAngleInRange(capsule.start_angle_sync_q6) || !_isStartAngleInRange(next.start_angle_sync_q6)) {
+        return _decodeDenseCapsuleScalar(capsule, next, nodebuffer);
+    }
+
+    capsule_lanes_t lanes;
+    for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos)
+    {
+        lanes.dist_q2[pos] = (capsule.cabins[pos].distance << 2);
+        lanes.offset_q16[pos] = 0;
+    }
+
+    int angleInc_q16 = (_capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6) << 8) / 40;
+    decoder(lanes, ((capsule.start_angle_sync_q6 & 0x7FFF) << 10), angleInc_q16, DENSE_CAPSULE_NODES, nodebuffer);
+    return DENSE_CAPSULE_NODES;
+}
+
+size_t CapsuleDecoder::decodeCapsules(const rplidar_response_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    Impl impl = selectedImpl();
+    size_t nodeCount = 0;
+    for (size_t pos = 0; pos + 1 < capsuleCount; ++pos) {
+        nodeCount += decodeCapsule(impl, capsules[pos], capsules[pos + 1], nodebuffer + nodeCount);
+    }
+    return nodeCount;
+}
+
+size_t CapsuleDecoder::decodeDenseCapsules(const rplidar_response_dense_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    Impl impl = selectedImpl();
+    size_t nodeCount = 0;
+    for (size_t pos = 0; pos + 1 < capsuleCount; ++pos) {
+        nodeCount += decodeDenseCapsule(impl, capsules[pos], capsules[pos + 1], nodebuffer + nodeCount);
+    }
+    return nodeCount;
+}
+
+//------
+// ultra capsules
+
+static _u32 _varbitscale_decode(_u32 scaled, _u32 & scaleLevel)
+{
+    static const _u32 VBS_SCALED_BASE[] = {
+        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+        0,
+    };
+
+    static const _u32 VBS_SCALED_LVL[] = {
+        4,
+        3,
+        2,
+        1,
+        0,
+    };
+
+    static const _u32 VBS_TARGET_BASE[] = {
+        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+        0,
+    };
+
+    for (size_t i = 0; i < _countof(VBS_SCALED_BASE); ++i)
+    {
+        int remain = ((int)scaled - (int)VBS_SCALED_BASE[i]);
+        if (remain >= 0) {
+            scaleLevel = VBS_SCALED_LVL[i];
+            return VBS_TARGET_BASE[i] + (remain << scaleLevel);
+        }
+    }
+    return 0;
+}
+
+size_t CapsuleDecoder::decodeUltraCapsuleReference(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, const rplidar_response_ultra_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    size_t nodeCount = 0;
+    int diffAngle_q8 = _capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6);
+
+    int angleInc_q16 = (diffAngle_q8 << 3) / 3;
+    int currentAngle_raw_q16 = (((capsule.start_angle_sync_q6 & 0x7FFF) << 2) << 8);
+    for (size_t pos = 0; pos < _countof(capsule.ultra_cabins); ++pos)
+    {
+        int dist_q2[3];
+        int angle_q6[3];
+        int syncBit[3];
+
+
+        _u32 combined_x3 = capsule.ultra_cabins[pos].combined_x3;
+
+        // unpack ...
+        int dist_major = (combined_x3 & 0xFFF);
+
+        // signed partical integer, using the magic shift here
+        // DO NOT TOUCH
+
+        int dist_predict1 = (((int)(combined_x3 << 10)) >> 22);
+        int dist_predict2 = (((int)combined_x3) >> 22);
+
+        int dist_major2;
+
+        _u32 scalelvl1 = 0, scalelvl2 = 0;
+
+        // prefetch next ...
+        if (pos == _countof(capsule.ultra_cabins) - 1)
+        {
+            dist_major2 = (next.ultra_cabins[0].combined_x3 & 0xFFF);
+        }
+        else {
+            dist_major2 = (capsule.ultra_cabins[pos + 1].combined_x3 & 0xFFF);
+        }
+
+        // decode with the var bit scale ...
+        dist_major = _varbitscale_decode(dist_major, scalelvl1);
+        dist_major2 = _varbitscale_decode(dist_major2, scalelvl2);
+
+
+        int dist_base1 = dist_major;
+        int dist_base2 = dist_major2;
+
+        if ((!dist_major) && dist_major2) {
+            dist_base1 = dist_major2;
+            scalelvl1 = scalelvl2;
+        }
+
+       
+        dist_q2[0] = (dist_major << 2);
+        if ((dist_predict1 == 0xFFFFFE00) || (dist_predict1 == 0x1FF)) {
+            dist_q2[1] = 0;
+        } else {
+            dist_predict1 = (dist_predict1 << scalelvl1);
+            dist_q2[1] = (dist_predict1 + dist_base1) << 2;
+
+        }
+
+        if ((dist_predict2 == 0xFFFFFE00) || (dist_predict2 == 0x1FF)) {
+            dist_q2[2] = 0;
+        } else {
+            dist_predict2 = (dist_predict2 << scalelvl2);
+            dist_q2[2] = (dist_predict2 + dist_base2) << 2;
+        }
+       
+
+        for (int cpos = 0; cpos < 3; ++cpos)
+        {
+
+            syncBit[cpos] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+
+            int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
+
+            if (dist_q2[cpos] >= (50 * 4))
+            {
+                const int k1 = 98361;
+                const int k2 = int(k1 / dist_q2[cpos]);
+
+                offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+            }
+
+            angle_q6[cpos] = ((currentAngle_raw_q16 - int(offsetAngleMean_q16 * 180 / 3.14159265)) >> 10);
+            currentAngle_raw_q16 += angleInc_q16;
+
+            if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
+            if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
+
+            rplidar_response_measurement_node_hq_t node;
+
+            node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
+            node.quality = dist_q2[cpos] ? NODE_QUALITY : 0;
+            node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
+            node.dist_mm_q2 = dist_q2[cpos];
+
+            nodebuffer[nodeCount++] = node;
+        }
+
+    }
+    return nodeCount;
+}
+
+// Lookup tables for the fixed-point ultra capsule decoder.
+//
+// The angle correction of a sample only depends on k2 = 98361 / dist_q2,
+// which is at most 491 for the distances it applies to (dist_q2 >= 200), so
+// the whole floating point expression is evaluated once per k2 value, using
+// the very same expressions as the reference decoder.
+//
+// k2 itself comes from a direct table for short distances. Beyond that k2
+// changes slowly: the table holds the value at the start of each bucket, and
+// at most two correction steps bring it down to the exact quotient.
+//
+// The var bit scale boundaries are all multiples of 256, so the top 4 bits of
+// the 12 bit scaled distance select the scale level directly.
+struct ultra_decoder_tables_t {
+    enum {
+        K1 = 98361,
+        MIN_DIST_Q2 = (50 * 4),
+        MAX_K2 = K1 / MIN_DIST_Q2,
+        NEAR_DIST_Q2 = 4096,
+        FAR_BUCKET_SHIFT = 8,
+        FAR_BUCKETS = (K1 >> FAR_BUCKET_SHIFT) + 1,
+    };
+
+    struct varbitscale_entry_t {
+        _u32 scaledBase;
+        _u32 targetBase;
+        _u32 scaleLevel;
+    };
+
+    int                 angleOffsetDefault;
+    int                 angleOffset[MAX_K2 + 1];
+    _u16                k2Near[NEAR_DIST_Q2];
+    _u16                k2Far[FAR_BUCKETS];
+    varbitscale_entry_t varbitscale[16];
+
+    ultra_decoder_tables_t()
+    {
+        int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
+        angleOffsetDefault = int(offsetAngleMean_q16 * 180 / 3.14159265);
+
+        for (int k2 = 0; k2 <= MAX_K2; ++k2) {
+            offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+            angleOffset[k2] = int(offsetAngleMean_q16 * 180 / 3.14159265);
+        }
+
+        for (int dist_q2 = 0; dist_q2 < NEAR_DIST_Q2; ++dist_q2) {
+            k2Near[dist_q2] = (dist_q2 >= MIN_DIST_Q2) ? _u16(K1 / dist_q2) : 0;
+        }
+
+        for (int bucket = 0; bucket < FAR_BUCKETS; ++bucket) {
+            int dist_q2 = (bucket << FAR_BUCKET_SHIFT);
+            k2Far[bucket] = (dist_q2 >= NEAR_DIST_Q2) ? _u16(K1 / dist_q2) : 0;
+        }
+
+        for (_u32 pos = 0; pos < _countof(varbitscale); ++pos) {
+            varbitscale[pos].scaledBase = (pos << 8);
+            varbitscale[pos].targetBase = _varbitscale_decode(varbitscale[pos].scaledBase, varbitscale[pos].scaleLevel);
+        }
+    }
+
+    int angleOffset_q16(int dist_q2) const
+    {
+        if (dist_q2 < MIN_DIST_Q2) {
+            return angleOffsetDefault;
+        }
+        if (dist_q2 < NEAR_DIST_Q2) {
+            return angleOffset[k2Near[dist_q2]];
+        }
+        if (dist_q2 > K1) {
+            return angleOffset[0];
+        }
+
+        int k2 = k2Far[dist_q2 >> FAR_BUCKET_SHIFT];
+        while (k2 * dist_q2 > K1) {
+            --k2;
+        }
+        return angleOffset[k2];
+    }
+
+    _u32 varbitscaleDecode(_u32 scaled, _u32 & scaleLevel) const
+    {
+        const varbitscale_entry_t & entry = varbitscale[scaled >> 8];
+        scaleLevel = entry.scaleLevel;
+        return entry.targetBase + ((scaled - entry.scaledBase) << entry.scaleLevel);
+    }
+};
+
+static const ultra_decoder_tables_t & _ultraDecoderTables()
+{
+    static const ultra_decoder_tables_t tables;
+    return tables;
+}
+
+size_t CapsuleDecoder::decodeUltraCapsule(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, const rplidar_response_ultra_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const ultra_decoder_tables_t & tables = _ultraDecoderTables();
+
+    size_t nodeCount = 0;
+    int diffAngle_q8 = _capsuleAngleDiff_q8(capsule.start_angle_sync_q6, next.start_angle_sync_q6);
+
+    int angleInc_q16 = (diffAngle_q8 << 3) / 3;
+    int currentAngle_raw_q16 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 10);
+
+    _u32 scalelvl2;
+    int dist_major2 = tables.varbitscaleDecode(capsule.ultra_cabins[0].combined_x3 & 0xFFF, scalelvl2);
+
+    for (size_t pos = 0; pos < _countof(capsule.ultra_cabins); ++pos)
+    {
+        _u32 combined_x3 = capsule.ultra_cabins[pos].combined_x3;
+
+        // the major distance of this cabin was decoded as the look-ahead of the previous one
+        int dist_major = dist_major2;
+        _u32 scalelvl1 = scalelvl2;
+
+        const rplidar_response_ultra_cabin_nodes_t & nextCabin = (pos == _countof(capsule.ultra_cabins) - 1) ? next.ultra_cabins[0] : capsule.ultra_cabins[pos + 1];
+        dist_major2 = tables.varbitscaleDecode(nextCabin.combined_x3 & 0xFFF, scalelvl2);
+
+        // signed 10 bit predictions
+        int dist_predict1 = (((int)(combined_x3 << 10)) >> 22);
+        int dist_predict2 = (((int)combined_x3) >> 22);
+
+        int dist_base1 = dist_major;
+        if ((!dist_major) && dist_major2) {
+            dist_base1 = dist_major2;
+            scalelvl1 = scalelvl2;
+        }
+
+        int dist_q2[3];
+        dist_q2[0] = (dist_major << 2);
+        dist_q2[1] = ((dist_predict1 == -512) || (dist_predict1 == 0x1FF)) ? 0 : (((dist_predict1 << scalelvl1) + dist_base1) << 2);
+        dist_q2[2] = ((dist_predict2 == -512) || (dist_predict2 == 0x1FF)) ? 0 : (((dist_predict2 << scalelvl2) + dist_major2) << 2);
+
+        for (int cpos = 0; cpos < 3; ++cpos)
+        {
+            int syncBit = (((currentAngle_raw_q16 + angleInc_q16) % ANGLE_RANGE_Q16) < angleInc_q16) ? 1 : 0;
+
+            int angle_q6 = ((currentAngle_raw_q16 - tables.angleOffset_q16(dist_q2[cpos])) >> 10);
+            currentAngle_raw_q16 += angleInc_q16;
+
+            if (angle_q6 < 0) angle_q6 += ANGLE_RANGE_Q6;
+            if (angle_q6 >= ANGLE_RANGE_Q6) angle_q6 -= ANGLE_RANGE_Q6;
+
+            rplidar_response_measurement_node_hq_t & node = nodebuffer[nodeCount++];
+            node.flag = (syncBit | ((!syncBit) << 1));
+            node.quality = dist_q2[cpos] ? NODE_QUALITY : 0;
+            node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
+            node.dist_mm_q2 = dist_q2[cpos];
+        }
+    }
+    return nodeCount;
+}
+
+size_t CapsuleDecoder::decodeUltraCapsules(const rplidar_response_ultra_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    size_t nodeCount = 0;
+    for (size_t pos = 0; pos + 1 < capsuleCount; ++pos) {
+        nodeCount += decodeUltraCapsule(capsules[pos], capsules[pos + 1], nodebuffer + nodeCount);
+    }
+    return nodeCount;
+}
+
+}}}
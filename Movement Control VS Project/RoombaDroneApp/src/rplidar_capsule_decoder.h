@@ -0,0 +1,90 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Batch decoders turning measurement capsules into HQ nodes.
+//
+// A capsule only carries its own start angle, the angle of each of its
+// samples is interpolated up to the start angle of the capsule following it.
+// All decoders therefore take the capsule to decode together with the next
+// one, and write the decoded nodes directly into the caller's buffer.
+//
+// The scalar implementation is the reference the SIMD ones are checked
+// against, all implementations produce identical output. The SIMD paths only
+// handle capsules with in-range start angles and defer to the scalar code
+// for anything else.
+class CapsuleDecoder
+{
+public:
+    enum {
+        CAPSULE_NODES = 32,         // nodes per express capsule
+        DENSE_CAPSULE_NODES = 40,   // nodes per dense capsule
+        ULTRA_CAPSULE_NODES = 96,   // nodes per ultra capsule
+    };
+
+    enum Impl {
+        IMPL_SCALAR = 0,
+        IMPL_SSE41,
+        IMPL_AVX2,
+        IMPL_NEON,
+
+        IMPL_COUNT,
+    };
+
+    static bool         isSupported(Impl impl);
+    static Impl         selectedImpl();
+    static const char * implName(Impl impl);
+
+    // decode one capsule, returns the number of nodes written
+    static size_t decodeCapsule(const rplidar_response_capsule_measurement_nodes_t & capsule, const rplidar_response_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+    static size_t decodeCapsule(Impl impl, const rplidar_response_capsule_measurement_nodes_t & capsule, const rplidar_response_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+    static size_t decodeDenseCapsule(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, const rplidar_response_dense_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+    static size_t decodeDenseCapsule(Impl impl, const rplidar_response_dense_capsule_measurement_nodes_t & capsule, const rplidar_response_dense_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+    // fixed-point, table driven decoder for ultra capsules, bit exact with the
+    // floating point reference below
+    static size_t decodeUltraCapsule(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, const rplidar_response_ultra_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+    static size_t decodeUltraCapsuleReference(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, const rplidar_response_ultra_capsule_measurement_nodes_t & next, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+    // decode a run of consecutive capsules, every capsule but the last one is decoded
+    static size_t decodeCapsules(const rplidar_response_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer);
+    static size_t decodeDenseCapsules(const rplidar_response_dense_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer);
+    static size_t decodeUltraCapsules(const rplidar_response_ultra_capsule_measurement_nodes_t * capsules, size_t capsuleCount, rplidar_response_measurement_node_hq_t * nodebuffer);
+};
+
+}}}
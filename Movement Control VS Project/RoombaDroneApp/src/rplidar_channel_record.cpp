@@ -0,0 +1,406 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "rplidar_channel_record.h"
+
+#include <string.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// record file layout, in host byte order:
+//   magic, then per record: host time (_u64, us), direction (_u8), size (_u32), bytes
+static const char   _recordMagic[8] = { 'R', 'P', 'R', 'E', 'C', 'D', '0', '1' };
+
+enum {
+    RECORD_DIR_RX = 0,
+    RECORD_DIR_TX = 1,
+};
+
+// Recording
+
+RecordingChannelDevice::RecordingChannelDevice(ChannelDevice * channel, FILE * file)
+    : _channel(channel)
+    , _file(file)
+{
+}
+
+RecordingChannelDevice::~RecordingChannelDevice()
+{
+    if (_file) fclose(_file);
+}
+
+FILE * RecordingChannelDevice::CreateRecordFile(const char * path)
+{
+    if (!path) return NULL;
+
+    FILE * file = fopen(path, "wb");
+    if (!file) return NULL;
+
+    if (fwrite(_recordMagic, sizeof(_recordMagic), 1, file) != 1) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+void RecordingChannelDevice::_writeRecord(_u8 direction, const _u8 * data, size_t size)
+{
+    _u64 timestamp_us = rp::arch::rp_getus();
+    _u32 recordSize = (_u32)size;
+
+    rp::hal::AutoLocker l(_fileLock);
+    fwrite(&timestamp_us, sizeof(timestamp_us), 1, _file);
+    fwrite(&direction, sizeof(direction), 1, _file);
+    fwrite(&recordSize, sizeof(recordSize), 1, _file);
+    fwrite(data, 1, size, _file);
+}
+
+bool RecordingChannelDevice::bind(const char * path, uint32_t param)
+{
+    return _channel->bind(path, param);
+}
+
+bool RecordingChannelDevice::open()
+{
+    return _channel->open();
+}
+
+void RecordingChannelDevice::close()
+{
+    _channel->close();
+
+    rp::hal::AutoLocker l(_fileLock);
+    fflush(_file);
+}
+
+void RecordingChannelDevice::flush()
+{
+    _channel->flush();
+}
+
+bool RecordingChannelDevice::waitfordata(size_t data_count, _u32 timeout, size_t * returned_size)
+{
+    return _channel->waitfordata(data_count, timeout, returned_size);
+}
+
+bool RecordingChannelDevice::isDeviceLost()
+{
+    return _channel->isDeviceLost();
+}
+
+void RecordingChannelDevice::cancelWait()
+{
+    _channel->cancelWait();
+}
+
+void RecordingChannelDevice::clearCancelWait()
+{
+    _channel->clearCancelWait();
+}
+
+size_t RecordingChannelDevice::getLostDatagramCount()
+{
+    return _channel->getLostDatagramCount();
+}
+
+int RecordingChannelDevice::getPollHandle()
+{
+    return _channel->getPollHandle();
+}
+
+int RecordingChannelDevice::senddata(const _u8 * data, size_t size)
+{
+    _writeRecord(RECORD_DIR_TX, data, size);
+    return _channel->senddata(data, size);
+}
+
+int RecordingChannelDevice::recvdata(unsigned char * data, size_t size)
+{
+    int received = _channel->recvdata(data, size);
+    if (received > 0) {
+        _writeRecord(RECORD_DIR_RX, data, received);
+    }
+    return received;
+}
+
+void RecordingChannelDevice::setDTR()
+{
+    _channel->setDTR();
+}
+
+void RecordingChannelDevice::clearDTR()
+{
+    _channel->clearDTR();
+}
+
+void RecordingChannelDevice::ReleaseRxTx()
+{
+    _channel->ReleaseRxTx();
+}
+
+// Replay
+
+ReplayChannelDevice::ReplayChannelDevice()
+    : _lastRx(0)
+    , _pace(REPLAY_PACE_ORIGINAL)
+    , _recordPos(0)
+    , _recordOffset(0)
+    , _anchorRecord_us(0)
+    , _anchorHost_us(0)
+    , _isOpened(false)
+    , _isCancelled(false)
+    , _wakeEvt(true, false)
+{
+}
+
+bool ReplayChannelDevice::_load(const char * path)
+{
+    _records.clear();
+    _data.clear();
+    _lastRx = 0;
+
+    FILE * file = fopen(path, "rb");
+    if (!file) return false;
+
+    char magic[sizeof(_recordMagic)];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, _recordMagic, sizeof(magic))) {
+        fclose(file);
+        return false;
+    }
+
+    // a recording cut short by a crash ends with a partial record, which is left out
+    while (true) {
+        record_t record;
+        _u32 size;
+        if (fread(&record.timestamp_us, sizeof(record.timestamp_us), 1, file) != 1
+            || fread(&record.direction, sizeof(record.direction), 1, file) != 1
+            || fread(&size, sizeof(size), 1, file) != 1) {
+            break;
+        }
+
+        record.offset = _data.size();
+        record.size = size;
+        _data.resize(record.offset + size);
+        if (size && fread(&_data[record.offset], size, 1, file) != 1) {
+            _data.resize(record.offset);
+            break;
+        }
+
+        _records.push_back(record);
+        if (record.direction == RECORD_DIR_RX) _lastRx = _records.size();
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool ReplayChannelDevice::bind(const char * path, uint32_t pace)
+{
+    rp::hal::AutoLocker l(_lock);
+    if (!path || !_load(path)) return false;
+
+    _pace = pace;
+    return true;
+}
+
+bool ReplayChannelDevice::open()
+{
+    rp::hal::AutoLocker l(_lock);
+    _recordPos = 0;
+    _recordOffset = 0;
+    _anchorRecord_us = _records.empty() ? 0 : _records[0].timestamp_us;
+    _anchorHost_us = rp::arch::rp_getus();
+    _isOpened = true;
+    return true;
+}
+
+void ReplayChannelDevice::close()
+{
+    rp::hal::AutoLocker l(_lock);
+    _isOpened = false;
+}
+
+bool ReplayChannelDevice::_isDrained() const
+{
+    return _recordPos >= _lastRx;
+}
+
+// bytes readable now from the read position, stopping once wanted are
+// counted; nextDue_us is when the following chunk becomes readable, or 0
+// when it is waiting for a command instead
+size_t ReplayChannelDevice::_readable(size_t wanted, _u64 & nextDue_us) const
+{
+    _u64 now_us = rp::arch::rp_getus();
+    size_t readable = 0;
+    size_t offset = _recordOffset;
+
+    nextDue_us = 0;
+    for (size_t pos = _recordPos; pos < _lastRx && readable < wanted; ++pos, offset = 0) {
+        const record_t & record = _records[pos];
+        if (record.direction != RECORD_DIR_RX) break;
+
+        if (_pace && record.timestamp_us > _anchorRecord_us) {
+            _u64 due_us = _anchorHost_us + (record.timestamp_us - _anchorRecord_us) * REPLAY_PACE_ORIGINAL / _pace;
+            if (due_us > now_us) {
+                nextDue_us = due_us;
+                break;
+            }
+        }
+        readable += record.size - offset;
+    }
+    return readable;
+}
+
+bool ReplayChannelDevice::waitfordata(size_t data_count, _u32 timeout, size_t * returned_size)
+{
+    _u32 startTs = getms();
+    size_t readable = 0;
+
+    _lock.lock();
+    while (_isOpened) {
+        _u64 nextDue_us;
+        readable = _readable(data_count, nextDue_us);
+        if (readable >= data_count || _isDrained()) break;
+
+        // a cancel stays pending until a wait it ends consumes it
+        if (_isCancelled) {
+            _isCancelled = false;
+            break;
+        }
+
+        _u32 waited = getms() - startTs;
+        if (waited >= timeout) break;
+
+        _u32 waitTime = timeout - waited;
+        if (nextDue_us) {
+            _u64 now_us = rp::arch::rp_getus();
+            _u32 dueTime = nextDue_us > now_us ? (_u32)((nextDue_us - now_us + 999) / 1000) : 0;
+            if (dueTime < waitTime) waitTime = dueTime;
+        }
+
+        _lock.unlock();
+        _wakeEvt.wait(waitTime);
+        _lock.lock();
+    }
+    _lock.unlock();
+
+    if (returned_size) *returned_size = readable;
+    return readable && readable >= data_count;
+}
+
+bool ReplayChannelDevice::isDeviceLost()
+{
+    rp::hal::AutoLocker l(_lock);
+    return _isOpened && _isDrained();
+}
+
+void ReplayChannelDevice::cancelWait()
+{
+    {
+        rp::hal::AutoLocker l(_lock);
+        _isCancelled = true;
+    }
+    _wakeEvt.set();
+}
+
+void ReplayChannelDevice::clearCancelWait()
+{
+    rp::hal::AutoLocker l(_lock);
+    _isCancelled = false;
+}
+
+int ReplayChannelDevice::senddata(const _u8 * data, size_t size)
+{
+    rp::hal::AutoLocker l(_lock);
+    if (!_isOpened) return -1;
+
+    // commands are matched by their header, the payload pieces sent after it
+    // pass the pieces recorded after it
+    if (size < 2 || data[0] != RPLIDAR_CMD_SYNC_BYTE) {
+        if (_recordPos < _records.size() && _records[_recordPos].direction == RECORD_DIR_TX) {
+            ++_recordPos;
+            _recordOffset = 0;
+            _anchorRecord_us = _records[_recordPos - 1].timestamp_us;
+            _anchorHost_us = rp::arch::rp_getus();
+            _wakeEvt.set();
+        }
+        return (int)size;
+    }
+
+    for (size_t pos = _recordPos; pos < _records.size(); ++pos) {
+        const record_t & record = _records[pos];
+        if (record.direction != RECORD_DIR_TX || record.size < 2
+            || memcmp(&_data[record.offset], data, 2)) {
+            continue;
+        }
+
+        _recordPos = pos + 1;
+        _recordOffset = 0;
+        _anchorRecord_us = record.timestamp_us;
+        _anchorHost_us = rp::arch::rp_getus();
+        _wakeEvt.set();
+        break;
+    }
+    return (int)size;
+}
+
+int ReplayChannelDevice::recvdata(unsigned char * data, size_t size)
+{
+    rp::hal::AutoLocker l(_lock);
+
+    _u64 nextDue_us;
+    size_t readable = _readable(size, nextDue_us);
+    if (readable > size) readable = size;
+
+    size_t copied = 0;
+    while (copied < readable) {
+        const record_t & record = _records[_recordPos];
+        size_t chunk = record.size - _recordOffset;
+        if (chunk > readable - copied) chunk = readable - copied;
+
+        memcpy(data + copied, &_data[record.offset + _recordOffset], chunk);
+        copied += chunk;
+        _recordOffset += chunk;
+        if (_recordOffset == record.size) {
+            ++_recordPos;
+            _recordOffset = 0;
+        }
+    }
+    return (int)copied;
+}
+
+}}}
@@ -0,0 +1,134 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Passes everything through to the wrapped channel and logs the traffic to a
+// file: every chunk received, stamped with the host time it was read at, and
+// every piece sent, which ReplayChannelDevice uses to line the recorded
+// answers up with the commands of the replaying driver.
+class RecordingChannelDevice : public ChannelDevice
+{
+public:
+    // takes over the file, the wrapped channel stays owned by the caller
+    RecordingChannelDevice(ChannelDevice * channel, FILE * file);
+    virtual ~RecordingChannelDevice();
+
+    // creates the file and writes its header, NULL on failure
+    static FILE * CreateRecordFile(const char * path);
+
+    ChannelDevice * channel() const { return _channel; }
+
+    virtual bool bind(const char * path, uint32_t param);
+    virtual bool open();
+    virtual void close();
+    virtual void flush();
+    virtual bool waitfordata(size_t data_count, _u32 timeout = -1, size_t * returned_size = NULL);
+    virtual bool isDeviceLost();
+    virtual void cancelWait();
+    virtual void clearCancelWait();
+    virtual size_t getLostDatagramCount();
+    virtual int getPollHandle();
+    virtual int senddata(const _u8 * data, size_t size);
+    virtual int recvdata(unsigned char * data, size_t size);
+    virtual void setDTR();
+    virtual void clearDTR();
+    virtual void ReleaseRxTx();
+
+protected:
+    void _writeRecord(_u8 direction, const _u8 * data, size_t size);
+
+    ChannelDevice *     _channel;
+    FILE *              _file;
+    rp::hal::Locker     _fileLock;
+};
+
+// Plays a file written by RecordingChannelDevice back to a driver.
+//
+// A received chunk becomes readable at its recorded time relative to the
+// command preceding it, stretched by the pace (in percent of the recorded
+// speed), or right away at pace 0. Chunks recorded after a command only
+// become readable once the driver sends that command, so the driver has to
+// issue the commands of the recorded session; whatever is left unread when
+// it moves on to a later command is dropped. Once every recorded chunk has
+// been read the device counts as lost, which ends a running scan.
+class ReplayChannelDevice : public ChannelDevice
+{
+public:
+    ReplayChannelDevice();
+
+    virtual bool bind(const char * path, uint32_t pace);
+    virtual bool open();
+    virtual void close();
+    virtual bool waitfordata(size_t data_count, _u32 timeout = -1, size_t * returned_size = NULL);
+    virtual bool isDeviceLost();
+    virtual void cancelWait();
+    virtual void clearCancelWait();
+    virtual int senddata(const _u8 * data, size_t size);
+    virtual int recvdata(unsigned char * data, size_t size);
+
+protected:
+    struct record_t {
+        _u64    timestamp_us;
+        _u8     direction;
+        size_t  offset;         // of the bytes in _data
+        size_t  size;
+    };
+
+    bool   _load(const char * path);
+    bool   _isDrained() const;
+    size_t _readable(size_t wanted, _u64 & nextDue_us) const;
+
+    std::vector<record_t>   _records;
+    std::vector<_u8>        _data;
+    size_t                  _lastRx;            // index of the last received chunk + 1
+    _u32                    _pace;
+
+    size_t                  _recordPos;         // record the next byte is read from
+    size_t                  _recordOffset;      // bytes of it already read
+    _u64                    _anchorRecord_us;   // recorded time corresponding to _anchorHost_us
+    _u64                    _anchorHost_us;
+
+    bool                    _isOpened;
+    bool                    _isCancelled;
+    rp::hal::Locker         _lock;
+    rp::hal::Event          _wakeEvt;
+};
+
+}}}
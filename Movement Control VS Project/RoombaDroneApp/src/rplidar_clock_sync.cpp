@@ -0,0 +1,145 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_clock_sync.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+DeviceClockSync::DeviceClockSync()
+{
+    reset();
+}
+
+void DeviceClockSync::reset()
+{
+    _windowCount = 0;
+    _windowNext = 0;
+    _isCurrentValid = false;
+    _currentStart_us = 0;
+    _lastDevice_us = 0;
+    _ref_us = 0;
+    _offset_us = 0;
+    _drift = 0;
+}
+
+void DeviceClockSync::addSample(_u64 device_us, _u64 host_us)
+{
+    // the device clock restarted or the link was down for long, start over
+    if (_isCurrentValid && (device_us < _lastDevice_us || device_us - _lastDevice_us > MAX_GAP_US)) {
+        reset();
+    }
+    _lastDevice_us = device_us;
+
+    if (_isCurrentValid && device_us - _currentStart_us >= WINDOW_US) {
+        _closeWindow();
+    }
+
+    _s64 offset = (_s64)(host_us - device_us);
+    if (!_isCurrentValid) {
+        _currentStart_us = device_us;
+        _current.device_us = device_us;
+        _current.offset_us = offset;
+        _isCurrentValid = true;
+    } else if (offset < _current.offset_us) {
+        _current.device_us = device_us;
+        _current.offset_us = offset;
+    }
+
+    if (!_windowCount) {
+        // no drift estimate before the first window closes
+        _ref_us = _current.device_us;
+        _offset_us = (double)_current.offset_us;
+    }
+}
+
+void DeviceClockSync::_closeWindow()
+{
+    _windows[_windowNext] = _current;
+    _windowNext = (_windowNext + 1) % MAX_WINDOWS;
+    if (_windowCount < MAX_WINDOWS) ++_windowCount;
+
+    _isCurrentValid = false;
+    _fit();
+}
+
+void DeviceClockSync::_fit()
+{
+    // least squares over the window minima, relative to the newest one to keep
+    // the numbers small
+    const window_t & newest = _windows[(_windowNext + MAX_WINDOWS - 1) % MAX_WINDOWS];
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (size_t pos = 0; pos < _windowCount; ++pos) {
+        const window_t & window = _windows[pos];
+        double x = (double)(_s64)(window.device_us - newest.device_us);
+        double y = (double)(window.offset_us - newest.offset_us);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+
+    double n = (double)_windowCount;
+    double denom = n * sumXX - sumX * sumX;
+    _drift = (_windowCount > 1 && denom > 0) ? (n * sumXY - sumX * sumY) / denom : 0;
+
+    _ref_us = newest.device_us;
+    _offset_us = (double)newest.offset_us + (sumY - _drift * sumX) / n;
+}
+
+bool DeviceClockSync::isSynced() const
+{
+    return _isCurrentValid || _windowCount;
+}
+
+_u64 DeviceClockSync::toHost(_u64 device_us) const
+{
+    double offset = _offset_us + _drift * (double)(_s64)(device_us - _ref_us);
+
+    // a smaller offset seen since the last fit means the line runs late
+    if (_isCurrentValid && _windowCount) {
+        double predicted = _offset_us + _drift * (double)(_s64)(_current.device_us - _ref_us);
+        if ((double)_current.offset_us < predicted) {
+            offset -= predicted - (double)_current.offset_us;
+        }
+    }
+    return device_us + (_s64)offset;
+}
+
+double DeviceClockSync::driftPpm() const
+{
+    return _drift * 1e6;
+}
+
+}}}
@@ -0,0 +1,91 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Maps the device clock carried by HQ capsules onto the host clock.
+//
+// Every received capsule gives a pair of (device time, host receive time).
+// The receive time is late by a transport delay that is never negative, so
+// the smallest host - device offset seen within a window is the best
+// estimate of the true offset for that window. A line fitted through the
+// minima of the last few windows gives the offset and the drift between the
+// two clocks.
+class DeviceClockSync
+{
+public:
+    enum {
+        WINDOW_US = 1000000,            // device time covered by one window
+        MAX_WINDOWS = 8,                // windows the drift is fitted over
+        MAX_GAP_US = 10000000,          // device time jumps resetting the estimate
+    };
+
+    DeviceClockSync();
+
+    void reset();
+    void addSample(_u64 device_us, _u64 host_us);
+
+    bool isSynced() const;
+    _u64 toHost(_u64 device_us) const;
+
+    // drift of the device clock against the host clock in parts per million
+    double driftPpm() const;
+
+protected:
+    struct window_t {
+        _u64    device_us;      // device time of the sample with the smallest offset
+        _s64    offset_us;      // host - device of that sample
+    };
+
+    void _closeWindow();
+    void _fit();
+
+    window_t    _windows[MAX_WINDOWS];
+    size_t      _windowCount;
+    size_t      _windowNext;
+
+    window_t    _current;
+    bool        _isCurrentValid;
+    _u64        _currentStart_us;
+    _u64        _lastDevice_us;
+
+    // host = device + _offset_us + _drift * (device - _ref_us)
+    _u64        _ref_us;
+    double      _offset_us;
+    double      _drift;
+};
+
+}}}
@@ -0,0 +1,414 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+
+#include "hal/types.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "hal/thread.h"
+#include "hal/dev_watcher.h"
+#include "rplidar_connection_manager.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RPlidarConnectionManager * RPlidarConnectionManager::CreateManager(RPlidarDriver * driver)
+{
+    if (!driver) return NULL;
+    return new RPlidarConnectionManagerImpl(driver);
+}
+
+void RPlidarConnectionManager::DisposeManager(RPlidarConnectionManager * mgr)
+{
+    delete mgr;
+}
+
+RPlidarConnectionManagerImpl::RPlidarConnectionManagerImpl(RPlidarDriver * driver)
+    : _driver(driver)
+    , _watcher(rp::hal::DeviceWatcher::CreateWatcher())
+    , _listener(NULL)
+    , _baudrate(0)
+    , _stallTimeout(DEFAULT_STALL_TIMEOUT)
+    , _isWatching(false)
+    , _isLinkUp(false)
+    , _isRecovering(false)
+    , _lostTs(0)
+    , _failedProbes(0)
+    , _hasOutage(false)
+    , _lastOutage_ms(0)
+    , _motorState(MOTOR_OFF)
+    , _motorPwm(0)
+    , _scanCall(SCAN_NONE)
+    , _scanForce(false)
+    , _scanTypical(false)
+    , _scanMode(0)
+    , _scanOptions(0)
+    , _scanBudgetPercent(RPlidarDriver::DEFAULT_DECODE_BUDGET_PERCENT)
+    , _isScanModeSelected(false)
+    , _linkEvt(false, false)
+{
+}
+
+RPlidarConnectionManagerImpl::~RPlidarConnectionManagerImpl()
+{
+    stop();
+    rp::hal::DeviceWatcher::ReleaseWatcher(_watcher);
+}
+
+u_result RPlidarConnectionManagerImpl::start(const char * port_path, _u32 baudrate)
+{
+    if (_isWatching) return RESULT_ALREADY_DONE;
+    if (!port_path) return RESULT_INVALID_DATA;
+
+    _portPath = port_path;
+    _baudrate = baudrate;
+    _failedProbes = 0;
+
+    // without a watch the node is simply probed every RETRY_INTERVAL
+    _watcher->watch(port_path);
+
+    // a driver the application connected itself is taken over as it is
+    _isLinkUp = _driver->isConnected();
+    _linkEvt.set(_isLinkUp);
+
+    _isWatching = true;
+    _watchthread = CLASS_THREAD(RPlidarConnectionManagerImpl, _watchThreadProc);
+    if (_watchthread.getHandle() == 0) {
+        _isWatching = false;
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+void RPlidarConnectionManagerImpl::stop()
+{
+    if (!_isWatching) return;
+
+    _isWatching = false;
+    _watcher->cancel();
+    _watchthread.join();
+    _watchthread = rp::hal::Thread();
+    _watcher->unwatch();
+}
+
+u_result RPlidarConnectionManagerImpl::waitForLink(_u32 timeout)
+{
+    if (_isLinkUp) return RESULT_OK;
+
+    switch (_linkEvt.wait(timeout)) {
+    case rp::hal::Event::EVENT_OK:
+        return RESULT_OK;
+    case rp::hal::Event::EVENT_TIMEOUT:
+        return RESULT_OPERATION_TIMEOUT;
+    default:
+        return RESULT_OPERATION_FAIL;
+    }
+}
+
+bool RPlidarConnectionManagerImpl::isLinkUp()
+{
+    return _isLinkUp;
+}
+
+void RPlidarConnectionManagerImpl::setListener(ConnectionListener * listener)
+{
+    _listener = listener;
+}
+
+void RPlidarConnectionManagerImpl::setStallTimeout(_u32 timeout)
+{
+    _stallTimeout = timeout;
+}
+
+u_result RPlidarConnectionManagerImpl::getLastOutage(_u32 & outage_ms)
+{
+    rp::hal::AutoLocker l(_lock);
+
+    if (!_hasOutage) return RESULT_OPERATION_FAIL;
+    outage_ms = _lastOutage_ms;
+    return RESULT_OK;
+}
+
+u_result RPlidarConnectionManagerImpl::startMotor()
+{
+    rp::hal::AutoLocker l(_lock);
+
+    _motorState = MOTOR_DEFAULT;
+    if (!_isLinkUp) return RESULT_RECONNECTING;
+    return _driver->startMotor();
+}
+
+u_result RPlidarConnectionManagerImpl::stopMotor()
+{
+    rp::hal::AutoLocker l(_lock);
+
+    _motorState = MOTOR_OFF;
+    if (!_isLinkUp) return RESULT_RECONNECTING;
+    return _driver->stopMotor();
+}
+
+u_result RPlidarConnectionManagerImpl::setMotorPWM(_u16 pwm)
+{
+    rp::hal::AutoLocker l(_lock);
+
+    _motorState = pwm ? MOTOR_PWM : MOTOR_OFF;
+    _motorPwm = pwm;
+    if (!_isLinkUp) return RESULT_RECONNECTING;
+    return _driver->setMotorPWM(pwm);
+}
+
+u_result RPlidarConnectionManagerImpl::startScan(bool force, bool useTypicalScan, _u32 options, RplidarScanMode* outUsedScanMode)
+{
+    rp::hal::AutoLocker l(_lock);
+    u_result ans = RESULT_RECONNECTING;
+
+    if (_isLinkUp && IS_FAIL(ans = _driver->startScan(force, useTypicalScan, options, outUsedScanMode))) {
+        return ans;
+    }
+
+    _scanCall = SCAN_START;
+    _scanForce = force;
+    _scanTypical = useTypicalScan;
+    _scanOptions = options;
+    return ans;
+}
+
+u_result RPlidarConnectionManagerImpl::startScanExpress(bool force, _u16 scanMode, _u32 options, RplidarScanMode* outUsedScanMode)
+{
+    rp::hal::AutoLocker l(_lock);
+    u_result ans = RESULT_RECONNECTING;
+
+    if (_isLinkUp && IS_FAIL(ans = _driver->startScanExpress(force, scanMode, options, outUsedScanMode))) {
+        return ans;
+    }
+
+    _scanCall = SCAN_EXPRESS;
+    _scanForce = force;
+    _scanMode = scanMode;
+    _scanOptions = options;
+    return ans;
+}
+
+u_result RPlidarConnectionManagerImpl::startScanAuto(_u32 decodeBudgetPercent, RplidarScanModeSelection * outSelection)
+{
+    rp::hal::AutoLocker l(_lock);
+    u_result ans = RESULT_RECONNECTING;
+
+    _scanBudgetPercent = decodeBudgetPercent;
+    _isScanModeSelected = false;
+    if (_isLinkUp && IS_FAIL(ans = _selectScanMode(outSelection))) {
+        return ans;
+    }
+
+    _scanCall = SCAN_AUTO;
+    return ans;
+}
+
+u_result RPlidarConnectionManagerImpl::_selectScanMode(RplidarScanModeSelection * outSelection)
+{
+    RplidarScanModeSelection selection;
+    u_result ans = _driver->startScanAuto(_scanBudgetPercent, &selection);
+    if (IS_FAIL(ans)) return ans;
+
+    _scanMode = selection.mode.id;
+    _isScanModeSelected = true;
+    if (outSelection) *outSelection = selection;
+    return ans;
+}
+
+u_result RPlidarConnectionManagerImpl::stopScan()
+{
+    rp::hal::AutoLocker l(_lock);
+
+    _scanCall = SCAN_NONE;
+    if (!_isLinkUp) return RESULT_RECONNECTING;
+    return _driver->stop();
+}
+
+bool RPlidarConnectionManagerImpl::_probeDevice()
+{
+    if (!_driver->isConnected()) {
+        if (IS_FAIL(_driver->connect(_portPath.c_str(), _baudrate))) {
+            return false;
+        }
+        _failedProbes = 0;
+    }
+
+    // a short query tells whether the device is up without waiting for the
+    // full command timeout, e.g. while it is still booting after a brown-out
+    rplidar_response_device_health_t health;
+    if (IS_OK(_driver->getHealth(health, PROBE_TIMEOUT))) {
+        // connect may have identified the device while it was still silent
+        rplidar_response_device_info_t info;
+        if (IS_OK(_driver->getDeviceInfo(info))) {
+            _failedProbes = 0;
+            return true;
+        }
+    }
+
+    if (++_failedProbes >= PROBES_PER_REOPEN) {
+        // the open port may belong to a node that was replaced unnoticed
+        _driver->disconnect();
+        _failedProbes = 0;
+    }
+    return false;
+}
+
+u_result RPlidarConnectionManagerImpl::_applyMotorState()
+{
+    switch (_motorState) {
+    case MOTOR_DEFAULT:
+        return _driver->startMotor();
+    case MOTOR_PWM:
+        return _driver->setMotorPWM(_motorPwm);
+    default:
+        // connect leaves the motor stopped
+        return RESULT_OK;
+    }
+}
+
+u_result RPlidarConnectionManagerImpl::_applyScanState()
+{
+    switch (_scanCall) {
+    case SCAN_START:
+        return _driver->startScan(_scanForce, _scanTypical, _scanOptions);
+    case SCAN_EXPRESS:
+        return _driver->startScanExpress(_scanForce, _scanMode, _scanOptions);
+    case SCAN_AUTO:
+        // the selection grabs scans to check the rate, and would split them with the
+        // application grabbing at the same time; the mode picked once is kept
+        if (_isScanModeSelected) return _driver->startScanExpress(false, _scanMode);
+        return _selectScanMode(NULL);
+    default:
+        return RESULT_OK;
+    }
+}
+
+bool RPlidarConnectionManagerImpl::_isStalled(_u32 & idle_ms)
+{
+    idle_ms = 0;
+    if (_scanCall == SCAN_NONE) return false;
+
+    // the scan ends by itself once the port reports the device gone
+    if (!_driver->isScanning()) return true;
+
+    return IS_OK(_driver->getScanIdleTime(idle_ms)) && idle_ms > _stallTimeout;
+}
+
+void RPlidarConnectionManagerImpl::_loseLink(_u32 idle_ms)
+{
+    _isLinkUp = false;
+    _linkEvt.set(false);
+
+    // the outage starts with the last data received, not with its detection
+    _isRecovering = true;
+    _lostTs = getms() - idle_ms;
+    _failedProbes = 0;
+}
+
+u_result RPlidarConnectionManagerImpl::_watchThreadProc()
+{
+    while (_isWatching) {
+        if (_isLinkUp) {
+            int event = _watcher->waitForEvent(WATCH_INTERVAL);
+            if (event == rp::hal::DeviceWatcher::EVENT_FAILED) {
+                delay(WATCH_INTERVAL);
+            }
+
+            bool isLost = false;
+            {
+                rp::hal::AutoLocker l(_lock);
+                _u32 idle_ms = 0;
+
+                if (event == rp::hal::DeviceWatcher::EVENT_NODE_REMOVED) {
+                    _driver->getScanIdleTime(idle_ms);
+                    _loseLink(idle_ms);
+                    _driver->disconnect();
+                    isLost = true;
+                } else if (_isStalled(idle_ms)) {
+                    // keep the port open, the device is probed on it until it answers again
+                    _loseLink(idle_ms);
+                    _driver->stop();
+                    isLost = true;
+                }
+            }
+            if (isLost && _listener) {
+                _listener->onConnectionLost();
+            }
+            continue;
+        }
+
+        if (_watcher->isPresent()) {
+            u_result ans = RESULT_OPERATION_FAIL;
+            _u32 outage_ms = 0;
+            {
+                rp::hal::AutoLocker l(_lock);
+
+                if (_probeDevice() && IS_OK(ans = _applyMotorState()) && IS_OK(ans = _applyScanState())) {
+                    _isLinkUp = true;
+                    _linkEvt.set();
+
+                    if (_isRecovering) {
+                        outage_ms = getms() - _lostTs;
+                        _lastOutage_ms = outage_ms;
+                        _hasOutage = true;
+                    }
+                }
+            }
+
+            if (_isLinkUp) {
+                if (_isRecovering && _listener) {
+                    _listener->onConnectionRestored(outage_ms);
+                }
+                _isRecovering = false;
+                continue;
+            }
+        } else if (_driver->isConnected()) {
+            rp::hal::AutoLocker l(_lock);
+            _driver->disconnect();
+        }
+
+        // sleep until the node shows up again, or retry a node that is there but silent
+        int event = _watcher->waitForEvent(RETRY_INTERVAL);
+        if (event == rp::hal::DeviceWatcher::EVENT_NODE_REMOVED) {
+            rp::hal::AutoLocker l(_lock);
+            _driver->disconnect();
+        } else if (event == rp::hal::DeviceWatcher::EVENT_FAILED) {
+            delay(RETRY_INTERVAL);
+        }
+    }
+    return RESULT_OK;
+}
+
+}}}
@@ -0,0 +1,128 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <string>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// The watch thread owns the link: it opens the port once the device node is
+// there, probes the device until it answers, then restores the recorded motor
+// and scan state. While the link is up it checks the scan for stalls between
+// device node events. Application commands and the watch thread's driver
+// calls are serialised by _lock.
+class RPlidarConnectionManagerImpl : public RPlidarConnectionManager
+{
+public:
+    enum {
+        WATCH_INTERVAL      = 50,   // ms between stall checks while the link is up
+        RETRY_INTERVAL      = 200,  // ms between probes of a device node that does not answer
+        PROBE_TIMEOUT       = 100,  // ms the device gets to answer a probe
+        PROBES_PER_REOPEN   = 10,   // failed probes before the port is reopened
+    };
+
+    explicit RPlidarConnectionManagerImpl(RPlidarDriver * driver);
+    virtual ~RPlidarConnectionManagerImpl();
+
+    virtual u_result start(const char * port_path, _u32 baudrate);
+    virtual void stop();
+    virtual u_result waitForLink(_u32 timeout);
+    virtual bool isLinkUp();
+    virtual void setListener(ConnectionListener * listener);
+    virtual void setStallTimeout(_u32 timeout);
+    virtual u_result getLastOutage(_u32 & outage_ms);
+
+    virtual u_result startMotor();
+    virtual u_result stopMotor();
+    virtual u_result setMotorPWM(_u16 pwm);
+    virtual u_result startScan(bool force, bool useTypicalScan, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL);
+    virtual u_result startScanExpress(bool force, _u16 scanMode, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL);
+    virtual u_result startScanAuto(_u32 decodeBudgetPercent = RPlidarDriver::DEFAULT_DECODE_BUDGET_PERCENT, RplidarScanModeSelection * outSelection = NULL);
+    virtual u_result stopScan();
+
+protected:
+    enum motor_state_t {
+        MOTOR_OFF,
+        MOTOR_DEFAULT,      // started by startMotor
+        MOTOR_PWM,          // set by setMotorPWM
+    };
+
+    enum scan_call_t {
+        SCAN_NONE,
+        SCAN_START,         // started by startScan
+        SCAN_EXPRESS,       // started by startScanExpress
+        SCAN_AUTO,          // started by startScanAuto
+    };
+
+    u_result _watchThreadProc();
+    bool     _probeDevice();
+    u_result _applyMotorState();
+    u_result _applyScanState();
+    u_result _selectScanMode(RplidarScanModeSelection * outSelection);
+    bool     _isStalled(_u32 & idle_ms);
+    void     _loseLink(_u32 idle_ms);
+
+    RPlidarDriver *             _driver;
+    rp::hal::DeviceWatcher *    _watcher;
+    ConnectionListener *        _listener;
+
+    std::string                 _portPath;
+    _u32                        _baudrate;
+    _u32                        _stallTimeout;
+
+    volatile bool               _isWatching;
+    volatile bool               _isLinkUp;
+    bool                        _isRecovering;      // the link was up before and got lost
+    _u32                        _lostTs;            // getms() of the last data before the loss
+    size_t                      _failedProbes;
+    bool                        _hasOutage;
+    _u32                        _lastOutage_ms;
+
+    motor_state_t               _motorState;
+    _u16                        _motorPwm;
+    scan_call_t                 _scanCall;
+    bool                        _scanForce;
+    bool                        _scanTypical;
+    _u16                        _scanMode;
+    _u32                        _scanOptions;
+    _u32                        _scanBudgetPercent;
+    bool                        _isScanModeSelected;    // _scanMode holds the mode startScanAuto picked
+
+    rp::hal::Locker             _lock;
+    rp::hal::Event              _linkEvt;           // manual reset, signalled while the link is up
+    rp::hal::Thread             _watchthread;
+};
+
+}}}
@@ -41,9 +41,26 @@
 #include "hal/locker.h"
 #include "hal/socket.h"
 #include "hal/event.h"
+#include "hal/triple_buffer.h"
+#include "hal/arena.h"
+#include "hal/spsc_ring.h"
+#include "hal/crc32.h"
+#include "hal/poller.h"
+#include "rplidar_rx_ring.h"
+#include "rplidar_capsule_decoder.h"
+#include "rplidar_scan_sorter.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_clock_sync.h"
+#include "rplidar_capability_cache.h"
+#include "rplidar_channel_record.h"
+#include "rplidar_mode_selector.h"
+#include "rplidar_spin_control.h"
+#include "rplidar_reactor.h"
 #include "rplidar_driver_impl.h"
 #include "rplidar_driver_serial.h"
 #include "rplidar_driver_TCP.h"
+#include "rplidar_driver_UDP.h"
+#include "rplidar_driver_replay.h"
 
 #include <algorithm>
 
@@ -66,6 +83,22 @@ namespace rp { namespace standalone{ namespace rplidar {
        //fprintf(stderr, "*WARN* YOU ARE USING DEPRECATED API: %s, PLEASE MOVE TO %s\n", fn, replacement);
     }
 
+static u_result applyThreadAttributes(rp::hal::Thread & thread, const RplidarThreadAttributes & attributes)
+{
+    if (attributes.policy > THREAD_POLICY_RR) return RESULT_INVALID_DATA;
+
+    // a refused real-time policy still leaves the thread on its CPUs and named,
+    // the first refusal is what gets reported
+    u_result ans = thread.setScheduling((rp::hal::Thread::sched_policy_t)attributes.policy, attributes.priority);
+    u_result next = thread.setAffinity(attributes.cpu_mask);
+    if (IS_OK(ans)) ans = next;
+    if (attributes.name[0]) {
+        next = thread.setName(attributes.name);
+        if (IS_OK(ans)) ans = next;
+    }
+    return ans;
+}
+
 static void convert(const rplidar_response_measurement_node_t& from, rplidar_response_measurement_node_hq_t& to)
 {
     to.angle_z_q14 = (((from.angle_q6_checkbit) >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) << 8) / 90;  //transfer to q14 Z-angle
@@ -82,13 +115,22 @@ static void convert(const rplidar_response_measurement_node_hq_t& from, rplidar_
 }
 
 // Factory Impl
-RPlidarDriver * RPlidarDriver::CreateDriver(_u32 drivertype)
+RPlidarDriver * RPlidarDriver::CreateDriver(_u32 drivertype, _u32 scanCapacity)
 {
+    // the interval ring shares the capacity and needs a power of 2
+    if (!scanCapacity || (scanCapacity & (scanCapacity - 1)) || scanCapacity > MAX_SCAN_NODES) {
+        return NULL;
+    }
+
     switch (drivertype) {
     case DRIVER_TYPE_SERIALPORT:
-        return new RPlidarDriverSerial();
+        return new RPlidarDriverSerial(scanCapacity);
     case DRIVER_TYPE_TCP:
-         return new RPlidarDriverTCP();
+         return new RPlidarDriverTCP(scanCapacity);
+    case DRIVER_TYPE_REPLAY:
+        return new RPlidarDriverReplay(scanCapacity);
+    case DRIVER_TYPE_UDP:
+        return new RPlidarDriverUDP(scanCapacity);
     default:
         return NULL;
     }
@@ -101,13 +143,33 @@ void RPlidarDriver::DisposeDriver(RPlidarDriver * drv)
 }
 
 
-RPlidarDriverImplCommon::RPlidarDriverImplCommon()
+
+RPlidarDriverImplCommon::RPlidarDriverImplCommon(_u32 scanCapacity)
     : _isConnected(false)
     , _isScanning(false)
     , _isSupportingMotorCtrl(false)
+    , _scanCapacity(scanCapacity)
+    , _scanPool(NULL)
+    , _scanListener(NULL)
+    , _scanListenerSectors(0)
+    , _isScanListenerThreaded(false)
+    , _sectorStart(0)
+    , _sectorCursor(0)
+    , _sectorIndex(0)
+    , _recorder(NULL)
+    , _rxTimestamp_us(0)
+    , _lastRxMs(0)
+    , _sampleDuration_us(0)
+    , _isDatagramFramed(false)
+    , _rxAfterGap(false)
+    , _channelLostDatagrams(0)
+    , _lostDatagrams(0)
+    , _reactor(NULL)
+    , _cacheStep(NULL)
+    , _isFirstFrame(false)
+    , _hasCacheThreadAttributes(false)
+    , _cacheThreadAttributesResult(RESULT_OK)
 {
-    _cached_scan_node_hq_count = 0;
-    _cached_scan_node_hq_count_for_interval_retrieve = 0;
     _cached_sampleduration_std = LEGACY_SAMPLE_DURATION;
     _cached_sampleduration_express = LEGACY_SAMPLE_DURATION;
 }
@@ -117,6 +179,41 @@ bool RPlidarDriverImplCommon::isConnected()
     return _isConnected;
 }
 
+_u32 RPlidarDriverImplCommon::getScanCapacity()
+{
+    return _scanCapacity;
+}
+
+bool RPlidarDriverImplCommon::isScanning()
+{
+    return _isScanning;
+}
+
+u_result RPlidarDriverImplCommon::getScanIdleTime(_u32 & idle_ms)
+{
+    if (!_isScanning) return RESULT_OPERATION_FAIL;
+
+    idle_ms = getms() - _lastRxMs;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_allocateScanBuffers()
+{
+    // the buffers survive disconnect, a reconnect reuses them
+    if (_scanArena.isReserved()) return RESULT_ALREADY_DONE;
+
+    // three scan slots plus the interval ring, all of them _scanCapacity nodes
+    if (!_scanArena.reserve(4 * rp::hal::Arena::footprint<rplidar_response_measurement_node_hq_t>(_scanCapacity))) {
+        return RESULT_INSUFFICIENT_MEMORY;
+    }
+
+    for (size_t pos = 0; pos < 3; ++pos) {
+        _cached_scan.buffer(pos).nodes = _scanArena.alloc<rplidar_response_measurement_node_hq_t>(_scanCapacity);
+    }
+    _cached_scan_node_hq_for_interval_retrieve.attach(_scanArena.alloc<rplidar_response_measurement_node_hq_t>(_scanCapacity), _scanCapacity);
+    return RESULT_OK;
+}
+
 
 u_result RPlidarDriverImplCommon::reset(_u32 timeout)
 {
@@ -235,6 +332,11 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
 
+    if (_capabilityCache.getDeviceInfo(info)) {
+        _isTofLidar = ((info.model >> 4) > RPLIDAR_TOF_MINUM_MAJOR_ID);
+        return RESULT_OK;
+    }
+
     _disableDataGrabbing();
 
     {
@@ -269,9 +371,32 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
             _isTofLidar = false;
         }
     }
+    _capabilityCache.setDeviceInfo(info);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setCapabilityCacheDir(const char * path)
+{
+    _capabilityCache.setStorageDir(path);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::clearCapabilityCache()
+{
+    _capabilityCache.clear();
     return RESULT_OK;
 }
 
+void RPlidarDriverImplCommon::_identifyDevice()
+{
+    // a different device may have been plugged in since the last connection,
+    // so the cache only answers again once the device info has been checked
+    _capabilityCache.unconfirm();
+
+    rplidar_response_device_info_t devinfo;
+    getDeviceInfo(devinfo);
+}
+
 u_result RPlidarDriverImplCommon::checkIfTofLidar(bool & isTofLidar, _u32 timeout)
 {
     isTofLidar = _isTofLidar;
@@ -301,59 +426,142 @@ u_result RPlidarDriverImplCommon::getFrequency(const RplidarScanMode& scanMode,
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitNode(rplidar_response_measurement_node_t * node, _u32 timeout)
+static bool _isNodeSync(const _u8 * frame)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_measurement_node_t)];
-    _u8 *nodeBuffer = (_u8*)node;
-    _u32 waitTime;
+    // expect the sync bit and its reverse in the first byte, and the check bit in the second one
+    return (((frame[0] >> 1) ^ frame[0]) & 0x1) && (frame[1] & RPLIDAR_RESP_MEASUREMENT_CHECKBIT);
+}
 
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_measurement_node_t) - recvPos;
-        size_t recvSize;
+static bool _isCapsuleSync(const _u8 * frame)
+{
+    return ((frame[0] >> 4) == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1) && ((frame[1] >> 4) == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2);
+}
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans) return RESULT_OPERATION_FAIL;
+static bool _isHqCapsuleSync(const _u8 * frame)
+{
+    return frame[0] == RPLIDAR_RESP_MEASUREMENT_HQ_SYNC;
+}
 
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
+static _u8 _capsuleChecksum(const _u8 * frame, size_t frameSize)
+{
+    // the checksum covers everything after the two checksum/sync bytes
+    _u8 checksum = 0;
+    for (size_t pos = 2; pos < frameSize; ++pos) {
+        checksum ^= frame[pos];
+    }
+    return checksum;
+}
 
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit and its reverse in this byte
-                {
-                    _u8 tmp = (currentByte>>1);
-                    if ( (tmp ^ currentByte) & 0x1 ) {
-                        // pass
-                    } else {
-                        continue;
-                    }
+u_result RPlidarDriverImplCommon::_fillRxRing(size_t required, _u32 timeout)
+{
+    // any datagram holds whole frames
+    if (_isDatagramFramed) required = 1;
 
-                }
-                break;
-            case 1: // expect the highest bit to be 1
-                {
-                    if (currentByte & RPLIDAR_RESP_MEASUREMENT_CHECKBIT) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
+    size_t recvSize = 0;
+    if (!_chanDev->waitfordata(required, timeout, &recvSize)) {
+        // a vanished device ends the scan instead of timing out forever
+        return _chanDev->isDeviceLost() ? RESULT_OPERATION_FAIL : RESULT_OPERATION_TIMEOUT;
+    }
+
+    // drain everything the channel has queued with a single read, or a single
+    // datagram for datagram channels
+    size_t room;
+    _u8 * dest = _rxRing.writePtr(room);
+    int received = _chanDev->recvdata(dest, room);
+    if (received > 0) {
+        _u32 now = getms();
 
-            if (recvPos == sizeof(rplidar_response_measurement_node_t)) {
+        // data resuming after a stall does not continue the frames received before it
+        if (now - _lastRxMs > DEFAULT_TIMEOUT) _rxAfterGap = true;
+
+        _rxRing.commit(received);
+        _rxTimestamp_us = rp::arch::rp_getus();
+        _lastRxMs = now;
+    }
+
+    if (_isDatagramFramed) {
+        size_t lost = _chanDev->getLostDatagramCount();
+        if (lost != _channelLostDatagrams) {
+            _lostDatagrams += lost - _channelLostDatagrams;
+            _channelLostDatagrams = lost;
+            _rxAfterGap = true;
+        }
+    }
+    return RESULT_OK;
+}
+
+void RPlidarDriverImplCommon::_discardFrame()
+{
+    if (_isDatagramFramed) {
+        _discardDatagram();
+    } else {
+        // only drop the sync byte, the real frame may start inside this one
+        _rxRing.consume(1);
+    }
+}
+
+void RPlidarDriverImplCommon::_discardDatagram()
+{
+    // the ring only ever holds what is left of a single datagram
+    _rxRing.consume(_rxRing.size());
+    _rxAfterGap = true;
+    ++_lostDatagrams;
+}
+
+u_result RPlidarDriverImplCommon::_waitFrame(size_t frameSize, frame_sync_checker_t syncChecker, const _u8 * & frame, bool & afterGap, _u32 timeout)
+{
+    _u32 startTs = getms();
+    _u32 waitTime;
+    u_result ans;
+
+    afterGap = false;
+    for (;;) {
+        // hunt for the sync bytes in the data already buffered, the partial frame
+        // left in the ring is picked up again on the next call
+        while (_rxRing.size() >= frameSize) {
+            if (syncChecker(_rxRing.front())) {
+                frame = _rxRing.front();
+                afterGap |= _rxAfterGap;
+                _rxAfterGap = false;
                 return RESULT_OK;
             }
+            if (_isDatagramFramed) {
+                // frames never straddle datagrams, there is nothing to hunt for
+                break;
+            }
+            _rxRing.consume(1);
+            afterGap = true;
+        }
+
+        if (_isDatagramFramed && _rxRing.size()) {
+            // a datagram not made of whole frames
+            _discardDatagram();
+        }
+
+        // once the time is up the channel is still polled, a timeout of 0 takes
+        // whatever has been received without waiting
+        if ((waitTime = getms() - startTs) > timeout) waitTime = timeout;
+
+        if (IS_FAIL(ans = _fillRxRing(frameSize - _rxRing.size(), timeout - waitTime))) {
+            return ans;
         }
     }
+}
 
-    return RESULT_OPERATION_TIMEOUT;
+u_result RPlidarDriverImplCommon::_waitNode(rplidar_response_measurement_node_t * node, _u32 timeout)
+{
+    const _u8 * frame;
+    bool afterGap;
+
+    u_result ans = _waitFrame(sizeof(rplidar_response_measurement_node_t), _isNodeSync, frame, afterGap, timeout);
+    if (IS_FAIL(ans)) {
+        // a stalled standard scan stops the cache thread, polling is not a stall
+        return (ans == RESULT_OPERATION_TIMEOUT && timeout) ? RESULT_OPERATION_FAIL : ans;
+    }
+
+    memcpy(node, frame, sizeof(rplidar_response_measurement_node_t));
+    _rxRing.consume(sizeof(rplidar_response_measurement_node_t));
+    return RESULT_OK;
 }
 
 u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
@@ -368,891 +576,551 @@ u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_nod
     _u32     waitTime;
     u_result ans;
 
-    while ((waitTime = getms() - startTs) <= timeout && recvNodeCount < count) {
+    while (recvNodeCount < count) {
+        // the nodes already received are still taken once the time is up
+        if ((waitTime = getms() - startTs) > timeout) waitTime = timeout;
+
         rplidar_response_measurement_node_t node;
         if (IS_FAIL(ans = _waitNode(&node, timeout - waitTime))) {
+            count = recvNodeCount;
             return ans;
         }
         
         nodebuffer[recvNodeCount++] = node;
-
-        if (recvNodeCount == count) return RESULT_OK;
     }
-    count = recvNodeCount;
-    return RESULT_OPERATION_TIMEOUT;
+    return RESULT_OK;
 }
 
 
-u_result RPlidarDriverImplCommon::_waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitCapsuledNode(const rplidar_response_capsule_measurement_nodes_t * & node, _u32 timeout)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-
+    const _u8 * frame;
+    bool afterGap;
 
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
+    u_result ans = _waitFrame(sizeof(rplidar_response_capsule_measurement_nodes_t), _isCapsuleSync, frame, afterGap, timeout);
+    if (IS_FAIL(ans)) {
+        // polling without data leaves the capsule sequence intact
+        if (ans != RESULT_OPERATION_TIMEOUT || timeout) _is_previous_capsuledataRdy = false;
+        return ans;
+    }
+    if (afterGap) {
+        _is_previous_capsuledataRdy = false;
+    }
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
+    node = reinterpret_cast<const rplidar_response_capsule_measurement_nodes_t *>(frame);
 
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                        // pass
-                    } else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
+    _u8 recvChecksum = ((node->s_checksum_1 & 0xF) | (node->s_checksum_2<<4));
+    if (recvChecksum != _capsuleChecksum(frame, sizeof(rplidar_response_capsule_measurement_nodes_t))) {
+        _discardFrame();
+        _is_previous_capsuledataRdy = false;
+        return RESULT_INVALID_DATA;
+    }
+    _rxRing.consume(sizeof(rplidar_response_capsule_measurement_nodes_t));
 
-                }
-                break;
-            case 1: // expect the sync bit 2
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2<<4));
-                for (size_t cpos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6);
-                    cpos < sizeof(rplidar_response_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
-        }
+    if (node->start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
+        // this is the first capsule frame in logic, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(const rplidar_response_ultra_capsule_measurement_nodes_t * & node, _u32 timeout)
 {
     if (!_isConnected) {
         return RESULT_OPERATION_FAIL;
     }
-    
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_ultra_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                    // pass
-                    }
-                    else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }    
-            break;
-            case 1: // expect the sync bit 2
-            {
-                _u8 tmp = (currentByte>>4);
-                if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                    // pass
-                }
-                else {
-                    recvPos = 0;
-                    _is_previous_capsuledataRdy = false;
-                    continue;
-                }
-            }
-            break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
-                
-                for (size_t cpos = offsetof(rplidar_response_ultra_capsule_measurement_nodes_t, start_angle_sync_q6);
-                cpos < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
-        }
+    const _u8 * frame;
+    bool afterGap;
+
+    u_result ans = _waitFrame(sizeof(rplidar_response_ultra_capsule_measurement_nodes_t), _isCapsuleSync, frame, afterGap, timeout);
+    if (IS_FAIL(ans)) {
+        // polling without data leaves the capsule sequence intact
+        if (ans != RESULT_OPERATION_TIMEOUT || timeout) _is_previous_capsuledataRdy = false;
+        return ans;
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+    if (afterGap) {
+        _is_previous_capsuledataRdy = false;
+    }
+
+    node = reinterpret_cast<const rplidar_response_ultra_capsule_measurement_nodes_t *>(frame);
+
+    _u8 recvChecksum = ((node->s_checksum_1 & 0xF) | (node->s_checksum_2 << 4));
+    if (recvChecksum != _capsuleChecksum(frame, sizeof(rplidar_response_ultra_capsule_measurement_nodes_t))) {
+        _discardFrame();
+        _is_previous_capsuledataRdy = false;
+        return RESULT_INVALID_DATA;
+    }
+    _rxRing.consume(sizeof(rplidar_response_ultra_capsule_measurement_nodes_t));
+
+    if (node->start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
+        // this is the first capsule frame in logic, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
+    }
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_cacheScanData()
+_u64 RPlidarDriverImplCommon::_estimateBatchStart(size_t count, size_t delaySamples)
 {
-    rplidar_response_measurement_node_t      local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
+    // the last node of the batch was sampled delaySamples before the latest read
+    size_t samples = delaySamples + (count ? count - 1 : 0);
+    return _rxTimestamp_us - (_u64)(samples * _sampleDuration_us);
+}
 
-    _waitScanData(local_buf, count); // // always discard the first data since it may be incomplete
+void RPlidarDriverImplCommon::_cacheScanNodes(const rplidar_response_measurement_node_hq_t * nodes, size_t count, _u64 firstNodeTs_us)
+{
+    // the scan being assembled lives directly in the back buffer of _cached_scan
+    scan_slot_t * scan = &_cached_scan.back();
 
-    while(_isScanning)
+    size_t pos = 0;
+    while (pos < count)
     {
-        if (IS_FAIL(ans=_waitScanData(local_buf, count))) {
-            if (ans != RESULT_OPERATION_TIMEOUT) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            }
-        }
-        
-        for (size_t pos = 0; pos < count; ++pos)
+        if (nodes[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
         {
-            if (local_buf[pos].sync_quality & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
+            _u64 syncTs_us = firstNodeTs_us + (_u64)(pos * _sampleDuration_us);
+
+            // only publish the data when it contains a full 360 degree scan 
+            if (scan->count && (scan->nodes[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
+                // the start of this scan ends the previous one, which gives the real sample duration;
+                // smooth it and drop revolutions distorted by a stalled read, or cut short by the capacity
+                bool isTruncated = (scan->count >= _scanCapacity - 1);
+                if (!isTruncated && syncTs_us > scan->timestamp.first_sample_us) {
+                    float measured = (float)(syncTs_us - scan->timestamp.first_sample_us) / scan->count;
+                    if (measured > _sampleDuration_us * 0.5f && measured < _sampleDuration_us * 2.0f) {
+                        _sampleDuration_us += (measured - _sampleDuration_us) * 0.25f;
+                        _regulateSpin(syncTs_us - scan->timestamp.first_sample_us);
+                    }
                 }
-                scan_count = 0;
-            }
-
-            rplidar_response_measurement_node_hq_t nodeHq;
-            convert(local_buf[pos], nodeHq);
-            local_scan[scan_count++] = nodeHq;
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
+                scan->timestamp.us_per_sample = _sampleDuration_us;
 
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = nodeHq;
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
+                if (_scanListener) {
+                    _finishSectors(*scan);
+                    if (!_isScanListenerThreaded) {
+                        _scanListener->onScan(scan->nodes, scan->count, scan->timestamp);
+                    }
+                }
+                _cached_scan.publish();
+                _dataEvt.set();
+                scan = &_cached_scan.back();
             }
+            scan->count = 0;
+            scan->timestamp.first_sample_us = syncTs_us;
+            _sectorStart = 0;
+            _sectorCursor = 0;
+            _sectorIndex = 0;
         }
-    }
-    _isScanning = false;
-    return RESULT_OK;
-}
 
-u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
-{
-    u_result ans;
-    if (!isConnected()) return RESULT_OPERATION_FAIL;
-    if (_isScanning) return RESULT_ALREADY_DONE;
+        // append the whole run up to the next sync node at once
+        size_t runEnd = pos + 1;
+        while (runEnd < count && !(nodes[runEnd].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) ++runEnd;
 
-    stop(); //force the previous operation to stop
+        size_t runSize = runEnd - pos;
+        size_t room = _scanCapacity - 1 - scan->count; // prevent overflow
+        if (runSize > room) runSize = room;
 
-    {
-        rp::hal::AutoLocker l(_lock);
+        memcpy(scan->nodes + scan->count, nodes + pos, runSize * sizeof(rplidar_response_measurement_node_hq_t));
+        scan->count += runSize;
+        pos = runEnd;
 
-        if (IS_FAIL(ans = _sendCommand(force?RPLIDAR_CMD_FORCE_SCAN:RPLIDAR_CMD_SCAN))) {
-            return ans;
+        if (_scanListenerSectors) {
+            _dispatchSectors(*scan);
         }
+    }
 
-        // waiting for confirmation
-        rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
-            return ans;
-        }
+    //for interval retrieve, nodes not fitting into the ring are counted as dropped
+    _cached_scan_node_hq_for_interval_retrieve.push(nodes, count);
+}
 
-        // verify whether we got a correct header
-        if (response_header.type != RPLIDAR_ANS_TYPE_MEASUREMENT) {
-            return RESULT_INVALID_DATA;
-        }
+void RPlidarDriverImplCommon::_dispatchSectors(const scan_slot_t & scan)
+{
+    // partial scans get dropped, so do their sectors
+    if (!(scan.nodes[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
+        _sectorStart = _sectorCursor = scan.count;
+        return;
+    }
 
-        _u32 header_size = (response_header.size_q30_subtype & RPLIDAR_ANS_HEADER_SIZE_MASK);
-        if (header_size < sizeof(rplidar_response_measurement_node_t)) {
-            return RESULT_INVALID_DATA;
+    for (; _sectorCursor < scan.count; ++_sectorCursor) {
+        _u32 sector = (scan.nodes[_sectorCursor].angle_z_q14 * _scanListenerSectors) >> 16;
+
+        // a sector ends once a sample of a later one shows up. Samples jittering back
+        // stay in the current sector, and so do the ones more than half a turn ahead:
+        // those are the end of the previous turn, pushed after the sync node by the
+        // angle correction.
+        if (sector <= _sectorIndex || (sector - _sectorIndex) * 2 >= _scanListenerSectors) {
+            continue;
         }
 
-        _isScanning = true;
-        _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheScanData);
-        if (_cachethread.getHandle() == 0) {
-            return RESULT_OPERATION_FAIL;
+        if (_sectorCursor > _sectorStart) {
+            _scanListener->onSector(scan.nodes + _sectorStart, _sectorCursor - _sectorStart, _sectorIndex);
         }
+        _sectorStart = _sectorCursor;
+        _sectorIndex = sector;
     }
-    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::checkExpressScanSupported(bool & support, _u32 timeout)
+void RPlidarDriverImplCommon::_finishSectors(const scan_slot_t & scan)
 {
-    DEPRECATED_WARN("checkExpressScanSupported(bool&,_u32)", "getAllSupportedScanModes()");
+    if (!_scanListenerSectors) return;
 
-    rplidar_response_device_info_t devinfo;
+    _dispatchSectors(scan);
+    if (scan.count > _sectorStart) {
+        _scanListener->onSector(scan.nodes + _sectorStart, scan.count - _sectorStart, _sectorIndex);
+    }
+}
 
-    support = false;
-    u_result ans = getDeviceInfo(devinfo, timeout);
+void RPlidarDriverImplCommon::_regulateSpin(_u64 period_us)
+{
+    _u16 nextCommand;
+    {
+        rp::hal::AutoLocker l(_spinLock);
+        if (!_spinControl.addRevolution(period_us, nextCommand)) return;
+    }
 
-    if (IS_FAIL(ans)) return ans;
+    // a command holding _lock may sit in a long response timeout, and the decode
+    // loop must not block behind it; a busy channel only delays the correction
+    // to the next window
+    if (_lock.lock(0) != rp::hal::Locker::LOCK_OK) return;
 
-    if (devinfo.firmware_version >= ((0x1<<8) | 17)) {
-        support = true;
-        rplidar_response_sample_rate_t sample_rate;
-        getSampleDuration_uS(sample_rate);
-        _cached_sampleduration_express = sample_rate.express_sample_duration_us;
-        _cached_sampleduration_std = sample_rate.std_sample_duration_us;
+    u_result ans;
+    if (_isTofLidar) {
+        rplidar_payload_hq_spd_ctrl_t speedReq;
+        speedReq.rpm = nextCommand;
+        ans = _sendCommand(RPLIDAR_CMD_HQ_MOTOR_SPEED_CTRL, (const _u8 *)&speedReq, sizeof(speedReq));
+    } else {
+        rplidar_payload_motor_pwm_t motor_pwm;
+        motor_pwm.pwm_value = nextCommand;
+        ans = _sendCommand(RPLIDAR_CMD_SET_MOTOR_PWM, (const _u8 *)&motor_pwm, sizeof(motor_pwm));
     }
+    _lock.unlock();
 
-    return RESULT_OK;
+    if (IS_OK(ans)) {
+        rp::hal::AutoLocker l(_spinLock);
+        _spinControl.setCommand(nextCommand);
+    }
 }
 
-u_result RPlidarDriverImplCommon::_cacheCapsuledScanData()
+u_result RPlidarDriverImplCommon::_startCaching(cache_step_t step, _u16 sampleDuration_us)
 {
-    rplidar_response_capsule_measurement_nodes_t    capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
+    _cached_scan.back().count = 0;
+    _rxRing.reset();
+    _sampleDuration_us = sampleDuration_us;
+    {
+        rp::hal::AutoLocker l(_deviceClockLock);
+        _deviceClock.reset();
+    }
+    {
+        rp::hal::AutoLocker l(_spinLock);
+        _spinControl.restart();
+    }
+    _cacheStep = step;
+    _isFirstFrame = true;
+    _isScanning = true;
 
-    _waitCapsuledNode(capsule_node); // // always discard the first data since it may be incomplete
+    if (_reactor) {
+        u_result ans = _reactor->beginScan(this, _chanDev->getPollHandle());
+        if (IS_FAIL(ans)) _isScanning = false;
+        return ans;
+    }
 
-    
-    
+    _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheThreadProc);
+    if (_cachethread.getHandle() == 0) {
+        _isScanning = false;
+        return RESULT_OPERATION_FAIL;
+    }
 
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitCapsuledNode(capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
-        }
-        switch (_cached_express_flag) 
-        {
-        case 0:
-            _capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        case 1:
-            _dense_capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        }
-        //
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
+    // a refusal leaves the thread at the default scheduling, the scan still runs
+    if (_hasCacheThreadAttributes) _cacheThreadAttributesResult = applyThreadAttributes(_cachethread, _cacheThreadAttributes);
+    return RESULT_OK;
+}
 
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
+u_result RPlidarDriverImplCommon::_cacheThreadProc()
+{
+    while (_isScanning) {
+        u_result ans = (this->*_cacheStep)(DEFAULT_TIMEOUT);
+        if (IS_FAIL(ans) && ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
+            _isScanning = false;
+            return RESULT_OPERATION_FAIL;
         }
     }
-    _isScanning = false;
-
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_cacheUltraCapsuledScanData()
+bool RPlidarDriverImplCommon::pumpScanData()
 {
-    rplidar_response_ultra_capsule_measurement_nodes_t    ultra_capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitUltraCapsuledNode(ultra_capsule_node);
-    
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitUltraCapsuledNode(ultra_capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
+    while (_isScanning) {
+        u_result ans = (this->*_cacheStep)(0);
+        if (ans == RESULT_OPERATION_TIMEOUT) {
+            // all received data is decoded, wait for the channel to turn readable again
+            return true;
         }
-        
-        _ultraCapsuleToNormal(ultra_capsule_node, local_buf, count);
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
-
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
+        if (IS_FAIL(ans) && ans != RESULT_INVALID_DATA) {
+            _isScanning = false;
         }
     }
-    
-    _isScanning = false;
+    return false;
+}
+
+u_result RPlidarDriverImplCommon::setReactor(RPlidarReactor * reactor)
+{
+    // the running scan keeps the threads it was started on
+    if (_isScanning) return RESULT_OPERATION_FAIL;
 
+    if (_reactor) _reactor->detach();
+    _reactor = static_cast<RPlidarReactorImpl *>(reactor);
+    if (_reactor) _reactor->attach();
     return RESULT_OK;
 }
 
-void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+u_result RPlidarDriverImplCommon::setCacheThreadAttributes(const RplidarThreadAttributes & attributes)
 {
-    nodeCount = 0;
-    if (_is_previous_capsuledataRdy) {
-        int diffAngle_q8;
-        int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF)<< 2);
-        int prevStartAngle_q8 = ((_cached_previous_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+    if (attributes.policy > THREAD_POLICY_RR) return RESULT_INVALID_DATA;
 
-        diffAngle_q8 = (currentStartAngle_q8) - (prevStartAngle_q8);
-        if (prevStartAngle_q8 >  currentStartAngle_q8) {
-            diffAngle_q8 += (360<<8);
-        }
+    _cacheThreadAttributes = attributes;
+    _hasCacheThreadAttributes = true;
 
-        int angleInc_q16 = (diffAngle_q8 << 3);
-        int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_capsuledata.cabins); ++pos)
-        {
-            int dist_q2[2];
-            int angle_q6[2];
-            int syncBit[2];
+    if (!_isScanning || !_cachethread.getHandle()) return RESULT_OK;
+    _cacheThreadAttributesResult = applyThreadAttributes(_cachethread, attributes);
+    return _cacheThreadAttributesResult;
+}
 
-            dist_q2[0] = (_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0xFFFC);
-            dist_q2[1] = (_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0xFFFC);
+u_result RPlidarDriverImplCommon::getCacheThreadAttributesResult()
+{
+    return _cacheThreadAttributesResult;
+}
 
-            int angle_offset1_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 & 0xF) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0x3)<<4));
-            int angle_offset2_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 >> 4) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0x3)<<4));
+u_result RPlidarDriverImplCommon::_cacheScanData(_u32 timeout)
+{
+    rplidar_response_measurement_node_t      local_buf[128];
+    size_t                                   count = 128;
+    rplidar_response_measurement_node_hq_t   local_hq_buf[128];
 
-            angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3<<13))>>10);
-            syncBit[0] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
-            currentAngle_raw_q16 += angleInc_q16;
+    // a timed out wait still caches the nodes received until then
+    u_result ans = _waitScanData(local_buf, count, timeout);
+    if (IS_FAIL(ans) && ans != RESULT_OPERATION_TIMEOUT) {
+        return ans;
+    }
 
+    if (_isFirstFrame) {
+        // always discard the first data since it may be incomplete
+        if (count) _isFirstFrame = false;
+        return ans;
+    }
 
-            angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3<<13))>>10);
-            syncBit[1] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
-            currentAngle_raw_q16 += angleInc_q16;
+    for (size_t pos = 0; pos < count; ++pos)
+    {
+        convert(local_buf[pos], local_hq_buf[pos]);
+    }
+    _cacheScanNodes(local_hq_buf, count, _estimateBatchStart(count, 0));
+    return ans;
+}
 
-            for (int cpos = 0; cpos < 2; ++cpos) {
+u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
+{
+    u_result ans;
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+    if (_isScanning) return RESULT_ALREADY_DONE;
 
-                if (angle_q6[cpos] < 0) angle_q6[cpos] += (360<<6);
-                if (angle_q6[cpos] >= (360<<6)) angle_q6[cpos] -= (360<<6);
+    stop(); //force the previous operation to stop
 
-                rplidar_response_measurement_node_hq_t node;
+    {
+        rp::hal::AutoLocker l(_lock);
 
-                node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
-                node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
-                node.quality = dist_q2[cpos] ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                node.dist_mm_q2 = dist_q2[cpos];
+        if (IS_FAIL(ans = _sendCommand(force?RPLIDAR_CMD_FORCE_SCAN:RPLIDAR_CMD_SCAN))) {
+            return ans;
+        }
 
-                nodebuffer[nodeCount++] = node;
-             }
+        // waiting for confirmation
+        rplidar_ans_header_t response_header;
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+            return ans;
+        }
 
+        // verify whether we got a correct header
+        if (response_header.type != RPLIDAR_ANS_TYPE_MEASUREMENT) {
+            return RESULT_INVALID_DATA;
         }
-    }
 
-    _cached_previous_capsuledata = capsule;
-    _is_previous_capsuledataRdy = true;
+        _u32 header_size = (response_header.size_q30_subtype & RPLIDAR_ANS_HEADER_SIZE_MASK);
+        if (header_size < sizeof(rplidar_response_measurement_node_t)) {
+            return RESULT_INVALID_DATA;
+        }
+
+        _lastRxMs = getms();
+        if (IS_FAIL(ans = _startCaching(&RPlidarDriverImplCommon::_cacheScanData, _cached_sampleduration_std))) {
+            return ans;
+        }
+
+        if (IS_FAIL(ans = _startScanListenerThread())) {
+            return ans;
+        }
+    }
+    return RESULT_OK;
 }
 
-void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+u_result RPlidarDriverImplCommon::checkExpressScanSupported(bool & support, _u32 timeout)
 {
-    const rplidar_response_dense_capsule_measurement_nodes_t *dense_capsule = reinterpret_cast<const rplidar_response_dense_capsule_measurement_nodes_t*>(&capsule);
-    nodeCount = 0;
-    if (_is_previous_capsuledataRdy) {
-        int diffAngle_q8;
-        int currentStartAngle_q8 = ((dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
-        int prevStartAngle_q8 = ((_cached_previous_dense_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+    DEPRECATED_WARN("checkExpressScanSupported(bool&,_u32)", "getAllSupportedScanModes()");
 
-        diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
-        if (prevStartAngle_q8 >  currentStartAngle_q8) {
-            diffAngle_q8 += (360 << 8);
-        }
+    rplidar_response_device_info_t devinfo;
 
-        int angleInc_q16 = (diffAngle_q8 << 8)/40;
-        int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos)
-        {
-            int dist_q2;
-            int angle_q6;
-            int syncBit;
-            const int dist = static_cast<const int>(_cached_previous_dense_capsuledata.cabins[pos].distance);
-            dist_q2 = dist << 2;
-            angle_q6 = (currentAngle_raw_q16 >> 10);
-            syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-            currentAngle_raw_q16 += angleInc_q16;
+    support = false;
+    u_result ans = getDeviceInfo(devinfo, timeout);
 
-            if (angle_q6 < 0) angle_q6 += (360 << 6);
-            if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
+    if (IS_FAIL(ans)) return ans;
 
-            
+    if (devinfo.firmware_version >= ((0x1<<8) | 17)) {
+        support = true;
+        rplidar_response_sample_rate_t sample_rate;
+        getSampleDuration_uS(sample_rate);
+        _cached_sampleduration_express = sample_rate.express_sample_duration_us;
+        _cached_sampleduration_std = sample_rate.std_sample_duration_us;
+    }
 
-            rplidar_response_measurement_node_hq_t node;
+    return RESULT_OK;
+}
 
-            node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
-            node.flag = (syncBit | ((!syncBit) << 1));
-            node.quality = dist_q2 ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-            node.dist_mm_q2 = dist_q2;
+u_result RPlidarDriverImplCommon::_cacheCapsuledScanData(_u32 timeout)
+{
+    const rplidar_response_capsule_measurement_nodes_t * capsule_node;
+    rplidar_response_measurement_node_hq_t   local_buf[128];
+    size_t                                   count = 128;
+    u_result                                 ans;
 
-            nodebuffer[nodeCount++] = node;
-            
+    if (IS_FAIL(ans=_waitCapsuledNode(capsule_node, timeout))) {
+        // current data is invalid, do not use it.
+        if (ans != RESULT_OPERATION_TIMEOUT) _isFirstFrame = false;
+        return ans;
+    }
+    if (_isFirstFrame) {
+        // always discard the first data since it may be incomplete
+        _isFirstFrame = false;
+        return RESULT_OK;
+    }
 
-        }
+    switch (_cached_express_flag) 
+    {
+    case 0:
+        _capsuleToNormal(*capsule_node, local_buf, count);
+        break;
+    case 1:
+        _dense_capsuleToNormal(*capsule_node, local_buf, count);
+        break;
     }
 
-    _cached_previous_dense_capsuledata = *dense_capsule;
-    _is_previous_capsuledataRdy = true;
+    // the capsule just received holds the samples taken after the decoded ones
+    _cacheScanNodes(local_buf, count, _estimateBatchStart(count, count));
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_cacheHqScanData()
+u_result RPlidarDriverImplCommon::_cacheUltraCapsuledScanData(_u32 timeout)
 {
-    rplidar_response_hq_capsule_measurement_nodes_t    hq_node;
+    const rplidar_response_ultra_capsule_measurement_nodes_t * ultra_capsule_node;
     rplidar_response_measurement_node_hq_t   local_buf[128];
     size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
     u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-    _waitHqNode(hq_node);
-    while (_isScanning) {
-        if (IS_FAIL(ans = _waitHqNode(hq_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            }
-            else {
-				// current data is invalid, do not use it.
-				continue;
-            }
-        }
-
-        _HqToNormal(hq_node, local_buf, count);
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-				// only publish the data when it contains a full 360 degree scan 
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-																	 //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-            }
-        }
 
+    if (IS_FAIL(ans=_waitUltraCapsuledNode(ultra_capsule_node, timeout))) {
+        // current data is invalid, do not use it.
+        if (ans != RESULT_OPERATION_TIMEOUT) _isFirstFrame = false;
+        return ans;
+    }
+    if (_isFirstFrame) {
+        _isFirstFrame = false;
+        return RESULT_OK;
     }
+
+    _ultraCapsuleToNormal(*ultra_capsule_node, local_buf, count);
+
+    // the capsule just received holds the samples taken after the decoded ones
+    _cacheScanNodes(local_buf, count, _estimateBatchStart(count, count));
     return RESULT_OK;
 }
 
-//CRC calculate
-static _u32 table[256];//crc32_table
-
-//reflect
-static _u32 _bitrev(_u32 input, _u16 bw)
+void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
 {
-    _u16 i;
-    _u32 var;
-    var = 0;
-    for (i = 0; i<bw; i++){
-        if (input & 0x01)
-        {
-            var |= 1 << (bw - 1 - i);
-        }
-        input >>= 1;
+    nodeCount = 0;
+    if (_is_previous_capsuledataRdy) {
+        nodeCount = CapsuleDecoder::decodeCapsule(_cached_previous_capsuledata, capsule, nodebuffer);
     }
-    return var;
+
+    _cached_previous_capsuledata = capsule;
+    _is_previous_capsuledataRdy = true;
 }
 
-// crc32_table init
-static void _crc32_init(_u32 poly)
+void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
 {
-    _u16 i;
-    _u16 j;
-    _u32 c;
-    
-    poly = _bitrev(poly, 32);
-    for (i = 0; i<256; i++){
-        c = i;
-        for (j = 0; j<8; j++){
-            if (c & 1)
-                c = poly ^ (c >> 1);
-            else
-                c = c >> 1;
-        }
-        table[i] = c;
+    const rplidar_response_dense_capsule_measurement_nodes_t *dense_capsule = reinterpret_cast<const rplidar_response_dense_capsule_measurement_nodes_t*>(&capsule);
+    nodeCount = 0;
+    if (_is_previous_capsuledataRdy) {
+        nodeCount = CapsuleDecoder::decodeDenseCapsule(_cached_previous_dense_capsuledata, *dense_capsule, nodebuffer);
     }
+
+    _cached_previous_dense_capsuledata = *dense_capsule;
+    _is_previous_capsuledataRdy = true;
 }
 
-static _u32 _crc32cal(_u32 crc, void* input, _u16 len)
+u_result RPlidarDriverImplCommon::_cacheHqScanData(_u32 timeout)
 {
-    _u16 i;
-    _u8 index;
-    _u8* pch;
-    pch = (unsigned char*)input;
-    _u8 leftBytes = 4 - len & 0x3;
+    const rplidar_response_hq_capsule_measurement_nodes_t * hq_node;
+    u_result                                 ans;
 
-    for (i = 0; i<len; i++){
-        index = (unsigned char)(crc^*pch);
-        crc = (crc >> 8) ^ table[index];
-        pch++;
+    if (IS_FAIL(ans = _waitHqNode(hq_node, timeout))) {
+        // current data is invalid, do not use it.
+        if (ans != RESULT_OPERATION_TIMEOUT) _isFirstFrame = false;
+        return ans;
     }
-
-    for (i = 0; i < leftBytes; i++) {//zero padding
-        index = (unsigned char)(crc^0);
-        crc = (crc >> 8) ^ table[index];
+    if (_isFirstFrame) {
+        _isFirstFrame = false;
+        return RESULT_OK;
     }
-    return crc^0xffffffff;
-}
 
-//crc32cal
-static u_result _crc32(_u8 *ptr, _u32 len) {
-	static _u8 tmp;
-	if (tmp != 1) {
-		_crc32_init(0x4C11DB7);
-		tmp = 1;
-	}
-	
-	return _crc32cal(0xFFFFFFFF, ptr,len);
+    // the HQ capsule already carries node_hq records, append them straight
+    // from the receive ring; the frame stays valid until the next read
+    _u64 firstNodeTs_us;
+    {
+        // the capsule's time stamp belongs to its first node
+        rp::hal::AutoLocker l(_deviceClockLock);
+        _deviceClock.addSample(hq_node->time_stamp, _estimateBatchStart(_countof(hq_node->node_hq), 0));
+        firstNodeTs_us = _deviceClock.toHost(hq_node->time_stamp);
+    }
+    _cacheScanNodes(hq_node->node_hq, _countof(hq_node->node_hq), firstNodeTs_us);
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitHqNode(const rplidar_response_hq_capsule_measurement_nodes_t * & node, _u32 timeout)
 {
     if (!_isConnected) {
         return RESULT_OPERATION_FAIL;
     }
 
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_hq_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
-        
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-    
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync byte
-                {
-                    _u8 tmp = (currentByte);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_HQ_SYNC ) {
-                    // pass
-                    }
-                    else {
-                        recvPos = 0;
-                        _is_previous_HqdataRdy = false;
-                        continue;
-                    }
-                }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1 - 4: 
-            {
-
-            }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1: 
-            {				
-
-            }
-           break;
-           }
-           nodeBuffer[recvPos++] = currentByte;
-           if (recvPos == sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
-                _u32 crcCalc2 = _crc32(nodeBuffer, sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 4);
-
-                if(crcCalc2 == node.crc32){
-                    _is_previous_HqdataRdy = true;
-                    return RESULT_OK;
-                }
-                else {
-                    _is_previous_HqdataRdy = false;
-                    return RESULT_INVALID_DATA;
-                }
+    const _u8 * frame;
+    bool afterGap;
 
-            }
-        }
+    u_result ans = _waitFrame(sizeof(rplidar_response_hq_capsule_measurement_nodes_t), _isHqCapsuleSync, frame, afterGap, timeout);
+    if (IS_FAIL(ans)) {
+        return ans;
     }
-    _is_previous_HqdataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
-}
 
-void RPlidarDriverImplCommon::_HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount) 
-{
-    nodeCount = 0;
-    if (_is_previous_HqdataRdy) {
-        for (size_t pos = 0; pos < _countof(_cached_previous_Hqdata.node_hq); ++pos)
-        {
-            nodebuffer[nodeCount++] = node_hq.node_hq[pos];
-        }	
+    node = reinterpret_cast<const rplidar_response_hq_capsule_measurement_nodes_t *>(frame);
+
+    // validate the capsule in place
+    _u32 crcCalc = rp::hal::crc32_padded(frame, sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - sizeof(node->crc32));
+    if (crcCalc != node->crc32) {
+        _discardFrame();
+        return RESULT_INVALID_DATA;
     }
-    _cached_previous_Hqdata = node_hq;
-    _is_previous_HqdataRdy = true;
+    _rxRing.consume(sizeof(rplidar_response_hq_capsule_measurement_nodes_t));
 
+    return RESULT_OK;
 }
-//*******************************************HQ support********************************//
 
-static _u32 _varbitscale_decode(_u32 scaled, _u32 & scaleLevel)
-{
-    static const _u32 VBS_SCALED_BASE[] = {
-        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
-        0,
-    };
-
-    static const _u32 VBS_SCALED_LVL[] = {
-        4,
-        3,
-        2,
-        1,
-        0,
-    };
-
-    static const _u32 VBS_TARGET_BASE[] = {
-        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
-        0,
-    };
-
-    for (size_t i = 0; i < _countof(VBS_SCALED_BASE); ++i)
-    {
-        int remain = ((int)scaled - (int)VBS_SCALED_BASE[i]);
-        if (remain >= 0) {
-            scaleLevel = VBS_SCALED_LVL[i];
-            return VBS_TARGET_BASE[i] + (remain << scaleLevel);
-        }
-    }
-    return 0;
-}
+//*******************************************HQ support********************************//
 
 void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
 {
     nodeCount = 0;
     if (_is_previous_capsuledataRdy) {
-        int diffAngle_q8;
-        int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 2);
-        int prevStartAngle_q8 = ((_cached_previous_ultracapsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
-
-        diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
-        if (prevStartAngle_q8 >  currentStartAngle_q8) {
-            diffAngle_q8 += (360 << 8);
-        }
-
-        int angleInc_q16 = (diffAngle_q8 << 3) / 3;
-        int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_ultracapsuledata.ultra_cabins); ++pos)
-        {
-            int dist_q2[3];
-            int angle_q6[3];
-            int syncBit[3];
-
-
-            _u32 combined_x3 = _cached_previous_ultracapsuledata.ultra_cabins[pos].combined_x3;
-
-            // unpack ...
-            int dist_major = (combined_x3 & 0xFFF);
-
-            // signed partical integer, using the magic shift here
-            // DO NOT TOUCH
-
-            int dist_predict1 = (((int)(combined_x3 << 10)) >> 22);
-            int dist_predict2 = (((int)combined_x3) >> 22);
-
-            int dist_major2;
-
-            _u32 scalelvl1, scalelvl2;
-
-            // prefetch next ...
-            if (pos == _countof(_cached_previous_ultracapsuledata.ultra_cabins) - 1)
-            {
-                dist_major2 = (capsule.ultra_cabins[0].combined_x3 & 0xFFF);
-            }
-            else {
-                dist_major2 = (_cached_previous_ultracapsuledata.ultra_cabins[pos + 1].combined_x3 & 0xFFF);
-            }
-
-            // decode with the var bit scale ...
-            dist_major = _varbitscale_decode(dist_major, scalelvl1);
-            dist_major2 = _varbitscale_decode(dist_major2, scalelvl2);
-
-
-            int dist_base1 = dist_major;
-            int dist_base2 = dist_major2;
-
-            if ((!dist_major) && dist_major2) {
-                dist_base1 = dist_major2;
-                scalelvl1 = scalelvl2;
-            }
-
-           
-            dist_q2[0] = (dist_major << 2);
-            if ((dist_predict1 == 0xFFFFFE00) || (dist_predict1 == 0x1FF)) {
-                dist_q2[1] = 0;
-            } else {
-                dist_predict1 = (dist_predict1 << scalelvl1);
-                dist_q2[1] = (dist_predict1 + dist_base1) << 2;
-
-            }
-
-            if ((dist_predict2 == 0xFFFFFE00) || (dist_predict2 == 0x1FF)) {
-                dist_q2[2] = 0;
-            } else {
-                dist_predict2 = (dist_predict2 << scalelvl2);
-                dist_q2[2] = (dist_predict2 + dist_base2) << 2;
-            }
-           
-
-            for (int cpos = 0; cpos < 3; ++cpos)
-            {
-
-                syncBit[cpos] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-
-                int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
-
-                if (dist_q2[cpos] >= (50 * 4))
-                {
-                    const int k1 = 98361;
-                    const int k2 = int(k1 / dist_q2[cpos]);
-
-                    offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
-                }
-
-                angle_q6[cpos] = ((currentAngle_raw_q16 - int(offsetAngleMean_q16 * 180 / 3.14159265)) >> 10);
-                currentAngle_raw_q16 += angleInc_q16;
-
-                if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
-                if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
-
-                rplidar_response_measurement_node_hq_t node;
-
-                node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
-                node.quality = dist_q2[cpos] ? (0x2F << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
-                node.dist_mm_q2 = dist_q2[cpos];
-
-                nodebuffer[nodeCount++] = node;
-            }
-
-        }
+        nodeCount = CapsuleDecoder::decodeUltraCapsule(_cached_previous_ultracapsuledata, capsule, nodebuffer);
     }
 
     _cached_previous_ultracapsuledata = capsule;
@@ -1287,6 +1155,10 @@ u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outp
     if (sizeVec > 0)
         memcpy(query.reserved, &reserve[0], reserve.size());
 
+    if (_capabilityCache.getLidarConf(type, reserve, outputBuf)) {
+        return RESULT_OK;
+    }
+
     u_result ans;
     {
         rp::hal::AutoLocker l(_lock);
@@ -1336,6 +1208,7 @@ u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outp
         outputBuf.resize(payLoadLen);
         memcpy(&outputBuf[0], &dataBuf[0] + sizeof(type), payLoadLen);
     }
+    _capabilityCache.setLidarConf(type, reserve, outputBuf);
     return ans;
 }
 
@@ -1729,6 +1602,7 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
         }
 
         _u32 header_size = (response_header.size_q30_subtype & RPLIDAR_ANS_HEADER_SIZE_MASK);
+        _lastRxMs = getms();
 
         if (scanAnsType == RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED)
         {
@@ -1736,8 +1610,7 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
                 return RESULT_INVALID_DATA;
             }
             _cached_express_flag = 0;
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheCapsuledScanData);
+            ans = _startCaching(&RPlidarDriverImplCommon::_cacheCapsuledScanData, _cached_sampleduration_express);
         }
         else if (scanAnsType == RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED)
         {
@@ -1745,123 +1618,385 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
                 return RESULT_INVALID_DATA;
             }
             _cached_express_flag = 1;
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheCapsuledScanData);
+            ans = _startCaching(&RPlidarDriverImplCommon::_cacheCapsuledScanData, _cached_sampleduration_express);
         }
         else if (scanAnsType == RPLIDAR_ANS_TYPE_MEASUREMENT_HQ) {
             if (header_size < sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
                 return RESULT_INVALID_DATA;
             }
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheHqScanData);
+            ans = _startCaching(&RPlidarDriverImplCommon::_cacheHqScanData, _cached_sampleduration_express);
         }
         else
         {
             if (header_size < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
                 return RESULT_INVALID_DATA;
             }
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheUltraCapsuledScanData);
+            ans = _startCaching(&RPlidarDriverImplCommon::_cacheUltraCapsuledScanData, _cached_sampleduration_express);
+        }
+
+        if (IS_FAIL(ans)) {
+            return ans;
+        }
+
+        if (IS_FAIL(ans = _startScanListenerThread())) {
+            return ans;
+        }
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::startScanAuto(_u32 decodeBudgetPercent, RplidarScanModeSelection * outSelection, _u32 timeout)
+{
+    u_result ans;
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+    if (_isScanning) return RESULT_ALREADY_DONE;
+
+    bool ifSupportLidarConf = false;
+    ans = checkSupportConfigCommands(ifSupportLidarConf);
+    if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
+
+    // without a mode table the typical mode is the only candidate, startScan picks it
+    std::vector<RplidarScanMode> ranked(1);
+    if (ifSupportLidarConf) {
+        std::vector<RplidarScanMode> modes;
+        if (IS_FAIL(ans = getAllSupportedScanModes(modes))) return ans;
+        if (modes.empty()) return RESULT_INVALID_DATA;
+
+        ScanModeSelector::rankModes(modes, decodeBudgetPercent / 100.0f, ranked);
+    }
+
+    // the listener thread consumes the scans, none can be grabbed to check a mode
+    if (_isScanListenerThreaded) ranked.resize(1);
+
+    RplidarScanModeSelection best;
+    bool hasBest = false;
+    u_result failure = RESULT_OPERATION_TIMEOUT;
+    for (size_t pos = 0; pos < ranked.size(); ++pos) {
+        RplidarScanModeSelection selection;
+        ans = _startScanInMode(ifSupportLidarConf, ranked[pos].id, selection, timeout);
+
+        // a mode the host or the link falls too far behind on may not complete a single
+        // revolution, and one the device refuses to start still leaves the others
+        if (IS_FAIL(ans)) {
+            if (ans != RESULT_OPERATION_TIMEOUT && failure == RESULT_OPERATION_TIMEOUT) failure = ans;
+            continue;
+        }
+
+        bool isBest = !hasBest || (selection.delivered_ratio > best.delivered_ratio);
+        if (isBest) {
+            best = selection;
+            hasBest = true;
+        }
+
+        // keep it running when nothing better is left to restart
+        if (selection.verified || (isBest && pos + 1 == ranked.size())) {
+            if (outSelection) *outSelection = selection;
+            return RESULT_OK;
+        }
+        stop();
+    }
+    if (!hasBest) return failure;
+
+    if (IS_FAIL(ans = _startScanInMode(ifSupportLidarConf, best.mode.id, best, timeout))) return ans;
+    if (outSelection) *outSelection = best;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_startScanInMode(bool hasModeTable, _u16 modeId, RplidarScanModeSelection & selection, _u32 timeout)
+{
+    u_result ans;
+    if (hasModeTable) {
+        ans = startScanExpress(false, modeId, 0, &selection.mode, timeout);
+    } else {
+        ans = startScan(false, true, 0, &selection.mode);
+    }
+    if (IS_FAIL(ans)) return ans;
+
+    selection.decode_us_per_sample = ScanModeSelector::decodeCostUs(selection.mode.ans_type);
+    selection.decode_load = ScanModeSelector::decodeLoad(selection.mode);
+
+    if (IS_FAIL(ans = _verifyScanRate(selection, timeout))) {
+        stop();
+    }
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::_verifyScanRate(RplidarScanModeSelection & selection, _u32 timeout)
+{
+    selection.frequency = 0;
+    selection.delivered_ratio = 0;
+    selection.verified = false;
+
+    // the listener thread consumes the scans
+    if (_isScanListenerThreaded) return RESULT_OK;
+
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(_scanCapacity);
+    _u64 firstSampleUs = 0;
+    _u64 scannedUs = 0;
+    float sampledUs = 0;
+    size_t totalCount = 0;
+
+    // the first revolution after the start may be partial and is skipped, the scan
+    // after the checked ones only gives the time the last checked one ended
+    for (int scan = -1; scan <= AUTO_SCAN_VERIFY_SCANS; ++scan) {
+        size_t count = nodes.size();
+        u_result ans = grabScanDataHq(&nodes[0], count, timeout);
+        if (IS_FAIL(ans)) return ans;
+        if (scan < 0) continue;
+
+        RplidarScanTimestamp timestamp;
+        getGrabbedScanTimestamp(timestamp);
+
+        if (scan > 0) {
+            scannedUs += timestamp.first_sample_us - firstSampleUs;
+        }
+        if (scan < AUTO_SCAN_VERIFY_SCANS) {
+            sampledUs += count * selection.mode.us_per_sample;
+            totalCount += count;
+        }
+        firstSampleUs = timestamp.first_sample_us;
+    }
+
+    getFrequency(selection.mode, (totalCount + AUTO_SCAN_VERIFY_SCANS / 2) / AUTO_SCAN_VERIFY_SCANS, selection.frequency);
+    if (scannedUs) selection.delivered_ratio = sampledUs / scannedUs;
+    selection.verified = (selection.delivered_ratio * 100 >= AUTO_SCAN_MIN_DELIVERED_PERCENT);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+{
+    u_result ans;
+    _disableDataGrabbing();
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
+            return ans;
+        }
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_waitScanPublished(_u32 timeout)
+{
+    _u32 startTs = getms();
+    _u32 waitTime;
+
+    for (;;) {
+        // the event may still be signalled for a scan that has already been fetched
+        if (_cached_scan.fetch()) {
+            return RESULT_OK;
+        }
+
+        waitTime = getms() - startTs;
+        if (waitTime > timeout) {
+            return RESULT_OPERATION_TIMEOUT;
+        }
+
+        switch (_dataEvt.wait(timeout - waitTime))
+        {
+        case rp::hal::Event::EVENT_TIMEOUT:
+            return RESULT_OPERATION_TIMEOUT;
+        case rp::hal::Event::EVENT_OK:
+            break;
+        default:
+            return RESULT_OPERATION_FAIL;
         }
+    }
+}
+
+u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+{
+    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+
+    if (_isScanListenerThreaded) {
+        // the listener thread consumes the scans
+        count = 0;
+        return RESULT_OPERATION_NOT_SUPPORT;
+    }
 
-        if (_cachethread.getHandle() == 0) {
-            return RESULT_OPERATION_FAIL;
-        }
+    rp::hal::AutoLocker l(_grabLock);
+
+    u_result ans = _waitScanPublished(timeout);
+    if (IS_FAIL(ans)) {
+        count = 0;
+        return ans;
     }
+
+    const scan_slot_t & scan = _cached_scan.front();
+    size_t size_to_copy = min(count, scan.count);
+
+    for (size_t i = 0; i < size_to_copy; i++)
+        convert(scan.nodes[i], nodebuffer[i]);
+
+    count = size_to_copy;
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t* nodebuffer, size_t& count, _u32 timeout)
 {
-    u_result ans;
-    _disableDataGrabbing();
+    if (_isScanListenerThreaded) {
+        // the listener thread consumes the scans
+        count = 0;
+        return RESULT_OPERATION_NOT_SUPPORT;
+    }
 
-    {
-        rp::hal::AutoLocker l(_lock);
+    rp::hal::AutoLocker l(_grabLock);
 
-        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
-            return ans;
-        }
+    u_result ans = _waitScanPublished(timeout);
+    if (IS_FAIL(ans)) {
+        count = 0;
+        return ans;
     }
+
+    const scan_slot_t & scan = _cached_scan.front();
+    size_t size_to_copy = min(count, scan.count);
+    memcpy(nodebuffer, scan.nodes, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+
+    count = size_to_copy;
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::grabScanDataHqNoCopy(const rplidar_response_measurement_node_hq_t * & nodebuffer, size_t & count, _u32 timeout)
 {
-    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+    if (_isScanListenerThreaded) {
+        // the listener thread consumes the scans
+        count = 0;
+        return RESULT_OPERATION_NOT_SUPPORT;
+    }
 
-    switch (_dataEvt.wait(timeout))
-    {
-    case rp::hal::Event::EVENT_TIMEOUT:
+    rp::hal::AutoLocker l(_grabLock);
+
+    u_result ans = _waitScanPublished(timeout);
+    if (IS_FAIL(ans)) {
         count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-        {
-            if(_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+        return ans;
+    }
 
-            rp::hal::AutoLocker l(_lock);
+    // the front buffer is only replaced by the next fetch on the consumer side
+    const scan_slot_t & scan = _cached_scan.front();
+    nodebuffer = scan.nodes;
+    count = scan.count;
+    return RESULT_OK;
+}
 
-            size_t size_to_copy = min(count, _cached_scan_node_hq_count);
+u_result RPlidarDriverImplCommon::grabScanLease(ScanLease & lease, _u32 timeout)
+{
+    lease.release();
 
-            for (size_t i = 0; i < size_to_copy; i++)
-                convert(_cached_scan_node_hq_buf[i], nodebuffer[i]);
+    if (_isScanListenerThreaded) {
+        // the listener thread consumes the scans
+        return RESULT_OPERATION_NOT_SUPPORT;
+    }
 
-            count = size_to_copy;
-            _cached_scan_node_hq_count = 0;
-        }
-        return RESULT_OK;
+    rp::hal::AutoLocker l(_grabLock);
 
-    default:
-        count = 0;
-        return RESULT_OPERATION_FAIL;
+    // only allocated once somebody actually uses leases
+    if (!_scanPool) {
+        _scanPool = new ScanPool(SCAN_LEASE_POOL_SIZE, _scanCapacity);
     }
+
+    ScanLease::Block * block = _scanPool->acquire();
+    if (!block) {
+        return RESULT_INSUFFICIENT_MEMORY;
+    }
+    // the lease owns the reference from here on, failing below returns the block
+    ScanLease newLease(block);
+
+    u_result ans = _waitScanPublished(timeout);
+    if (IS_FAIL(ans)) {
+        return ans;
+    }
+
+    const scan_slot_t & scan = _cached_scan.front();
+    memcpy(block->nodes, scan.nodes, scan.count * sizeof(rplidar_response_measurement_node_hq_t));
+    block->count = scan.count;
+    block->timestamp = scan.timestamp;
+
+    lease = newLease;
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t* nodebuffer, size_t& count, _u32 timeout)
+u_result RPlidarDriverImplCommon::getGrabbedScanTimestamp(RplidarScanTimestamp & timestamp)
 {
-    switch (_dataEvt.wait(timeout))
-    {
-    case rp::hal::Event::EVENT_TIMEOUT:
-        count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-    {
-        if (_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+    rp::hal::AutoLocker l(_grabLock);
 
-        rp::hal::AutoLocker l(_lock);
+    const scan_slot_t & scan = _cached_scan.front();
+    if (!scan.count) {
+        return RESULT_OPERATION_FAIL;
+    }
+    timestamp = scan.timestamp;
+    return RESULT_OK;
+}
 
-        size_t size_to_copy = min(count, _cached_scan_node_hq_count);
-        memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+u_result RPlidarDriverImplCommon::mapDeviceTimeToHost(_u64 device_us, _u64 & host_us)
+{
+    rp::hal::AutoLocker l(_deviceClockLock);
 
-        count = size_to_copy;
-        _cached_scan_node_hq_count = 0;
+    if (!_deviceClock.isSynced()) {
+        return RESULT_OPERATION_FAIL;
     }
+    host_us = _deviceClock.toHost(device_us);
     return RESULT_OK;
+}
 
-    default:
-        count = 0;
+u_result RPlidarDriverImplCommon::setScanListener(ScanListener * listener, _u32 sectorCount, _u32 flags)
+{
+    if (_isScanning) return RESULT_OPERATION_FAIL;
+    if ((sectorCount && sectorCount < 3) || sectorCount > _scanCapacity) return RESULT_INVALID_DATA;
+
+    _scanListener = listener;
+    _scanListenerSectors = listener ? sectorCount : 0;
+    _isScanListenerThreaded = listener && (flags & SCAN_LISTENER_FLAG_CONSUMER_THREAD);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_startScanListenerThread()
+{
+    if (!_isScanListenerThreaded) return RESULT_OK;
+
+    _listenerthread = CLASS_THREAD(RPlidarDriverImplCommon, _scanListenerThreadProc);
+    if (_listenerthread.getHandle() == 0) {
         return RESULT_OPERATION_FAIL;
     }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_scanListenerThreadProc()
+{
+    while (_isScanning) {
+        // scans published while onScan is busy are overwritten, only the latest one is delivered
+        if (IS_FAIL(_waitScanPublished(DEFAULT_TIMEOUT))) {
+            continue;
+        }
+
+        const scan_slot_t & scan = _cached_scan.front();
+        _scanListener->onScan(scan.nodes, scan.count, scan.timestamp);
+    }
+    return RESULT_OK;
 }
 
 u_result RPlidarDriverImplCommon::getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count)
 {
     DEPRECATED_WARN("getScanDataWithInterval(rplidar_response_measurement_node_t*, size_t&)", "getScanDataWithInterval(rplidar_response_measurement_node_hq_t*, size_t&)");
 
+    rplidar_response_measurement_node_hq_t local_buf[128];
     size_t size_to_copy = 0;
+
+    //copy all the nodes held by _cached_scan_node_hq_for_interval_retrieve at the time of the call
+    size_t available = _cached_scan_node_hq_for_interval_retrieve.size();
+    while (size_to_copy < available)
     {
-        rp::hal::AutoLocker l(_lock);
-        if(_cached_scan_node_hq_count_for_interval_retrieve == 0)
-        {
-            return RESULT_OPERATION_TIMEOUT; 
-        }
-        //copy all the nodes(_cached_scan_node_count_for_interval_retrieve nodes) in _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = _cached_scan_node_hq_count_for_interval_retrieve;
-        for (size_t i = 0; i < size_to_copy; i++)
+        size_t popped = _cached_scan_node_hq_for_interval_retrieve.pop(local_buf, min(available - size_to_copy, _countof(local_buf)));
+        for (size_t i = 0; i < popped; i++)
         {
-            convert(_cached_scan_node_hq_buf_for_interval_retrieve[i], nodebuffer[i]);
+            convert(local_buf[i], nodebuffer[size_to_copy++]);
         }
-        _cached_scan_node_hq_count_for_interval_retrieve = 0;
+    }
+    if (size_to_copy == 0)
+    {
+        return RESULT_OPERATION_TIMEOUT; 
     }
     count = size_to_copy;
 
@@ -1875,115 +2010,62 @@ u_result RPlidarDriverImplCommon::getScanDataWithIntervalHq(rplidar_response_mea
     // count to 0.
     if (_isScanning)
     {
-        rp::hal::AutoLocker l(_lock);
-        if (_cached_scan_node_hq_count_for_interval_retrieve == 0)
+        // Copy at most count nodes from _cached_scan_node_hq_for_interval_retrieve
+        size_to_copy = _cached_scan_node_hq_for_interval_retrieve.pop(nodebuffer, count);
+        if (size_to_copy == 0)
         {
             return RESULT_OPERATION_TIMEOUT;
         }
-        // Copy at most count nodes from _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = min(_cached_scan_node_hq_count_for_interval_retrieve, count);
-        memcpy(nodebuffer, _cached_scan_node_hq_buf_for_interval_retrieve, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
-        _cached_scan_node_hq_count_for_interval_retrieve -= size_to_copy;
-        // Move remaining data to the start of the array.
-        memmove(&_cached_scan_node_hq_buf_for_interval_retrieve[0], &_cached_scan_node_hq_buf_for_interval_retrieve[size_to_copy], _cached_scan_node_hq_count_for_interval_retrieve *  sizeof(rplidar_response_measurement_node_hq_t));
     }
     count = size_to_copy;
 
 	// If there is remaining data, return with a warning.
-	if (_cached_scan_node_hq_count_for_interval_retrieve > 0)
+	if (_cached_scan_node_hq_for_interval_retrieve.size() > 0)
 		return RESULT_REMAINING_DATA;
     return RESULT_OK;
 }
 
-static inline float getAngle(const rplidar_response_measurement_node_t& node)
+u_result RPlidarDriverImplCommon::getScanDataWithIntervalDropCount(size_t & dropCount)
 {
-    return (node.angle_q6_checkbit >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) / 64.f;
+    dropCount = _cached_scan_node_hq_for_interval_retrieve.takeDropped();
+    return RESULT_OK;
 }
 
-static inline void setAngle(rplidar_response_measurement_node_t& node, float v)
+u_result RPlidarDriverImplCommon::getDatagramLossCount(size_t & lostCount)
 {
-    _u16 checkbit = node.angle_q6_checkbit & RPLIDAR_RESP_MEASUREMENT_CHECKBIT;
-    node.angle_q6_checkbit = (((_u16)(v * 64.0f)) << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | checkbit;
-}
+    if (!_isDatagramFramed) return RESULT_OPERATION_NOT_SUPPORT;
 
-static inline float getAngle(const rplidar_response_measurement_node_hq_t& node)
-{
-    return node.angle_z_q14 * 90.f / 16384.f;
+    lostCount = _lostDatagrams.exchange(0, std::memory_order_relaxed);
+    return RESULT_OK;
 }
 
-static inline void setAngle(rplidar_response_measurement_node_hq_t& node, float v)
+u_result RPlidarDriverImplCommon::startRecording(const char * path)
 {
-    node.angle_z_q14 = _u32(v * 16384.f / 90.f);
-}
+    // the cache thread uses the channel without holding _lock
+    if (_isScanning) return RESULT_OPERATION_FAIL;
 
-static inline _u16 getDistanceQ2(const rplidar_response_measurement_node_t& node)
-{
-    return node.distance_q2;
-}
+    rp::hal::AutoLocker l(_lock);
+    if (_recorder) return RESULT_ALREADY_DONE;
+    if (!_chanDev) return RESULT_OPERATION_FAIL;
 
-static inline _u32 getDistanceQ2(const rplidar_response_measurement_node_hq_t& node)
-{
-    return node.dist_mm_q2;
-}
+    FILE * file = RecordingChannelDevice::CreateRecordFile(path);
+    if (!file) return RESULT_OPERATION_FAIL;
 
-template <class TNode>
-static bool angleLessThan(const TNode& a, const TNode& b)
-{
-    return getAngle(a) < getAngle(b);
+    _recorder = new RecordingChannelDevice(_chanDev, file);
+    _chanDev = _recorder;
+    return RESULT_OK;
 }
 
-template < class TNode >
-static u_result ascendScanData_(TNode * nodebuffer, size_t count)
+u_result RPlidarDriverImplCommon::stopRecording()
 {
-    float inc_origin_angle = 360.f/count;
-    size_t i = 0;
-
-    //Tune head
-    for (i = 0; i < count; i++) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            continue;
-        } else {
-            while(i != 0) {
-                i--;
-                float expect_angle = getAngle(nodebuffer[i+1]) - inc_origin_angle;
-                if (expect_angle < 0.0f) expect_angle = 0.0f;
-                setAngle(nodebuffer[i], expect_angle);
-            }
-            break;
-        }
-    }
+    if (_isScanning) return RESULT_OPERATION_FAIL;
 
-    // all the data is invalid
-    if (i == count) return RESULT_OPERATION_FAIL;
-
-    //Tune tail
-    for (i = count - 1; i >= 0; i--) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            continue;
-        } else {
-            while(i != (count - 1)) {
-                i++;
-                float expect_angle = getAngle(nodebuffer[i-1]) + inc_origin_angle;
-                if (expect_angle > 360.0f) expect_angle -= 360.0f;
-                setAngle(nodebuffer[i], expect_angle);
-            }
-            break;
-        }
-    }
-
-    //Fill invalid angle in the scan
-    float frontAngle = getAngle(nodebuffer[0]);
-    for (i = 1; i < count; i++) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            float expect_angle =  frontAngle + i * inc_origin_angle;
-            if (expect_angle > 360.0f) expect_angle -= 360.0f;
-            setAngle(nodebuffer[i], expect_angle);
-        }
-    }
-
-    // Reorder the scan according to the angle value
-    std::sort(nodebuffer, nodebuffer + count, &angleLessThan<TNode>);
+    rp::hal::AutoLocker l(_lock);
+    if (!_recorder) return RESULT_ALREADY_DONE;
 
+    _chanDev = _recorder->channel();
+    delete _recorder;
+    _recorder = NULL;
     return RESULT_OK;
 }
 
@@ -1991,12 +2073,12 @@ u_result RPlidarDriverImplCommon::ascendScanData(rplidar_response_measurement_no
 {
     DEPRECATED_WARN("ascendScanData(rplidar_response_measurement_node_t*, size_t)", "ascendScanData(rplidar_response_measurement_node_hq_t*, size_t)");
 
-    return ascendScanData_<rplidar_response_measurement_node_t>(nodebuffer, count);
+    return ScanSorter::ascend(nodebuffer, count);
 }
 
 u_result RPlidarDriverImplCommon::ascendScanData(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count)
 {
-    return ascendScanData_<rplidar_response_measurement_node_hq_t>(nodebuffer, count);
+    return ScanSorter::ascend(nodebuffer, count);
 }
 
 u_result RPlidarDriverImplCommon::_sendCommand(_u8 cmd, const void * payload, size_t payloadsize)
@@ -2062,6 +2144,10 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
         return RESULT_OK;
     }
 
+    if (_capabilityCache.getSampleRate(rateInfo)) {
+        return RESULT_OK;
+    }
+
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -2090,6 +2176,7 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
         }
         _chanDev->recvdata(reinterpret_cast<_u8 *>(&rateInfo), sizeof(rateInfo));
     }
+    _capabilityCache.setSampleRate(rateInfo);
     return RESULT_OK;
 }
 
@@ -2099,6 +2186,10 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
     support = false;
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
+
+    if (_capabilityCache.getMotorCtrlSupport(support)) {
+        return RESULT_OK;
+    }
     
     _disableDataGrabbing();
 
@@ -2137,6 +2228,7 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
             support = true;
         }
     }
+    _capabilityCache.setMotorCtrlSupport(support);
     return RESULT_OK;
 }
 
@@ -2155,6 +2247,8 @@ u_result RPlidarDriverImplCommon::setMotorPWM(_u16 pwm)
         }
     }
 
+    rp::hal::AutoLocker l(_spinLock);
+    _spinControl.setCommand(pwm);
     return RESULT_OK;
 }
 
@@ -2165,9 +2259,17 @@ u_result RPlidarDriverImplCommon::setLidarSpinSpeed(_u16 rpm, _u32 timeout)
     u_result ans;
     rplidar_payload_hq_spd_ctrl_t speedReq;
     speedReq.rpm = rpm;
-    if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_HQ_MOTOR_SPEED_CTRL, (const _u8 *)&speedReq, sizeof(speedReq)))) {
-        return ans;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_HQ_MOTOR_SPEED_CTRL, (const _u8 *)&speedReq, sizeof(speedReq)))) {
+            return ans;
+        }
     }
+
+    rp::hal::AutoLocker l(_spinLock);
+    _spinControl.setCommand(rpm);
     return RESULT_OK;
 }
 
@@ -2187,22 +2289,74 @@ u_result RPlidarDriverImplCommon::startMotor()
         }
     }
     else {
-        setLidarSpinSpeed(600);//set default rpm to tof lidar
+        return setLidarSpinSpeed(600);//set default rpm to tof lidar
     }
-
 }
 
 u_result RPlidarDriverImplCommon::stopMotor()
+{
+    return _stopMotor(true);
+}
+
+u_result RPlidarDriverImplCommon::setScanFrequency(float frequency)
+{
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+    if (!_isTofLidar && !_isSupportingMotorCtrl) return RESULT_OPERATION_NOT_SUPPORT;
+    if (frequency != 0 && (frequency < MIN_SCAN_FREQUENCY || frequency > MAX_SCAN_FREQUENCY)) {
+        return RESULT_INVALID_DATA;
+    }
+
+    // slower, a revolution of the running mode no longer fits a scan and cannot be measured
+    if (frequency != 0 && _isScanning && frequency * _sampleDuration_us * (_scanCapacity - 1) < 1000000.0f) {
+        return RESULT_INVALID_DATA;
+    }
+
+    rp::hal::AutoLocker l(_spinLock);
+    if (_isTofLidar) {
+        _spinControl.setLimits(MIN_SCAN_FREQUENCY * 60, MAX_SCAN_FREQUENCY * 60);
+    } else {
+        // below about a quarter of the default PWM the motor may stall, and a stalled
+        // motor gives no revolutions to correct it with
+        _spinControl.setLimits(DEFAULT_MOTOR_PWM / 4, MAX_MOTOR_PWM);
+    }
+    _spinControl.setTarget(frequency);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setAngularResolution(float degrees)
+{
+    if (!_isScanning) return RESULT_OPERATION_FAIL;
+    if (degrees <= 0) return RESULT_INVALID_DATA;
+
+    // one revolution takes 360 / degrees samples
+    return setScanFrequency(degrees * 1000000.0f / (360.0f * _sampleDuration_us));
+}
+
+u_result RPlidarDriverImplCommon::getSpinStatus(RplidarSpinStatus & status)
+{
+    rp::hal::AutoLocker l(_spinLock);
+    status.target_frequency = _spinControl.target();
+    status.measured_frequency = _spinControl.measuredFrequency();
+    status.angular_resolution = 0;
+    if (_isScanning && status.measured_frequency > 0) {
+        status.angular_resolution = 360.0f * status.measured_frequency * _sampleDuration_us / 1000000.0f;
+    }
+    status.motor_command = _spinControl.command();
+    status.is_locked = _spinControl.isLocked();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_stopMotor(bool waitSpinDown)
 {
     if(_isTofLidar) return RESULT_OK;
     if (_isSupportingMotorCtrl) { // RPLIDAR A2
         setMotorPWM(0);
-        delay(500);
+        if (waitSpinDown) delay(500);
         return RESULT_OK;
     } else { // RPLIDAR A1
         rp::hal::AutoLocker l(_lock);
         _chanDev->setDTR();
-        delay(500);
+        if (waitSpinDown) delay(500);
         return RESULT_OK;
     }
 }
@@ -2210,12 +2364,33 @@ u_result RPlidarDriverImplCommon::stopMotor()
 void RPlidarDriverImplCommon::_disableDataGrabbing()
 {
     _isScanning = false;
+
+    if (_reactor) {
+        // returns once no reactor worker decodes for this driver any more
+        _reactor->endScan(this);
+    }
+
+    // wake the cache thread up from its wait for data, so it sees the scan is over
+    // right away instead of after the wait timed out. The cancellation stays pending
+    // until a wait consumes it; once the thread is gone, drop it so the next command
+    // does not time out at once
+    _chanDev->cancelWait();
     _cachethread.join();
+    _cachethread = rp::hal::Thread();
+    _chanDev->clearCancelWait();
+
+    if (_listenerthread.getHandle()) {
+        // wake the listener thread up so it sees the scan is over
+        _dataEvt.set();
+        _listenerthread.join();
+        _listenerthread = rp::hal::Thread();
+    }
 }
 
 // Serial Driver Impl
 
-RPlidarDriverSerial::RPlidarDriverSerial() 
+RPlidarDriverSerial::RPlidarDriverSerial(_u32 scanCapacity)
+    : RPlidarDriverImplCommon(scanCapacity)
 {
     _chanDev = new SerialChannelDevice();
 }
@@ -2233,6 +2408,10 @@ void RPlidarDriverSerial::disconnect()
 {
     if (!_isConnected) return ;
     stop();
+
+    // release the port, so connect can open it again once the device is back
+    _chanDev->close();
+    _isConnected = false;
 }
 
 u_result RPlidarDriverSerial::connect(const char * port_path, _u32 baudrate, _u32 flag)
@@ -2240,6 +2419,7 @@ u_result RPlidarDriverSerial::connect(const char * port_path, _u32 baudrate, _u3
     if (isConnected()) return RESULT_ALREADY_DONE;
 
     if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+    if (IS_FAIL(_allocateScanBuffers())) return RESULT_INSUFFICIENT_MEMORY;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -2253,13 +2433,17 @@ u_result RPlidarDriverSerial::connect(const char * port_path, _u32 baudrate, _u3
 
     _isConnected = true;
 
+    _identifyDevice();
     checkMotorCtrlSupport(_isSupportingMotorCtrl);
-    stopMotor();
+
+    // nothing waits for the motor to come to rest, startMotor spins it up again anyway
+    _stopMotor(false);
 
     return RESULT_OK;
 }
 
-RPlidarDriverTCP::RPlidarDriverTCP() 
+RPlidarDriverTCP::RPlidarDriverTCP(_u32 scanCapacity)
+    : RPlidarDriverImplCommon(scanCapacity)
 {
     _chanDev = new TCPChannelDevice();
 }
@@ -2268,13 +2452,19 @@ RPlidarDriverTCP::~RPlidarDriverTCP()
 {
     // force disconnection
     disconnect();
+    stopRecording();
+    delete _chanDev;
+    _chanDev = NULL;
 }
 
 void RPlidarDriverTCP::disconnect()
 {
     if (!_isConnected) return ;
     stop();
+
+    // drop the connection, connect opens a new one
     _chanDev->close();
+    _isConnected = false;
 }
 
 u_result RPlidarDriverTCP::connect(const char * ipStr, _u32 port, _u32 flag)
@@ -2282,19 +2472,149 @@ u_result RPlidarDriverTCP::connect(const char * ipStr, _u32 port, _u32 flag)
     if (isConnected()) return RESULT_ALREADY_DONE;
 
     if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+    if (IS_FAIL(_allocateScanBuffers())) return RESULT_INSUFFICIENT_MEMORY;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // establish the connection...
+        if(!_chanDev->bind(ipStr, port))
+            return RESULT_INVALID_DATA;
+    }
+
+    _isConnected = true;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // the bridge keeps the serial side open when a connection drops, so the
+        // device may still be streaming a scan started by the previous session
+        _sendCommand(RPLIDAR_CMD_STOP);
+        delay(20);
+        _chanDev->flush();
+    }
+
+    _identifyDevice();
+    checkMotorCtrlSupport(_isSupportingMotorCtrl);
+
+    // nothing waits for the motor to come to rest, startMotor spins it up again anyway
+    _stopMotor(false);
+
+    return RESULT_OK;
+}
+
+// UDP Driver Impl
+
+RPlidarDriverUDP::RPlidarDriverUDP(_u32 scanCapacity)
+    : RPlidarDriverImplCommon(scanCapacity)
+{
+    static_assert((size_t)UDPChannelDevice::MAX_DATAGRAM_SIZE <= (size_t)RX_MAX_DATAGRAM_SIZE, "datagrams do not fit the receive ring in one piece");
+
+    _chanDev = new UDPChannelDevice();
+    _isDatagramFramed = true;
+}
+
+RPlidarDriverUDP::~RPlidarDriverUDP()
+{
+    // force disconnection
+    disconnect();
+    stopRecording();
+    delete _chanDev;
+    _chanDev = NULL;
+}
+
+void RPlidarDriverUDP::disconnect()
+{
+    if (!_isConnected) return ;
+    stop();
+
+    _chanDev->close();
+    _isConnected = false;
+}
+
+u_result RPlidarDriverUDP::connect(const char * ipStr, _u32 port, _u32 /*flag*/)
+{
+    if (isConnected()) return RESULT_ALREADY_DONE;
+
+    if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+    if (IS_FAIL(_allocateScanBuffers())) return RESULT_INSUFFICIENT_MEMORY;
 
     {
         rp::hal::AutoLocker l(_lock);
 
-        // establish the serial connection...
         if(!_chanDev->bind(ipStr, port))
             return RESULT_INVALID_DATA;
+        _channelLostDatagrams = 0;
+    }
+
+    _isConnected = true;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // nothing tells the device that a previous session went away, it may
+        // still be streaming the scan that session started
+        _sendCommand(RPLIDAR_CMD_STOP);
+        delay(20);
+        _chanDev->flush();
+    }
+
+    _identifyDevice();
+    checkMotorCtrlSupport(_isSupportingMotorCtrl);
+
+    // nothing waits for the motor to come to rest, startMotor spins it up again anyway
+    _stopMotor(false);
+
+    return RESULT_OK;
+}
+
+// Replay Driver Impl
+
+RPlidarDriverReplay::RPlidarDriverReplay(_u32 scanCapacity)
+    : RPlidarDriverImplCommon(scanCapacity)
+{
+    _chanDev = new ReplayChannelDevice();
+}
+
+RPlidarDriverReplay::~RPlidarDriverReplay()
+{
+    // force disconnection
+    disconnect();
+    stopRecording();
+    delete _chanDev;
+    _chanDev = NULL;
+}
+
+void RPlidarDriverReplay::disconnect()
+{
+    if (!_isConnected) return ;
+    stop();
+    _chanDev->close();
+    _isConnected = false;
+}
+
+u_result RPlidarDriverReplay::connect(const char * recordingPath, _u32 pace, _u32 /*flag*/)
+{
+    if (isConnected()) return RESULT_ALREADY_DONE;
+
+    if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+    if (IS_FAIL(_allocateScanBuffers())) return RESULT_INSUFFICIENT_MEMORY;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // load the recording and start it over
+        if (!_chanDev->bind(recordingPath, pace)  ||  !_chanDev->open()) {
+            return RESULT_INVALID_DATA;
+        }
     }
 
     _isConnected = true;
 
+    // the same queries as the recorded connect, so the recording lines up
+    _identifyDevice();
     checkMotorCtrlSupport(_isSupportingMotorCtrl);
-    stopMotor();
+    _stopMotor(false);
 
     return RESULT_OK;
 }
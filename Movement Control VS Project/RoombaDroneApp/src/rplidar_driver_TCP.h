@@ -36,38 +36,174 @@
 
 namespace rp { namespace standalone{ namespace rplidar {
 
+// TCP link to a lidar, e.g. behind a serial to Ethernet bridge.
+//
+// Received data goes through a user-space buffer: a wait reads whatever the
+// socket holds in one go, and reports the amount really buffered, so the
+// parsers take a whole frame with a single recvdata call instead of one
+// recv syscall per fragment. Every bind opens a new connection, which makes
+// the channel reusable after close or after the peer went away.
 class TCPChannelDevice :public ChannelDevice
 {
 public:
+    enum {
+        RX_BUFFER_SIZE = 16384,
+        CANCEL_CHECK_INTERVAL = 20,     // ms a wait sleeps at most before looking for cancelWait
+    };
+
     rp::net::StreamSocket * _binded_socket;
-    TCPChannelDevice():_binded_socket(rp::net::StreamSocket::CreateSocket()){}
+
+    TCPChannelDevice()
+        : _binded_socket(NULL)
+        , _rxHead(0)
+        , _rxTail(0)
+        , _isDeviceLost(false)
+        , _isCancelled(false)
+    {}
+
+    ~TCPChannelDevice()
+    {
+        close();
+    }
 
     bool bind(const char * ipStr, uint32_t port)
     {
+        close();
+
+        _binded_socket = rp::net::StreamSocket::CreateSocket();
+        if (!_binded_socket) return false;
+
         rp::net::SocketAddress socket(ipStr, port);
-        return IS_OK(_binded_socket->connect(socket));
+        if (IS_FAIL(_binded_socket->connect(socket))) {
+            close();
+            return false;
+        }
+
+        // the commands are tiny and latency bound, and a bridge that lost
+        // power never closes the connection by itself
+        _binded_socket->enableNoDelay(true);
+        _binded_socket->enableKeepAlive(true);
+        return true;
     }
     void close()
     {
-        _binded_socket->dispose();
+        if (_binded_socket) _binded_socket->dispose();
         _binded_socket = NULL;
+        _rxHead = _rxTail = 0;
+        _isDeviceLost = false;
+        _isCancelled = false;
+    }
+    void flush()
+    {
+        // drop what was buffered and what already arrived
+        _rxHead = _rxTail = 0;
+        while (_binded_socket && !_isDeviceLost && _binded_socket->waitforData(0) == RESULT_OK) {
+            if (!_fillBuffer()) break;
+            _rxHead = _rxTail = 0;
+        }
     }
     bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
     {
-        if(returned_size)
-            *returned_size = data_count;
-        return (_binded_socket->waitforData(timeout) == RESULT_OK);
+        size_t buffered = 0;
+        if (!returned_size) returned_size = &buffered;
+
+        _u32 startTs = getms();
+        bool isPolled = false;
+        for (;;) {
+            *returned_size = _rxTail - _rxHead;
+            if (*returned_size >= data_count) return true;
+            if (!_binded_socket || _isDeviceLost) return false;
+
+            // a cancel stays pending until a wait it ends consumes it
+            if (_isCancelled.exchange(false)) return false;
+
+            // a timeout of 0 still looks at the socket once
+            _u32 waitTime = getms() - startTs;
+            if (waitTime >= timeout && isPolled) return false;
+
+            _u32 slice = (waitTime < timeout) ? timeout - waitTime : 0;
+            if (slice > CANCEL_CHECK_INTERVAL) slice = CANCEL_CHECK_INTERVAL;
+
+            u_result ans = _binded_socket->waitforData(slice);
+            if (ans == RESULT_OK) {
+                _fillBuffer();
+            } else if (ans != RESULT_OPERATION_TIMEOUT) {
+                _isDeviceLost = true;
+            }
+            isPolled = true;
+        }
+    }
+    bool isDeviceLost()
+    {
+        return _isDeviceLost;
+    }
+    void cancelWait()
+    {
+        _isCancelled = true;
+    }
+    void clearCancelWait()
+    {
+        _isCancelled = false;
+    }
+    int getPollHandle()
+    {
+        return _binded_socket ? _binded_socket->getPollHandle() : -1;
     }
     int senddata(const _u8 * data, size_t size)
     {
-        return _binded_socket->send(data, size) ;
+        if (!_binded_socket) return -1;
+
+        u_result ans = _binded_socket->send(data, size);
+        if (IS_OK(ans)) return (int)size;
+        if (ans != RESULT_OPERATION_TIMEOUT) _isDeviceLost = true;
+        return -1;
     }
     int recvdata(unsigned char * data, size_t size)
     {
-        size_t lenRec = 0;
-        _binded_socket->recv(data, size, lenRec);
-        return lenRec;
+        // whatever a wait left in the buffer, or what already arrived if it is empty
+        if (_rxHead == _rxTail && _binded_socket && !_isDeviceLost && _binded_socket->waitforData(0) == RESULT_OK) {
+            _fillBuffer();
+        }
+
+        size_t available = _rxTail - _rxHead;
+        if (size > available) size = available;
+        memcpy(data, _rxBuffer + _rxHead, size);
+        _rxHead += size;
+        if (_rxHead == _rxTail) _rxHead = _rxTail = 0;
+        return (int)size;
     }
+
+protected:
+    // one recv into the free tail of the buffer
+    bool _fillBuffer()
+    {
+        if (_rxHead && _rxTail == RX_BUFFER_SIZE) {
+            memmove(_rxBuffer, _rxBuffer + _rxHead, _rxTail - _rxHead);
+            _rxTail -= _rxHead;
+            _rxHead = 0;
+        }
+        if (_rxTail == RX_BUFFER_SIZE) return true;
+
+        size_t received = 0;
+        u_result ans = _binded_socket->recv(_rxBuffer + _rxTail, RX_BUFFER_SIZE - _rxTail, received);
+        if (IS_FAIL(ans)) {
+            if (ans != RESULT_OPERATION_TIMEOUT) _isDeviceLost = true;
+            return false;
+        }
+        if (!received) {
+            // orderly shutdown by the peer
+            _isDeviceLost = true;
+            return false;
+        }
+        _rxTail += received;
+        return true;
+    }
+
+    _u8             _rxBuffer[RX_BUFFER_SIZE];
+    size_t          _rxHead;
+    size_t          _rxTail;
+    volatile bool   _isDeviceLost;
+    std::atomic<bool> _isCancelled;
 };
 
 
@@ -75,7 +211,7 @@ class RPlidarDriverTCP : public RPlidarDriverImplCommon
 {
 public:
 
-    RPlidarDriverTCP();
+    explicit RPlidarDriverTCP(_u32 scanCapacity = MAX_SCAN_NODES);
     virtual ~RPlidarDriverTCP();
     virtual u_result connect(const char * ipStr, _u32 port, _u32 flag = 0);
     virtual void disconnect();
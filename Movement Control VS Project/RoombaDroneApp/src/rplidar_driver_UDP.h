@@ -0,0 +1,275 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// UDP link to a network lidar.
+//
+// The device sends its scan data as datagrams holding whole frames. Handed a
+// buffer large enough for any datagram, recvdata receives the next datagram
+// straight into it, so the scan data lands in the driver's receive ring
+// without going through a buffer here. Smaller reads, as done when parsing
+// command responses, go through a buffer and see the datagrams as a stream.
+//
+// Datagrams from other senders are ignored. Datagrams the socket dropped
+// because its receive queue was full, and datagrams too large to receive,
+// are counted as lost.
+class UDPChannelDevice :public ChannelDevice
+{
+public:
+    enum {
+        MAX_DATAGRAM_SIZE = 1472,       // payload of one Ethernet frame
+        RX_BUFFER_SIZE = 4 * MAX_DATAGRAM_SIZE,
+        CANCEL_CHECK_INTERVAL = 20,     // ms a wait sleeps at most before looking for cancelWait
+    };
+
+    rp::net::DGramSocket * _binded_socket;
+
+    UDPChannelDevice()
+        : _binded_socket(NULL)
+        , _rxHead(0)
+        , _rxTail(0)
+        , _isDatagramQueued(false)
+        , _truncatedCount(0)
+        , _isDeviceLost(false)
+        , _isCancelled(false)
+    {}
+
+    ~UDPChannelDevice()
+    {
+        close();
+    }
+
+    bool bind(const char * ipStr, uint32_t port)
+    {
+        close();
+
+        if (IS_FAIL(_deviceAddress.setAddressFromString(ipStr)) || IS_FAIL(_deviceAddress.setPort(port))) {
+            return false;
+        }
+
+        _binded_socket = rp::net::DGramSocket::CreateSocket();
+        return _binded_socket != NULL;
+    }
+    void close()
+    {
+        if (_binded_socket) _binded_socket->dispose();
+        _binded_socket = NULL;
+        _rxHead = _rxTail = 0;
+        _isDatagramQueued = false;
+        _truncatedCount = 0;
+        _isDeviceLost = false;
+        _isCancelled = false;
+    }
+    void flush()
+    {
+        // drop what was buffered and what already arrived
+        _rxHead = _rxTail = 0;
+        while (_isReadable(0)) {
+            if (!_receive(_rxBuffer, RX_BUFFER_SIZE)) break;
+        }
+        _rxHead = _rxTail = 0;
+    }
+    bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
+    {
+        size_t buffered = 0;
+        if (!returned_size) returned_size = &buffered;
+
+        _u32 startTs = getms();
+        bool isPolled = false;
+        for (;;) {
+            *returned_size = _rxTail - _rxHead;
+            if (*returned_size >= data_count) return true;
+            if (!_binded_socket || _isDeviceLost) return false;
+
+            // a cancel stays pending until a wait it ends consumes it
+            if (_isCancelled.exchange(false)) return false;
+
+            if (_isDatagramQueued) {
+                if (!*returned_size && data_count <= 1) {
+                    // the size of the datagram is only known once it is received
+                    *returned_size = 1;
+                    return true;
+                }
+                // the caller wants more than a datagram is known to hold
+                _fillBuffer();
+                continue;
+            }
+
+            // a timeout of 0 still looks at the socket once
+            _u32 waitTime = getms() - startTs;
+            if (waitTime >= timeout && isPolled) return false;
+
+            _u32 slice = (waitTime < timeout) ? timeout - waitTime : 0;
+            if (slice > CANCEL_CHECK_INTERVAL) slice = CANCEL_CHECK_INTERVAL;
+            _isReadable(slice);
+            isPolled = true;
+        }
+    }
+    bool isDeviceLost()
+    {
+        return _isDeviceLost;
+    }
+    void cancelWait()
+    {
+        _isCancelled = true;
+    }
+    void clearCancelWait()
+    {
+        _isCancelled = false;
+    }
+    size_t getLostDatagramCount()
+    {
+        _u32 dropCount = 0;
+        if (_binded_socket) _binded_socket->getDropCount(dropCount);
+        return _truncatedCount + dropCount;
+    }
+    int getPollHandle()
+    {
+        return _binded_socket ? _binded_socket->getPollHandle() : -1;
+    }
+    int senddata(const _u8 * data, size_t size)
+    {
+        if (!_binded_socket) return -1;
+
+        u_result ans = _binded_socket->sendTo(_deviceAddress, data, size);
+        if (IS_OK(ans)) return (int)size;
+        if (ans != RESULT_OPERATION_TIMEOUT) _isDeviceLost = true;
+        return -1;
+    }
+    int recvdata(unsigned char * data, size_t size)
+    {
+        if (_rxHead == _rxTail) {
+            if (!_isReadable(0)) return 0;
+
+            // the next datagram in one piece, directly into the caller's buffer
+            if (size >= MAX_DATAGRAM_SIZE) return (int)_receive(data, size);
+
+            _fillBuffer();
+        }
+
+        size_t available = _rxTail - _rxHead;
+        if (size > available) size = available;
+        memcpy(data, _rxBuffer + _rxHead, size);
+        _rxHead += size;
+        if (_rxHead == _rxTail) _rxHead = _rxTail = 0;
+        return (int)size;
+    }
+
+protected:
+    bool _isReadable(_u32 timeout)
+    {
+        if (!_isDatagramQueued && _binded_socket && !_isDeviceLost) {
+            u_result ans = _binded_socket->waitforData(timeout);
+            if (ans == RESULT_OK) {
+                _isDatagramQueued = true;
+            } else if (ans != RESULT_OPERATION_TIMEOUT) {
+                _isDeviceLost = true;
+            }
+        }
+        return _isDatagramQueued;
+    }
+
+    // append the next datagram to the buffer
+    void _fillBuffer()
+    {
+        if (_rxTail + MAX_DATAGRAM_SIZE > RX_BUFFER_SIZE) {
+            memmove(_rxBuffer, _rxBuffer + _rxHead, _rxTail - _rxHead);
+            _rxTail -= _rxHead;
+            _rxHead = 0;
+        }
+        if (_rxTail + MAX_DATAGRAM_SIZE > RX_BUFFER_SIZE) {
+            // nobody reads what is buffered, let the datagram wait in the socket
+            _isDatagramQueued = false;
+            return;
+        }
+        _rxTail += _receive(_rxBuffer + _rxTail, RX_BUFFER_SIZE - _rxTail);
+    }
+
+    // receive the queued datagram, the size of its payload if it came from the device
+    size_t _receive(_u8 * buffer, size_t size)
+    {
+        rp::net::SocketAddress source;
+        size_t received = 0;
+
+        _isDatagramQueued = false;
+        u_result ans = _binded_socket->recvFrom(buffer, size, received, &source);
+        if (ans == RESULT_INVALID_DATA) {
+            ++_truncatedCount;
+            return 0;
+        }
+        if (IS_FAIL(ans)) {
+            if (ans != RESULT_OPERATION_TIMEOUT) _isDeviceLost = true;
+            return 0;
+        }
+        return _isFromDevice(source) ? received : 0;
+    }
+
+    bool _isFromDevice(const rp::net::SocketAddress & source)
+    {
+        _u8 sourceRaw[16] = {0};
+        _u8 deviceRaw[16] = {0};
+
+        if (source.getPort() != _deviceAddress.getPort()) return false;
+        if (source.getAddressType() != _deviceAddress.getAddressType()) return false;
+        source.getRawAddress(sourceRaw, sizeof(sourceRaw));
+        _deviceAddress.getRawAddress(deviceRaw, sizeof(deviceRaw));
+        return memcmp(sourceRaw, deviceRaw, sizeof(sourceRaw)) == 0;
+    }
+
+    rp::net::SocketAddress  _deviceAddress;
+    _u8             _rxBuffer[RX_BUFFER_SIZE];
+    size_t          _rxHead;
+    size_t          _rxTail;
+    bool            _isDatagramQueued;  // the socket reported readable and nothing was received since
+    size_t          _truncatedCount;
+    volatile bool   _isDeviceLost;
+    std::atomic<bool> _isCancelled;
+};
+
+
+class RPlidarDriverUDP : public RPlidarDriverImplCommon
+{
+public:
+
+    explicit RPlidarDriverUDP(_u32 scanCapacity = MAX_SCAN_NODES);
+    virtual ~RPlidarDriverUDP();
+    virtual u_result connect(const char * ipStr, _u32 port, _u32 flag = 0);
+    virtual void disconnect();
+};
+
+
+}}}
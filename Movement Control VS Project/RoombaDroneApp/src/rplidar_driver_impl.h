@@ -35,14 +35,22 @@
 #pragma once
 
 namespace rp { namespace standalone{ namespace rplidar {
-    class RPlidarDriverImplCommon : public RPlidarDriver
+    class RPlidarDriverImplCommon : public RPlidarDriver, public ScanPump
 {
 public:
     enum {
         RPLIDAR_TOF_MINUM_MAJOR_ID = 5,
     };
 
+    enum {
+        RX_RING_SIZE = 8192,
+        RX_MAX_DATAGRAM_SIZE = 1472,    // largest datagram received in place into _rxRing
+    };
+
     virtual bool isConnected();     
+    virtual _u32 getScanCapacity();
+    virtual bool isScanning();
+    virtual u_result getScanIdleTime(_u32 & idle_ms);
     virtual u_result reset(_u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result clearNetSerialRxCache();
     virtual u_result getAllSupportedScanModes(std::vector<RplidarScanMode>& outModes, _u32 timeoutInMs = DEFAULT_TIMEOUT);
@@ -58,16 +66,22 @@ public:
 
     virtual u_result startScan(bool force, bool useTypicalScan, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL);
     virtual u_result startScanExpress(bool force, _u16 scanMode, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result startScanAuto(_u32 decodeBudgetPercent = DEFAULT_DECODE_BUDGET_PERCENT, RplidarScanModeSelection * outSelection = NULL, _u32 timeout = DEFAULT_TIMEOUT);
 
 
     virtual u_result getHealth(rplidar_response_device_health_t & health, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result setCapabilityCacheDir(const char * path);
+    virtual u_result clearCapabilityCache();
     virtual u_result checkIfTofLidar(bool & isTofLidar, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result getSampleDuration_uS(rplidar_response_sample_rate_t & rateInfo, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result setMotorPWM(_u16 pwm);
     virtual u_result setLidarSpinSpeed(_u16 rpm, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result startMotor();
     virtual u_result stopMotor();
+    virtual u_result setScanFrequency(float frequency);
+    virtual u_result setAngularResolution(float degrees);
+    virtual u_result getSpinStatus(RplidarSpinStatus & status);
     virtual u_result checkMotorCtrlSupport(bool & support, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result getFrequency(bool inExpressMode, size_t count, float & frequency, bool & is4kmode);
     virtual u_result getFrequency(const RplidarScanMode& scanMode, size_t count, float & frequency);
@@ -76,43 +90,107 @@ public:
     virtual u_result stop(_u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataHqNoCopy(const rplidar_response_measurement_node_hq_t * & nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanLease(ScanLease & lease, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result getGrabbedScanTimestamp(RplidarScanTimestamp & timestamp);
+    virtual u_result mapDeviceTimeToHost(_u64 device_us, _u64 & host_us);
+    virtual u_result setScanListener(ScanListener * listener, _u32 sectorCount = 0, _u32 flags = 0);
     virtual u_result ascendScanData(rplidar_response_measurement_node_t * nodebuffer, size_t count);
     virtual u_result ascendScanData(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count);
     virtual u_result getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count);
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count);
+    virtual u_result getScanDataWithIntervalDropCount(size_t & dropCount);
+    virtual u_result getDatagramLossCount(size_t & lostCount);
+    virtual u_result startRecording(const char * path);
+    virtual u_result stopRecording();
+    virtual u_result setReactor(RPlidarReactor * reactor);
+    virtual u_result setCacheThreadAttributes(const RplidarThreadAttributes & attributes);
+    virtual u_result getCacheThreadAttributesResult();
+
+    virtual bool pumpScanData();
 
 protected:
 
+    struct scan_slot_t {
+        rplidar_response_measurement_node_hq_t * nodes;     // _scanCapacity nodes from _scanArena
+        size_t                                   count;
+        RplidarScanTimestamp                     timestamp;
+
+        scan_slot_t() : nodes(NULL), count(0) { timestamp.first_sample_us = 0; timestamp.us_per_sample = 0; }
+    };
+
     virtual u_result _sendCommand(_u8 cmd, const void * payload = NULL, size_t payloadsize = 0);
+    u_result _stopMotor(bool waitSpinDown);
+    void     _identifyDevice();
+    u_result _allocateScanBuffers();
     void     _disableDataGrabbing();
 
     virtual u_result _waitResponseHeader(rplidar_ans_header_t * header, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result _cacheScanData();
+
+    typedef bool (*frame_sync_checker_t)(const _u8 * frame);
+    u_result _fillRxRing(size_t required, _u32 timeout);
+    u_result _waitFrame(size_t frameSize, frame_sync_checker_t syncChecker, const _u8 * & frame, bool & afterGap, _u32 timeout);
+    void     _discardFrame();
+    void     _discardDatagram();
+
+    void     _cacheScanNodes(const rplidar_response_measurement_node_hq_t * nodes, size_t count, _u64 firstNodeTs_us);
+    _u64     _estimateBatchStart(size_t count, size_t delaySamples);
+    void     _regulateSpin(_u64 period_us);
+    u_result _waitScanPublished(_u32 timeout);
+
+    void     _dispatchSectors(const scan_slot_t & scan);
+    void     _finishSectors(const scan_slot_t & scan);
+    u_result _startScanListenerThread();
+    u_result _scanListenerThreadProc();
+
+    // Each _cache*ScanData call decodes and caches one frame of the scan, or one
+    // batch of nodes for standard scans. It runs in a loop on the cache thread,
+    // or with a timeout of 0 on a reactor worker until it runs out of data.
+    typedef u_result (RPlidarDriverImplCommon::*cache_step_t)(_u32 timeout);
+    u_result _startCaching(cache_step_t step, _u16 sampleDuration_us);
+    u_result _startScanInMode(bool hasModeTable, _u16 modeId, RplidarScanModeSelection & selection, _u32 timeout);
+    u_result _verifyScanRate(RplidarScanModeSelection & selection, _u32 timeout);
+    u_result _cacheThreadProc();
+
+    virtual u_result _cacheScanData(_u32 timeout);
     virtual u_result _waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result _waitNode(rplidar_response_measurement_node_t * node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result  _cacheCapsuledScanData();
-    virtual u_result _waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _cacheCapsuledScanData(_u32 timeout);
+    virtual u_result _waitCapsuledNode(const rplidar_response_capsule_measurement_nodes_t * & node, _u32 timeout = DEFAULT_TIMEOUT);
     virtual void     _capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
     virtual void     _dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
     
     //FW1.23
-    virtual u_result  _cacheUltraCapsuledScanData();
-    virtual u_result _waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _cacheUltraCapsuledScanData(_u32 timeout);
+    virtual u_result _waitUltraCapsuledNode(const rplidar_response_ultra_capsule_measurement_nodes_t * & node, _u32 timeout = DEFAULT_TIMEOUT);
     virtual void     _ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
 
-    virtual u_result  _cacheHqScanData();
-    virtual u_result _waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual void     _HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+    virtual u_result _cacheHqScanData(_u32 timeout);
+    virtual u_result _waitHqNode(const rplidar_response_hq_capsule_measurement_nodes_t * & node, _u32 timeout = DEFAULT_TIMEOUT);
 
     bool     _isConnected; 
     bool     _isScanning;
     bool     _isSupportingMotorCtrl;
     bool     _isTofLidar;
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf[8192];
-    size_t                                   _cached_scan_node_hq_count;
+    rp::hal::TripleBuffer<scan_slot_t>       _cached_scan;
+
+    rp::hal::SpscRing<rplidar_response_measurement_node_hq_t> _cached_scan_node_hq_for_interval_retrieve;
+
+    _u32                    _scanCapacity;
+    rp::hal::Arena          _scanArena;
 
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf_for_interval_retrieve[8192];
-    size_t                                   _cached_scan_node_hq_count_for_interval_retrieve;
+    ScanPool *              _scanPool;
+
+    ScanListener *          _scanListener;
+    _u32                    _scanListenerSectors;
+    bool                    _isScanListenerThreaded;
+    size_t                  _sectorStart;   // first node of the sector being received
+    size_t                  _sectorCursor;  // next node to assign to a sector
+    _u32                    _sectorIndex;
+
+    CapabilityCache         _capabilityCache;
+
+    RecordingChannelDevice * _recorder;         // wraps the channel while recording
 
     _u16                    _cached_sampleduration_std;
     _u16                    _cached_sampleduration_express;
@@ -121,18 +199,42 @@ protected:
     rplidar_response_capsule_measurement_nodes_t _cached_previous_capsuledata;
     rplidar_response_dense_capsule_measurement_nodes_t _cached_previous_dense_capsuledata;
     rplidar_response_ultra_capsule_measurement_nodes_t _cached_previous_ultracapsuledata;
-    rplidar_response_hq_capsule_measurement_nodes_t _cached_previous_Hqdata;
     bool                                         _is_previous_capsuledataRdy;
-    bool                                         _is_previous_HqdataRdy;
+
+    RxRingBuffer<RX_RING_SIZE, sizeof(rplidar_response_hq_capsule_measurement_nodes_t), RX_MAX_DATAGRAM_SIZE> _rxRing;
+    _u64                    _rxTimestamp_us;    // host time of the latest read into _rxRing
+    volatile _u32           _lastRxMs;          // getms() of the latest read, or of the scan start
+    float                   _sampleDuration_us; // measured over the last complete scan
+
+    bool                    _isDatagramFramed;      // every read from the channel holds whole frames
+    bool                    _rxAfterGap;            // datagrams were lost right before the data in _rxRing
+    size_t                  _channelLostDatagrams;  // loss count of the channel at the latest read
+    std::atomic<size_t>     _lostDatagrams;         // since the last getDatagramLossCount
+
+    DeviceClockSync         _deviceClock;
+    rp::hal::Locker         _deviceClockLock;
+
+    SpinController          _spinControl;
+    rp::hal::Locker         _spinLock;
 
 	
 
     rp::hal::Locker         _lock;
+    rp::hal::Locker         _grabLock;
     rp::hal::Event          _dataEvt;
     rp::hal::Thread _cachethread;
+    rp::hal::Thread _listenerthread;
+
+    RPlidarReactorImpl *    _reactor;           // receives the scan data instead of _cachethread
+    cache_step_t            _cacheStep;
+    bool                    _isFirstFrame;      // the first frame of a scan may be incomplete and is dropped
+
+    RplidarThreadAttributes _cacheThreadAttributes;
+    bool                    _hasCacheThreadAttributes;
+    u_result                _cacheThreadAttributesResult;   // of the latest attempt to apply them
 
 protected:
-    RPlidarDriverImplCommon();
-    virtual ~RPlidarDriverImplCommon() {}
+    explicit RPlidarDriverImplCommon(_u32 scanCapacity);
+    virtual ~RPlidarDriverImplCommon() { stopRecording(); setReactor(NULL); delete _scanPool; }
 };
 }}}
\ No newline at end of file
@@ -41,12 +41,14 @@ class SerialChannelDevice :public ChannelDevice
 public:
     rp::hal::serial_rxtx  * _rxtxSerial;
     bool _closePending;
+    bool _isDeviceLost;
 
-    SerialChannelDevice():_rxtxSerial(rp::hal::serial_rxtx::CreateRxTx()){}
+    SerialChannelDevice():_rxtxSerial(rp::hal::serial_rxtx::CreateRxTx()), _closePending(false), _isDeviceLost(false){}
 
     bool bind(const char * portname, uint32_t baudrate)
     {
         _closePending = false;
+        _isDeviceLost = false;
         return _rxtxSerial->bind(portname, baudrate);
     }
     bool open()
@@ -66,7 +68,25 @@ public:
     bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
     {
         if (_closePending) return false;
-        return (_rxtxSerial->waitfordata(data_count, timeout, returned_size) == rp::hal::serial_rxtx::ANS_OK);
+        int ans = _rxtxSerial->waitfordata(data_count, timeout, returned_size);
+        if (ans == rp::hal::serial_rxtx::ANS_DEV_ERR) _isDeviceLost = true;
+        return (ans == rp::hal::serial_rxtx::ANS_OK);
+    }
+    bool isDeviceLost()
+    {
+        return _isDeviceLost;
+    }
+    void cancelWait()
+    {
+        _rxtxSerial->cancelOperation();
+    }
+    void clearCancelWait()
+    {
+        _rxtxSerial->clearCancelOperation();
+    }
+    int getPollHandle()
+    {
+        return _rxtxSerial->getPollHandle();
     }
     int senddata(const _u8 * data, size_t size)
     {
@@ -96,7 +116,7 @@ class RPlidarDriverSerial : public RPlidarDriverImplCommon
 {
 public:
 
-    RPlidarDriverSerial();
+    explicit RPlidarDriverSerial(_u32 scanCapacity = MAX_SCAN_NODES);
     virtual ~RPlidarDriverSerial();
     virtual u_result connect(const char * port_path,  _u32 baudrate, _u32 flag = 0);
     virtual void disconnect();
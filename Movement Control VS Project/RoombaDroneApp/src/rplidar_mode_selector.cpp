@@ -0,0 +1,238 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/locker.h"
+#include "hal/crc32.h"
+#include "rplidar_capsule_decoder.h"
+#include "rplidar_mode_selector.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+enum {
+    SYNTHETIC_FRAMES = 64,
+    SYNTHETIC_NODES = SYNTHETIC_FRAMES * CapsuleDecoder::ULTRA_CAPSULE_NODES,
+
+    // start angle step between two capsules, about 800 samples per revolution
+    SYNTHETIC_ANGLE_STEP_Q6 = (360 << 6) * CapsuleDecoder::CAPSULE_NODES / 800,
+};
+
+static volatile _u32 _sink;
+
+// deterministic filler, the decoders must not see the same bytes everywhere
+static _u32 _nextRandom(_u32 & state)
+{
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+template <class TFrame>
+static void _fillFrames(std::vector<TFrame> & frames, size_t count = SYNTHETIC_FRAMES)
+{
+    frames.resize(count);
+
+    _u32 state = 0x5eed;
+    _u8 * bytes = reinterpret_cast<_u8 *>(&frames[0]);
+    for (size_t pos = 0; pos < frames.size() * sizeof(TFrame); ++pos) {
+        bytes[pos] = (_u8)_nextRandom(state);
+    }
+}
+
+template <class TCapsule>
+static void _setStartAngles(std::vector<TCapsule> & capsules)
+{
+    for (size_t pos = 0; pos < capsules.size(); ++pos) {
+        capsules[pos].start_angle_sync_q6 = (_u16)((pos * SYNTHETIC_ANGLE_STEP_Q6) % (360 << 6));
+    }
+    capsules[0].start_angle_sync_q6 |= RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT;
+}
+
+// same conversion as the standard scan caching in rplidar_driver.cpp
+static size_t _decodeNodes(const std::vector<rplidar_response_measurement_node_t> & nodes, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    for (size_t pos = 0; pos < nodes.size(); ++pos) {
+        const rplidar_response_measurement_node_t & from = nodes[pos];
+        rplidar_response_measurement_node_hq_t & to = nodebuffer[pos];
+
+        to.angle_z_q14 = (((from.angle_q6_checkbit) >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) << 8) / 90;
+        to.dist_mm_q2 = from.distance_q2;
+        to.flag = (from.sync_quality & RPLIDAR_RESP_MEASUREMENT_SYNCBIT);
+        to.quality = (from.sync_quality >> RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT;
+    }
+    return nodes.size();
+}
+
+// validates the capsules like _waitHqNode does and copies their nodes out
+static size_t _decodeHqCapsules(const std::vector<rplidar_response_hq_capsule_measurement_nodes_t> & capsules, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    size_t count = 0;
+    for (size_t pos = 0; pos < capsules.size(); ++pos) {
+        const rplidar_response_hq_capsule_measurement_nodes_t & capsule = capsules[pos];
+
+        _u32 crcCalc = rp::hal::crc32_padded(&capsule, sizeof(capsule) - sizeof(capsule.crc32));
+        if (crcCalc != capsule.crc32) continue;
+
+        memcpy(nodebuffer + count, capsule.node_hq, sizeof(capsule.node_hq));
+        count += _countof(capsule.node_hq);
+    }
+    return count;
+}
+
+// best microseconds per sample of decoding the frames again and again
+template <class TDecode>
+static float _measure(TDecode decode)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(SYNTHETIC_NODES);
+
+    float best = 0;
+    for (int round = 0; round < ScanModeSelector::MEASURE_ROUNDS; ++round) {
+        _u64 startUs = rp::arch::rp_getus();
+        _u64 elapsedUs;
+        size_t samples = 0;
+        do {
+            samples += decode(&nodes[0]);
+            elapsedUs = rp::arch::rp_getus() - startUs;
+        } while (elapsedUs < ScanModeSelector::MEASURE_ROUND_US);
+
+        _sink = _sink + nodes[0].dist_mm_q2;
+        if (!samples) return 0;
+
+        float cost = (float)elapsedUs / samples;
+        if (round == 0 || cost < best) best = cost;
+    }
+    return best;
+}
+
+static float _measureDecodeCost(_u8 ansType)
+{
+    switch (ansType) {
+    case RPLIDAR_ANS_TYPE_MEASUREMENT:
+        {
+            std::vector<rplidar_response_measurement_node_t> frames;
+            _fillFrames(frames, SYNTHETIC_FRAMES * CapsuleDecoder::CAPSULE_NODES);
+            return _measure([&](rplidar_response_measurement_node_hq_t * nodebuffer) {
+                return _decodeNodes(frames, nodebuffer);
+            });
+        }
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+        {
+            std::vector<rplidar_response_capsule_measurement_nodes_t> frames;
+            _fillFrames(frames);
+            _setStartAngles(frames);
+            return _measure([&](rplidar_response_measurement_node_hq_t * nodebuffer) {
+                return CapsuleDecoder::decodeCapsules(&frames[0], frames.size(), nodebuffer);
+            });
+        }
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+        {
+            std::vector<rplidar_response_dense_capsule_measurement_nodes_t> frames;
+            _fillFrames(frames);
+            _setStartAngles(frames);
+            return _measure([&](rplidar_response_measurement_node_hq_t * nodebuffer) {
+                return CapsuleDecoder::decodeDenseCapsules(&frames[0], frames.size(), nodebuffer);
+            });
+        }
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED_ULTRA:
+        {
+            std::vector<rplidar_response_ultra_capsule_measurement_nodes_t> frames;
+            _fillFrames(frames);
+            _setStartAngles(frames);
+            return _measure([&](rplidar_response_measurement_node_hq_t * nodebuffer) {
+                return CapsuleDecoder::decodeUltraCapsules(&frames[0], frames.size(), nodebuffer);
+            });
+        }
+    case RPLIDAR_ANS_TYPE_MEASUREMENT_HQ:
+        {
+            std::vector<rplidar_response_hq_capsule_measurement_nodes_t> frames;
+            _fillFrames(frames);
+            for (size_t pos = 0; pos < frames.size(); ++pos) {
+                frames[pos].sync_byte = RPLIDAR_RESP_MEASUREMENT_HQ_SYNC;
+                frames[pos].crc32 = rp::hal::crc32_padded(&frames[pos], sizeof(frames[pos]) - sizeof(frames[pos].crc32));
+            }
+            return _measure([&](rplidar_response_measurement_node_hq_t * nodebuffer) {
+                return _decodeHqCapsules(frames, nodebuffer);
+            });
+        }
+    default:
+        return 0;
+    }
+}
+
+float ScanModeSelector::decodeCostUs(_u8 ansType)
+{
+    static rp::hal::Locker lock;
+    static float costs[256];
+    static bool isMeasured[256];
+
+    rp::hal::AutoLocker l(lock);
+    if (!isMeasured[ansType]) {
+        costs[ansType] = _measureDecodeCost(ansType);
+        isMeasured[ansType] = true;
+    }
+    return costs[ansType];
+}
+
+float ScanModeSelector::decodeLoad(const RplidarScanMode & mode)
+{
+    if (mode.us_per_sample <= 0) return 0;
+    return decodeCostUs(mode.ans_type) / mode.us_per_sample;
+}
+
+void ScanModeSelector::rankModes(const std::vector<RplidarScanMode> & modes, float cpuBudget, std::vector<RplidarScanMode> & ranked)
+{
+    std::vector<RplidarScanMode> fitting, others;
+    for (size_t pos = 0; pos < modes.size(); ++pos) {
+        if (decodeLoad(modes[pos]) <= cpuBudget) {
+            fitting.push_back(modes[pos]);
+        } else {
+            others.push_back(modes[pos]);
+        }
+    }
+
+    std::stable_sort(fitting.begin(), fitting.end(), [](const RplidarScanMode & left, const RplidarScanMode & right) {
+        if (left.us_per_sample != right.us_per_sample) return left.us_per_sample < right.us_per_sample;
+        return left.max_distance > right.max_distance;
+    });
+    std::stable_sort(others.begin(), others.end(), [](const RplidarScanMode & left, const RplidarScanMode & right) {
+        return decodeLoad(left) < decodeLoad(right);
+    });
+
+    ranked.swap(fitting);
+    ranked.insert(ranked.end(), others.begin(), others.end());
+}
+
+}}}
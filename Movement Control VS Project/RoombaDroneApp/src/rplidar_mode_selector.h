@@ -0,0 +1,72 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Host side decode cost of the scan answer types, and the order in which
+// startScanAuto tries the scan modes of a device.
+//
+// The cost of an answer type is the time the host takes to validate and
+// decode one sample of it with the decoders the driver runs: the selected
+// CapsuleDecoder implementation for the capsule types, crc32_padded for HQ
+// capsules. It is measured once per process on synthetic frames, the best of
+// a few rounds, so a busy host does not make a mode look more expensive than
+// it is.
+//
+// The load of a mode is its cost divided by its sample duration, i.e. the
+// fraction of one CPU decoding it keeps busy. The rest of the receive path
+// and the application are not part of it, the budget a mode is checked
+// against has to leave room for them.
+class ScanModeSelector
+{
+public:
+    enum {
+        MEASURE_ROUND_US = 10000,   // every round decodes for at least this long
+        MEASURE_ROUNDS = 3,
+    };
+
+    // microseconds of CPU per sample, 0 for an unknown answer type
+    static float decodeCostUs(_u8 ansType);
+
+    // fraction of one CPU decoding the mode takes
+    static float decodeLoad(const RplidarScanMode & mode);
+
+    // the modes within cpuBudget, densest first and the longest range first
+    // among equally dense ones, followed by the others by ascending load
+    static void rankModes(const std::vector<RplidarScanMode> & modes, float cpuBudget, std::vector<RplidarScanMode> & ranked);
+};
+
+}}}
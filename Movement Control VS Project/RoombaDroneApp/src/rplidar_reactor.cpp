@@ -0,0 +1,295 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+
+#include "hal/types.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "hal/thread.h"
+#include "hal/poller.h"
+#include "rplidar_reactor.h"
+
+#include <algorithm>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RPlidarReactor * RPlidarReactor::CreateReactor(_u32 workerCount)
+{
+    if (!workerCount || workerCount > MAX_WORKER_COUNT) return NULL;
+
+    RPlidarReactorImpl * reactor = new RPlidarReactorImpl(workerCount);
+    if (IS_FAIL(reactor->start())) {
+        delete reactor;
+        return NULL;
+    }
+    return reactor;
+}
+
+void RPlidarReactor::DisposeReactor(RPlidarReactor * reactor)
+{
+    delete reactor;
+}
+
+RPlidarReactorImpl::RPlidarReactorImpl(_u32 workerCount)
+    : _workerCount(workerCount)
+    , _poller(NULL)
+    , _driverCount(0)
+    , _isRunning(false)
+{
+}
+
+RPlidarReactorImpl::~RPlidarReactorImpl()
+{
+    {
+        rp::hal::AutoLocker l(_lock);
+        _isRunning = false;
+    }
+
+    if (_poller) _poller->cancel();
+    _reactorthread.join();
+
+    for (_u32 pos = 0; pos < _workerCount; ++pos) {
+        _workers[pos].wakeEvt.set();
+        _workers[pos].thread.join();
+    }
+
+    for (size_t pos = 0; pos < _entries.size(); ++pos) {
+        delete _entries[pos];
+    }
+    if (_poller) rp::hal::Poller::ReleasePoller(_poller);
+}
+
+u_result RPlidarReactorImpl::start()
+{
+    _poller = rp::hal::Poller::CreatePoller();
+    if (!_poller) return RESULT_OPERATION_FAIL;
+
+    _isRunning = true;
+    _reactorthread = CLASS_THREAD(RPlidarReactorImpl, _reactorThreadProc);
+    if (_reactorthread.getHandle() == 0) return RESULT_OPERATION_FAIL;
+
+    for (_u32 pos = 0; pos < _workerCount; ++pos) {
+        worker_t & worker = _workers[pos];
+        worker.reactor = this;
+        worker.thread = rp::hal::Thread::create_member<worker_t, &worker_t::threadProc>(&worker);
+        if (worker.thread.getHandle() == 0) return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+size_t RPlidarReactorImpl::getDriverCount()
+{
+    rp::hal::AutoLocker l(_lock);
+    return _driverCount;
+}
+
+size_t RPlidarReactorImpl::getScanningCount()
+{
+    rp::hal::AutoLocker l(_lock);
+
+    size_t count = 0;
+    for (size_t pos = 0; pos < _entries.size(); ++pos) {
+        if (!_entries[pos]->isEnding) ++count;
+    }
+    return count;
+}
+
+u_result RPlidarReactorImpl::setThreadAttributes(const RplidarThreadAttributes & attributes)
+{
+    if (attributes.policy > THREAD_POLICY_RR) return RESULT_INVALID_DATA;
+
+    u_result ans = RESULT_OK;
+    for (_u32 pos = 0; pos <= _workerCount; ++pos) {
+        rp::hal::Thread & thread = (pos < _workerCount) ? _workers[pos].thread : _reactorthread;
+
+        if (IS_FAIL(thread.setScheduling((rp::hal::Thread::sched_policy_t)attributes.policy, attributes.priority))) ans = RESULT_OPERATION_FAIL;
+        if (IS_FAIL(thread.setAffinity(attributes.cpu_mask))) ans = RESULT_OPERATION_FAIL;
+        if (!attributes.name[0]) continue;
+
+        char name[sizeof(attributes.name) + 8];   // room for any worker index
+        if (pos < _workerCount) {
+            snprintf(name, sizeof(name), "%.12s%u", attributes.name, pos);
+        } else {
+            strcpy(name, attributes.name);
+        }
+        if (IS_FAIL(thread.setName(name))) ans = RESULT_OPERATION_FAIL;
+    }
+    return ans;
+}
+
+void RPlidarReactorImpl::attach()
+{
+    rp::hal::AutoLocker l(_lock);
+    ++_driverCount;
+}
+
+void RPlidarReactorImpl::detach()
+{
+    rp::hal::AutoLocker l(_lock);
+    if (_driverCount) --_driverCount;
+}
+
+u_result RPlidarReactorImpl::beginScan(ScanPump * pump, int handle)
+{
+    if (handle < 0) return RESULT_OPERATION_NOT_SUPPORT;
+
+    rp::hal::AutoLocker l(_lock);
+    if (!_isRunning || _findEntry(pump)) return RESULT_OPERATION_FAIL;
+
+    pump_entry_t * entry = new pump_entry_t(pump, handle);
+    if (!_poller->add(handle, entry)) {
+        delete entry;
+        return RESULT_OPERATION_FAIL;
+    }
+    _entries.push_back(entry);
+
+    // the channel may hold data already, received along with the answer header
+    _enqueue(entry);
+    return RESULT_OK;
+}
+
+void RPlidarReactorImpl::endScan(ScanPump * pump)
+{
+    pump_entry_t * entry;
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        entry = _findEntry(pump);
+        if (!entry) return;
+
+        entry->isEnding = true;
+        _poller->remove(entry->handle);
+        if (entry->isQueued) {
+            _readyQueue.erase(std::find(_readyQueue.begin(), _readyQueue.end(), entry));
+            entry->isQueued = false;
+        }
+    }
+
+    // a pass of the worker running the pump never waits for data, so this is short
+    for (;;) {
+        {
+            rp::hal::AutoLocker l(_lock);
+            if (!entry->isBusy) {
+                _entries.erase(std::find(_entries.begin(), _entries.end(), entry));
+                delete entry;
+                return;
+            }
+        }
+        delay(END_SCAN_POLL_INTERVAL);
+    }
+}
+
+RPlidarReactorImpl::pump_entry_t * RPlidarReactorImpl::_findEntry(ScanPump * pump)
+{
+    for (size_t pos = 0; pos < _entries.size(); ++pos) {
+        if (_entries[pos]->pump == pump) return _entries[pos];
+    }
+    return NULL;
+}
+
+void RPlidarReactorImpl::_enqueue(pump_entry_t * entry)
+{
+    // a busy pump is rearmed by its worker, which picks up what arrived meanwhile
+    if (entry->isEnding || entry->isQueued || entry->isBusy) return;
+
+    entry->isQueued = true;
+    _readyQueue.push_back(entry);
+
+    // a busy worker takes the next queued pump by itself once it is done
+    if (!_idleWorkers.empty()) {
+        _idleWorkers.back()->wakeEvt.set();
+        _idleWorkers.pop_back();
+    }
+}
+
+u_result RPlidarReactorImpl::_reactorThreadProc()
+{
+    void * ready[MAX_EVENTS_PER_WAIT];
+
+    while (_isRunning) {
+        size_t count = 0;
+        int ans = _poller->waitForEvents(ready, _countof(ready), count, 0xFFFFFFFF);
+        if (ans == rp::hal::Poller::EVENT_FAILED) {
+            return RESULT_OPERATION_FAIL;
+        }
+
+        rp::hal::AutoLocker l(_lock);
+        for (size_t pos = 0; pos < count; ++pos) {
+            // the scan may have ended after the poller reported its handle
+            std::vector<pump_entry_t *>::iterator it = std::find(_entries.begin(), _entries.end(), ready[pos]);
+            if (it != _entries.end()) _enqueue(*it);
+        }
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarReactorImpl::_workerThreadProc(worker_t * worker)
+{
+    pump_entry_t * entry = NULL;
+    bool isScanning = false;
+
+    _lock.lock();
+    for (;;) {
+        if (entry) {
+            entry->isBusy = false;
+            if (isScanning && !entry->isEnding) {
+                _poller->rearm(entry->handle, entry);
+            }
+            entry = NULL;
+        }
+
+        while (_isRunning && _readyQueue.empty()) {
+            _idleWorkers.push_back(worker);
+            _lock.unlock();
+            worker->wakeEvt.wait();
+            _lock.lock();
+        }
+        if (!_isRunning) break;
+
+        entry = _readyQueue.front();
+        _readyQueue.pop_front();
+        entry->isQueued = false;
+        entry->isBusy = true;
+        _lock.unlock();
+
+        isScanning = entry->pump->pumpScanData();
+
+        _lock.lock();
+    }
+    _lock.unlock();
+    return RESULT_OK;
+}
+
+}}}
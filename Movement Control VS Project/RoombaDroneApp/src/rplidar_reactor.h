@@ -0,0 +1,127 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// The reception of one scan as served by a reactor
+class ScanPump
+{
+public:
+    virtual ~ScanPump() {}
+
+    // decode everything received so far without waiting for more data,
+    // false once the scan is over and the handle should not be rearmed
+    virtual bool pumpScanData() = 0;
+};
+
+// The reactor thread only waits: every handle is armed one-shot, and a handle
+// that turned readable is queued for the workers, which pump it and rearm it.
+// A pump is thus never run by two workers at once, and is not looked at by the
+// reactor thread while a worker runs it. An idle worker waits on an event of
+// its own, queueing a pump wakes one of them. Queue, pump and worker states
+// are guarded by _lock.
+class RPlidarReactorImpl : public RPlidarReactor
+{
+public:
+    enum {
+        MAX_EVENTS_PER_WAIT = 16,
+        END_SCAN_POLL_INTERVAL = 1,     // ms between checks of whether a worker is done with an ending pump
+    };
+
+    explicit RPlidarReactorImpl(_u32 workerCount);
+    virtual ~RPlidarReactorImpl();
+
+    // create the poller and start the threads
+    u_result start();
+
+    virtual size_t getDriverCount();
+    virtual size_t getScanningCount();
+    virtual u_result setThreadAttributes(const RplidarThreadAttributes & attributes);
+
+    // drivers report being attached and detached to keep getDriverCount right
+    void attach();
+    void detach();
+
+    // serve pump until endScan, handle is the descriptor turning readable with its data
+    u_result beginScan(ScanPump * pump, int handle);
+
+    // stop serving pump, returns once no worker runs it any more
+    void endScan(ScanPump * pump);
+
+protected:
+    struct pump_entry_t {
+        ScanPump *  pump;
+        int         handle;
+        bool        isQueued;       // waiting in _readyQueue
+        bool        isBusy;         // being pumped by a worker
+        bool        isEnding;       // endScan was called, neither queue nor rearm it again
+
+        pump_entry_t(ScanPump * p, int h) : pump(p), handle(h), isQueued(false), isBusy(false), isEnding(false) {}
+    };
+
+    struct worker_t {
+        RPlidarReactorImpl *    reactor;
+        rp::hal::Event          wakeEvt;    // auto reset, set when a pump is queued for an idle worker
+        rp::hal::Thread         thread;
+
+        worker_t() : reactor(NULL) {}
+        u_result threadProc() { return reactor->_workerThreadProc(this); }
+    };
+
+    u_result _reactorThreadProc();
+    u_result _workerThreadProc(worker_t * worker);
+    void     _enqueue(pump_entry_t * entry);
+    pump_entry_t * _findEntry(ScanPump * pump);
+
+    _u32                        _workerCount;
+    rp::hal::Poller *           _poller;
+
+    std::vector<pump_entry_t *> _entries;
+    std::deque<pump_entry_t *>  _readyQueue;
+    std::vector<worker_t *>     _idleWorkers;
+    size_t                      _driverCount;
+
+    volatile bool               _isRunning;
+
+    rp::hal::Locker             _lock;
+    rp::hal::Thread             _reactorthread;
+    worker_t                    _workers[MAX_WORKER_COUNT];
+};
+
+}}}
@@ -0,0 +1,115 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Receive ring used by the scan data cache threads.
+//
+// The channel is drained directly into the ring, and frames are handed out
+// as pointers into it. The first MAX_FRAME_SIZE bytes of the ring are
+// mirrored behind its end, so a frame starting anywhere inside the ring can
+// always be accessed contiguously, even when it wraps around.
+//
+// A read of up to MAX_READ_SIZE bytes may also run past the end of the ring,
+// which lets a datagram channel receive a whole datagram in place. The part
+// written behind the end is moved to the start of the ring on commit.
+template <size_t CAPACITY, size_t MAX_FRAME_SIZE, size_t MAX_READ_SIZE = 0>
+class RxRingBuffer
+{
+public:
+    enum {
+        TAIL_SIZE = (MAX_FRAME_SIZE > MAX_READ_SIZE) ? MAX_FRAME_SIZE : MAX_READ_SIZE,
+    };
+
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "ring capacity must be a power of 2");
+    static_assert(TAIL_SIZE < CAPACITY, "frame or read size exceeds the ring capacity");
+
+    RxRingBuffer() { reset(); }
+
+    void reset()
+    {
+        _rdPos = _wrPos = 0;
+    }
+
+    size_t size() const
+    {
+        return _wrPos - _rdPos;
+    }
+
+    // at least min(size(), MAX_FRAME_SIZE) bytes are contiguous from here
+    const _u8 * front() const
+    {
+        return _buffer + (_rdPos & (CAPACITY - 1));
+    }
+
+    void consume(size_t bytes)
+    {
+        _rdPos += bytes;
+    }
+
+    // contiguous free space starting at the write position, at least
+    // min(free space, MAX_READ_SIZE) bytes
+    _u8 * writePtr(size_t & room)
+    {
+        size_t wr = (_wrPos & (CAPACITY - 1));
+        size_t free = CAPACITY - size();
+        room = CAPACITY - wr + MAX_READ_SIZE;
+        if (room > free) room = free;
+        return _buffer + wr;
+    }
+
+    void commit(size_t bytes)
+    {
+        size_t wr = (_wrPos & (CAPACITY - 1));
+        if (wr < MAX_FRAME_SIZE) {
+            size_t mirrored = MAX_FRAME_SIZE - wr;
+            if (mirrored > bytes) mirrored = bytes;
+            memcpy(_buffer + CAPACITY + wr, _buffer + wr, mirrored);
+        }
+        if (wr + bytes > CAPACITY) {
+            // the tail now mirrors what belongs to the start of the ring
+            memcpy(_buffer, _buffer + CAPACITY, wr + bytes - CAPACITY);
+        }
+        _wrPos += bytes;
+    }
+
+protected:
+    _u8     _buffer[CAPACITY + TAIL_SIZE];
+    size_t  _rdPos;
+    size_t  _wrPos;
+};
+
+}}}
@@ -0,0 +1,138 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_scan_pool.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+ScanPool::ScanPool(size_t blockCount, size_t nodeCapacity)
+    : _blocks(new ScanLease::Block[blockCount])
+    , _blockCount(blockCount)
+    , _nodes(new rplidar_response_measurement_node_hq_t[blockCount * nodeCapacity])
+{
+    for (size_t pos = 0; pos < _blockCount; ++pos) {
+        _blocks[pos].refs.store(0, std::memory_order_relaxed);
+        _blocks[pos].count = 0;
+        _blocks[pos].nodes = _nodes + pos * nodeCapacity;
+    }
+}
+
+ScanPool::~ScanPool()
+{
+    delete [] _blocks;
+    delete [] _nodes;
+}
+
+ScanLease::Block * ScanPool::acquire()
+{
+    for (size_t pos = 0; pos < _blockCount; ++pos) {
+        unsigned int expected = 0;
+        if (_blocks[pos].refs.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return &_blocks[pos];
+        }
+    }
+    return NULL;
+}
+
+//------
+// ScanLease
+
+ScanLease::ScanLease()
+    : _block(NULL)
+{
+}
+
+ScanLease::ScanLease(Block * block)
+    : _block(block)
+{
+}
+
+ScanLease::ScanLease(const ScanLease & other)
+    : _block(other._block)
+{
+    if (_block) {
+        _block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+ScanLease & ScanLease::operator=(const ScanLease & other)
+{
+    if (_block != other._block) {
+        if (other._block) {
+            other._block->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        release();
+        _block = other._block;
+    }
+    return *this;
+}
+
+ScanLease::~ScanLease()
+{
+    release();
+}
+
+void ScanLease::release()
+{
+    if (_block) {
+        // the release pairs with the acquire in ScanPool::acquire, so the next
+        // writer of the block only starts once every reader is done with it
+        _block->refs.fetch_sub(1, std::memory_order_release);
+        _block = NULL;
+    }
+}
+
+bool ScanLease::isValid() const
+{
+    return _block != NULL;
+}
+
+const rplidar_response_measurement_node_hq_t * ScanLease::nodes() const
+{
+    return _block ? _block->nodes : NULL;
+}
+
+size_t ScanLease::count() const
+{
+    return _block ? _block->count : 0;
+}
+
+const RplidarScanTimestamp & ScanLease::timestamp() const
+{
+    static const RplidarScanTimestamp emptyTimestamp = { 0, 0 };
+    return _block ? _block->timestamp : emptyTimestamp;
+}
+
+}}}
@@ -0,0 +1,70 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+struct ScanLease::Block
+{
+    std::atomic<unsigned int>               refs;
+    size_t                                  count;
+    RplidarScanTimestamp                    timestamp;
+    rplidar_response_measurement_node_hq_t *nodes;
+};
+
+// Fixed set of scan buffers handed out as ScanLease blocks.
+//
+// A block is free while its reference count is zero; acquire() claims the
+// first free block it finds and the last ScanLease releasing it makes it free
+// again, so the pool itself needs no lock. The nodes of all blocks share one
+// allocation sized for the driver's scan capacity.
+class ScanPool
+{
+public:
+    ScanPool(size_t blockCount, size_t nodeCapacity);
+    ~ScanPool();
+
+    // returns a block holding one reference, or NULL when all of them are leased out
+    ScanLease::Block * acquire();
+
+protected:
+    ScanLease::Block *  _blocks;
+    size_t              _blockCount;
+    rplidar_response_measurement_node_hq_t * _nodes;
+};
+
+}}}
@@ -0,0 +1,333 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_scan_sorter.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+//------
+// integer angle access, one full revolution is ANGLE_RANGE units
+
+template <class TNode>
+struct scan_node_traits_t;
+
+template <>
+struct scan_node_traits_t<rplidar_response_measurement_node_hq_t>
+{
+    enum {
+        ANGLE_RANGE = (360 << 14) / 90,
+    };
+
+    static inline _u32 angle(const rplidar_response_measurement_node_hq_t & node)
+    {
+        return node.angle_z_q14;
+    }
+
+    static inline void setAngle(rplidar_response_measurement_node_hq_t & node, _u32 angle)
+    {
+        node.angle_z_q14 = _u16(angle);
+    }
+
+    static inline _u32 distance(const rplidar_response_measurement_node_hq_t & node)
+    {
+        return node.dist_mm_q2;
+    }
+};
+
+template <>
+struct scan_node_traits_t<rplidar_response_measurement_node_t>
+{
+    enum {
+        ANGLE_RANGE = (360 << 6),
+    };
+
+    static inline _u32 angle(const rplidar_response_measurement_node_t & node)
+    {
+        return node.angle_q6_checkbit >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT;
+    }
+
+    static inline void setAngle(rplidar_response_measurement_node_t & node, _u32 angle)
+    {
+        _u16 checkbit = node.angle_q6_checkbit & RPLIDAR_RESP_MEASUREMENT_CHECKBIT;
+        node.angle_q6_checkbit = _u16(angle << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | checkbit;
+    }
+
+    static inline _u32 distance(const rplidar_response_measurement_node_t & node)
+    {
+        return node.distance_q2;
+    }
+};
+
+template <class TNode>
+static inline bool _angleKeyLess(const TNode & a, const TNode & b)
+{
+    return scan_node_traits_t<TNode>::angle(a) < scan_node_traits_t<TNode>::angle(b);
+}
+
+// scratch space for merging and radix passes, grown once per thread
+template <class TNode>
+static TNode * _scratchBuffer(size_t count)
+{
+    static thread_local std::vector<TNode> scratch;
+    if (scratch.size() < count) {
+        scratch.resize(count);
+    }
+    return &scratch[0];
+}
+
+template <class TNode>
+static u_result _fillInvalidAngles(TNode * nodebuffer, size_t count)
+{
+    typedef scan_node_traits_t<TNode> traits;
+
+    size_t firstValid = 0;
+    while (firstValid < count && traits::distance(nodebuffer[firstValid]) == 0) ++firstValid;
+
+    // all the data is invalid
+    if (firstValid == count) return RESULT_OPERATION_FAIL;
+
+    // 360 / count in 32.32 fixed point
+    const _u64 inc = ((_u64)traits::ANGLE_RANGE << 32) / count;
+
+    // Tune head, only node 0 survives: the nodes after it are invalid and
+    // get filled below, which also covers everything a tail pass would set
+    if (firstValid) {
+        _u64 back = (firstValid * inc) >> 32;
+        _u32 validAngle = traits::angle(nodebuffer[firstValid]);
+        traits::setAngle(nodebuffer[0], (validAngle > back) ? _u32(validAngle - back) : 0);
+    }
+
+    //Fill invalid angle in the scan
+    _u32 frontAngle = traits::angle(nodebuffer[0]);
+    for (size_t pos = 1; pos < count; ++pos) {
+        if (traits::distance(nodebuffer[pos]) == 0) {
+            _u32 expectAngle = frontAngle + _u32((pos * inc) >> 32);
+            if (expectAngle > (_u32)traits::ANGLE_RANGE) expectAngle -= traits::ANGLE_RANGE;
+            traits::setAngle(nodebuffer[pos], expectAngle);
+        }
+    }
+    return RESULT_OK;
+}
+
+template <class TNode>
+static void _radixSort(TNode * nodebuffer, size_t count)
+{
+    typedef scan_node_traits_t<TNode> traits;
+
+    size_t histLow[257] = {0};
+    size_t histHigh[257] = {0};
+
+    for (size_t pos = 0; pos < count; ++pos) {
+        _u32 key = traits::angle(nodebuffer[pos]);
+        ++histLow[(key & 0xFF) + 1];
+        ++histHigh[((key >> 8) & 0xFF) + 1];
+    }
+    for (size_t bucket = 1; bucket < _countof(histLow); ++bucket) {
+        histLow[bucket] += histLow[bucket - 1];
+        histHigh[bucket] += histHigh[bucket - 1];
+    }
+
+    TNode * scratch = _scratchBuffer<TNode>(count);
+
+    for (size_t pos = 0; pos < count; ++pos) {
+        _u32 key = traits::angle(nodebuffer[pos]);
+        scratch[histLow[key & 0xFF]++] = nodebuffer[pos];
+    }
+    for (size_t pos = 0; pos < count; ++pos) {
+        _u32 key = traits::angle(scratch[pos]);
+        nodebuffer[histHigh[(key >> 8) & 0xFF]++] = scratch[pos];
+    }
+}
+
+template <class TNode>
+static u_result _ascend(TNode * nodebuffer, size_t count)
+{
+    typedef scan_node_traits_t<TNode> traits;
+
+    u_result ans = _fillInvalidAngles(nodebuffer, count);
+    if (IS_FAIL(ans)) return ans;
+
+    // look for the descents, a scan straight from the device has just one
+    size_t descents = 0;
+    size_t wrapPos = 0;
+    _u32 prevAngle = traits::angle(nodebuffer[0]);
+    for (size_t pos = 1; pos < count; ++pos) {
+        _u32 angle = traits::angle(nodebuffer[pos]);
+        if (angle < prevAngle) {
+            if (++descents > 1) break;
+            wrapPos = pos;
+        }
+        prevAngle = angle;
+    }
+
+    if (descents == 0) {
+        return RESULT_OK;
+    }
+
+    if (descents == 1) {
+        if (traits::angle(nodebuffer[count - 1]) <= traits::angle(nodebuffer[0])) {
+            // two ascending runs that do not overlap, swap them
+            std::rotate(nodebuffer, nodebuffer + wrapPos, nodebuffer + count);
+        } else {
+            TNode * scratch = _scratchBuffer<TNode>(count);
+            std::merge(nodebuffer + wrapPos, nodebuffer + count, nodebuffer, nodebuffer + wrapPos, scratch, &_angleKeyLess<TNode>);
+            std::copy(scratch, scratch + count, nodebuffer);
+        }
+        return RESULT_OK;
+    }
+
+    _radixSort(nodebuffer, count);
+    return RESULT_OK;
+}
+
+u_result ScanSorter::ascend(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count)
+{
+    return _ascend(nodebuffer, count);
+}
+
+u_result ScanSorter::ascend(rplidar_response_measurement_node_t * nodebuffer, size_t count)
+{
+    return _ascend(nodebuffer, count);
+}
+
+//------
+// reference implementation
+
+static inline float getAngle(const rplidar_response_measurement_node_t& node)
+{
+    return (node.angle_q6_checkbit >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) / 64.f;
+}
+
+static inline void setAngle(rplidar_response_measurement_node_t& node, float v)
+{
+    _u16 checkbit = node.angle_q6_checkbit & RPLIDAR_RESP_MEASUREMENT_CHECKBIT;
+    node.angle_q6_checkbit = (((_u16)(v * 64.0f)) << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | checkbit;
+}
+
+static inline float getAngle(const rplidar_response_measurement_node_hq_t& node)
+{
+    return node.angle_z_q14 * 90.f / 16384.f;
+}
+
+static inline void setAngle(rplidar_response_measurement_node_hq_t& node, float v)
+{
+    node.angle_z_q14 = _u32(v * 16384.f / 90.f);
+}
+
+static inline _u16 getDistanceQ2(const rplidar_response_measurement_node_t& node)
+{
+    return node.distance_q2;
+}
+
+static inline _u32 getDistanceQ2(const rplidar_response_measurement_node_hq_t& node)
+{
+    return node.dist_mm_q2;
+}
+
+template <class TNode>
+static bool angleLessThan(const TNode& a, const TNode& b)
+{
+    return getAngle(a) < getAngle(b);
+}
+
+template < class TNode >
+static u_result ascendScanData_(TNode * nodebuffer, size_t count)
+{
+    float inc_origin_angle = 360.f/count;
+    size_t i = 0;
+
+    //Tune head
+    for (i = 0; i < count; i++) {
+        if(getDistanceQ2(nodebuffer[i]) == 0) {
+            continue;
+        } else {
+            while(i != 0) {
+                i--;
+                float expect_angle = getAngle(nodebuffer[i+1]) - inc_origin_angle;
+                if (expect_angle < 0.0f) expect_angle = 0.0f;
+                setAngle(nodebuffer[i], expect_angle);
+            }
+            break;
+        }
+    }
+
+    // all the data is invalid
+    if (i == count) return RESULT_OPERATION_FAIL;
+
+    //Tune tail
+    for (i = count; i-- > 0;) {
+        if(getDistanceQ2(nodebuffer[i]) == 0) {
+            continue;
+        } else {
+            while(i != (count - 1)) {
+                i++;
+                float expect_angle = getAngle(nodebuffer[i-1]) + inc_origin_angle;
+                if (expect_angle > 360.0f) expect_angle -= 360.0f;
+                setAngle(nodebuffer[i], expect_angle);
+            }
+            break;
+        }
+    }
+
+    //Fill invalid angle in the scan
+    float frontAngle = getAngle(nodebuffer[0]);
+    for (i = 1; i < count; i++) {
+        if(getDistanceQ2(nodebuffer[i]) == 0) {
+            float expect_angle =  frontAngle + i * inc_origin_angle;
+            if (expect_angle > 360.0f) expect_angle -= 360.0f;
+            setAngle(nodebuffer[i], expect_angle);
+        }
+    }
+
+    // Reorder the scan according to the angle value
+    std::sort(nodebuffer, nodebuffer + count, &angleLessThan<TNode>);
+
+    return RESULT_OK;
+}
+
+u_result ScanSorter::ascendReference(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count)
+{
+    return ascendScanData_<rplidar_response_measurement_node_hq_t>(nodebuffer, count);
+}
+
+u_result ScanSorter::ascendReference(rplidar_response_measurement_node_t * nodebuffer, size_t count)
+{
+    return ascendScanData_<rplidar_response_measurement_node_t>(nodebuffer, count);
+}
+
+}}}
@@ -0,0 +1,68 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Reorders one revolution of nodes by ascending angle.
+//
+// Nodes without a distance first get an angle interpolated from their
+// neighbours, exactly like the original ascendScanData did: a leading run of
+// invalid nodes extrapolates backwards from the first valid node (clamped at
+// 0), every other invalid node gets the angle of node 0 plus its index times
+// 360 / count, wrapped at 360 degrees.
+//
+// Sorting works on the integer angle field. A revolution coming from the
+// device is usually sorted already except for the wrap point, which is
+// rotated or merged in a single pass; anything less ordered goes through a
+// two pass LSD radix sort.
+//
+// The interpolation is done in 32.32 fixed point. It can differ from the old
+// float code by one unit of the integer angle, and by a few units for a
+// leading invalid run, where the float code truncated at every step.
+//
+// The reference implementations are the original float/std::sort code, kept
+// for comparison in the benchmarks.
+class ScanSorter
+{
+public:
+    static u_result ascend(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count);
+    static u_result ascend(rplidar_response_measurement_node_t * nodebuffer, size_t count);
+
+    static u_result ascendReference(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count);
+    static u_result ascendReference(rplidar_response_measurement_node_t * nodebuffer, size_t count);
+};
+
+}}}
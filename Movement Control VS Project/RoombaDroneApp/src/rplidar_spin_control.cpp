@@ -0,0 +1,117 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_spin_control.h"
+
+#include <math.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+SpinController::SpinController()
+    : _target(0)
+    , _measured(0)
+    , _command(0)
+    , _minCommand(1)
+    , _maxCommand(0xFFFF)
+    , _skipped(0)
+    , _averaged(0)
+    , _averagedPeriods_us(0)
+{
+}
+
+void SpinController::setTarget(float frequency)
+{
+    // the window being measured does not depend on the target, it is kept
+    _target = frequency;
+}
+
+void SpinController::setLimits(_u16 minCommand, _u16 maxCommand)
+{
+    _minCommand = minCommand;
+    _maxCommand = maxCommand;
+}
+
+void SpinController::setCommand(_u16 command)
+{
+    _command = command;
+    restart();
+}
+
+void SpinController::restart()
+{
+    _skipped = 0;
+    _averaged = 0;
+    _averagedPeriods_us = 0;
+}
+
+bool SpinController::addRevolution(_u64 period_us, _u16 & nextCommand)
+{
+    // revolutions before the motor settles tell nothing
+    if (!period_us) return false;
+    if (_skipped < SETTLE_REVOLUTIONS) {
+        ++_skipped;
+        return false;
+    }
+
+    _averagedPeriods_us += period_us;
+    if (++_averaged < AVERAGE_REVOLUTIONS) return false;
+
+    _measured = (float)(_averaged * 1000000.0 / _averagedPeriods_us);
+    _averaged = 0;
+    _averagedPeriods_us = 0;
+
+    // a stopped motor is not spun up
+    if (!_command || _target <= 0 || isLocked()) return false;
+
+    float scaled = _command * (1.0f + (_target / _measured - 1.0f) * GAIN_PERCENT / 100.0f);
+    long next = lroundf(scaled);
+
+    // a small error must still move the command
+    if (next == _command) next += (_target > _measured) ? 1 : -1;
+    if (next < _minCommand) next = _minCommand;
+    if (next > _maxCommand) next = _maxCommand;
+    if (next == _command) return false;
+
+    nextCommand = (_u16)next;
+    return true;
+}
+
+bool SpinController::isLocked() const
+{
+    if (_target <= 0 || _measured <= 0) return false;
+    return fabsf(_measured - _target) * 1000 <= _target * DEADBAND_PERMILLE;
+}
+
+}}}
@@ -0,0 +1,98 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Regulates the motor command of the lidar to a requested scan frequency.
+//
+// The revolution periods come from the sync node timestamps of consecutive
+// scans. After a command change the motor is given a few revolutions to
+// settle, then the periods of the next few are averaged, and the command is
+// scaled by a damped ratio of the target to the measured frequency. The spin
+// rate of both the PWM driven motors and the TOF units is close to
+// proportional to the command, so the correction converges within a few
+// steps; the damping absorbs the non-linearity near the stall PWM.
+//
+// The command is a PWM value for the accessory board motors and an rpm for
+// a TOF lidar, the controller does not care which.
+class SpinController
+{
+public:
+    enum {
+        SETTLE_REVOLUTIONS = 3,     // ignored after a command change
+        AVERAGE_REVOLUTIONS = 4,    // averaged per correction
+        DEADBAND_PERMILLE = 10,     // frequency error left uncorrected
+        GAIN_PERCENT = 70,          // share of the error corrected per step
+    };
+
+    SpinController();
+
+    // 0 stops regulating, the command is left as it is
+    void setTarget(float frequency);
+    float target() const { return _target; }
+
+    void setLimits(_u16 minCommand, _u16 maxCommand);
+
+    // the command the motor was last given, from the controller or anybody else,
+    // 0 while unknown; nothing is regulated without one
+    void setCommand(_u16 command);
+    _u16 command() const { return _command; }
+
+    // starts measuring over, e.g. when a new scan starts
+    void restart();
+
+    // feeds the period of one revolution, returns true when the command should
+    // change to nextCommand; the caller reports it with setCommand once sent
+    bool addRevolution(_u64 period_us, _u16 & nextCommand);
+
+    // averaged over the last correction window, 0 before the first one
+    float measuredFrequency() const { return _measured; }
+
+    // the last measured frequency is within the deadband of the target
+    bool isLocked() const;
+
+protected:
+    float   _target;
+    float   _measured;
+    _u16    _command;
+    _u16    _minCommand;
+    _u16    _maxCommand;
+    size_t  _skipped;
+    size_t  _averaged;
+    _u64    _averagedPeriods_us;
+};
+
+}}}